@@ -0,0 +1,171 @@
+#include "asset_registry.h"
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <utility>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+#ifdef _WIN32
+        std::swap(mapping_, other.mapping_);
+#endif
+    }
+    return *this;
+}
+
+bool MappedFile::open(const std::string& path, std::string& error) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        error = path + ": can't open (error " + std::to_string(GetLastError()) + ")";
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        error = path + ": can't get the size (error " + std::to_string(GetLastError()) + ")";
+        CloseHandle(file);
+        return false;
+    }
+    size_ = static_cast<size_t>(size.QuadPart);
+    if (size_ == 0) {
+        // mapping an empty file fails, there is nothing to map anyway
+        CloseHandle(file);
+        return true;
+    }
+    mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping_ == nullptr) {
+        error = path + ": can't map (error " + std::to_string(GetLastError()) + ")";
+        size_ = 0;
+        return false;
+    }
+    data_ = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+    if (data_ == nullptr) {
+        error = path + ": can't map (error " + std::to_string(GetLastError()) + ")";
+        close();
+        return false;
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        error = path + ": " + std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    if (size_ == 0) {
+        // mmap refuses zero length, there is nothing to map anyway
+        ::close(fd);
+        return true;
+    }
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file alive on its own
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        error = path + ": " + std::strerror(errno);
+        size_ = 0;
+        return false;
+    }
+    // we read everything right after loading, start paging it in now
+    madvise(data, size_, MADV_WILLNEED);
+    data_ = data;
+#endif
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (data_ != nullptr) {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_ != nullptr) {
+        CloseHandle(mapping_);
+    }
+    mapping_ = nullptr;
+#else
+    if (data_ != nullptr) {
+        munmap(const_cast<void*>(data_), size_);
+    }
+#endif
+    data_ = nullptr;
+    size_ = 0;
+}
+
+void AssetRegistry::report(const std::string& error) {
+    std::cout << "ERROR::ASSET::" << error << std::endl;
+    errors_.push_back(error);
+}
+
+bool AssetRegistry::load_directory(const std::string& directory, std::initializer_list<const char*> extensions) {
+    std::error_code error;
+    std::filesystem::directory_iterator entries(directory, error);
+    if (error) {
+        report(directory + ": " + error.message());
+        return false;
+    }
+
+    bool success = true;
+    for (const std::filesystem::directory_entry& entry : entries) {
+        if (!entry.is_regular_file(error)) {
+            continue;
+        }
+        std::string extension = entry.path().extension().string();
+        bool wanted = false;
+        for (const char* wanted_extension : extensions) {
+            wanted = wanted || extension == wanted_extension;
+        }
+        if (!wanted) {
+            continue;
+        }
+
+        MappedFile file;
+        std::string map_error;
+        if (!file.open(entry.path().string(), map_error)) {
+            report(map_error);
+            success = false;
+            continue;
+        }
+        mapped_bytes_ += file.size();
+        files_[entry.path().filename().string()] = std::move(file);
+    }
+    return success;
+}
+
+bool AssetRegistry::require(const std::string& name, std::string_view& source) {
+    auto found = files_.find(name);
+    if (found == files_.end()) {
+        report(name + ": not found");
+        return false;
+    }
+    source = found->second.view();
+    return true;
+}
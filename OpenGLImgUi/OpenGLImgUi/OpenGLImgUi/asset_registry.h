@@ -0,0 +1,57 @@
+#pragma once
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// read-only memory mapping of a whole file, the contents are never copied
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // returns false and fills error if the file can't be opened or mapped, an empty file maps to an empty view
+    bool open(const std::string& path, std::string& error);
+    void close();
+
+    std::string_view view() const { return std::string_view(static_cast<const char*>(data_), size_); }
+    const void* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const void* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* mapping_ = nullptr;
+#endif
+};
+
+// maps every asset of a directory once at startup and hands out views into the mappings
+// (e.g. straight to glShaderSource). views stay valid as long as the registry lives
+class AssetRegistry {
+public:
+    // one scan of the directory, maps every regular file whose extension is listed (e.g. { ".vert", ".frag" })
+    // returns false if anything failed to map, the reasons are printed and kept in errors()
+    bool load_directory(const std::string& directory, std::initializer_list<const char*> extensions);
+
+    // view of a loaded file by its name relative to the directory, prints an error and returns false if it
+    // was never loaded
+    bool require(const std::string& name, std::string_view& source);
+
+    bool contains(const std::string& name) const { return files_.count(name) != 0; }
+    size_t file_count() const { return files_.size(); }
+    size_t mapped_bytes() const { return mapped_bytes_; }
+    const std::vector<std::string>& errors() const { return errors_; }
+
+private:
+    void report(const std::string& error);
+
+    std::unordered_map<std::string, MappedFile> files_;
+    std::vector<std::string> errors_;
+    size_t mapped_bytes_ = 0;
+};
@@ -0,0 +1,148 @@
+#include "atlas_packer.h"
+#include <algorithm>
+#include <numeric>
+
+AtlasPacker::AtlasPacker(uint32_t width, uint32_t height, uint32_t padding, int max_pages, uint32_t alignment)
+    : width_(width), height_(height), padding_(padding), max_pages_(max_pages), alignment_(alignment) {
+}
+
+void AtlasPacker::reset() {
+    pages_.clear();
+}
+
+AtlasPacker::Page AtlasPacker::new_page() const {
+    Page page;
+    page.skyline.push_back({ 0, 0, width_ });
+    return page;
+}
+
+double AtlasPacker::occupancy() const {
+    if (pages_.empty()) {
+        return 0.0;
+    }
+    uint64_t used = 0;
+    for (const Page& page : pages_) {
+        used += page.used_area;
+    }
+    return static_cast<double>(used) / (static_cast<double>(width_) * height_ * pages_.size());
+}
+
+bool AtlasPacker::fit(const Page& page, size_t segment, uint32_t width, uint32_t height, uint32_t& y, uint64_t& waste) const {
+    const uint32_t x = page.skyline[segment].x;
+    if (x + width > width_) {
+        return false;
+    }
+    // the rectangle rests on the highest segment it spans
+    y = 0;
+    size_t end = segment;
+    for (uint32_t covered = 0; covered < width; covered += page.skyline[end].width, ++end) {
+        y = std::max(y, page.skyline[end].y);
+        if (y + height > height_) {
+            return false;
+        }
+    }
+    // and whatever is below it on the lower ones can't be used anymore
+    waste = 0;
+    for (size_t i = segment; i < end; ++i) {
+        const Segment& below = page.skyline[i];
+        uint32_t covered = std::min(below.x + below.width, x + width) - below.x;
+        waste += static_cast<uint64_t>(y - below.y) * covered;
+    }
+    return true;
+}
+
+void AtlasPacker::place(Page& page, size_t segment, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    std::vector<Segment>& skyline = page.skyline;
+    skyline.insert(skyline.begin() + segment, { x, y + height, width });
+    // the segments under the new one are cut back or go
+    for (size_t i = segment + 1; i < skyline.size() && skyline[i].x < x + width;) {
+        uint32_t overlap = x + width - skyline[i].x;
+        if (overlap >= skyline[i].width) {
+            skyline.erase(skyline.begin() + i);
+            continue;
+        }
+        skyline[i].x += overlap;
+        skyline[i].width -= overlap;
+        break;
+    }
+    // neighbours at the same height are one segment
+    for (size_t i = 0; i + 1 < skyline.size();) {
+        if (skyline[i].y == skyline[i + 1].y) {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        } else {
+            ++i;
+        }
+    }
+    page.used_area += static_cast<uint64_t>(width) * height;
+}
+
+bool AtlasPacker::insert_padded(uint32_t width, uint32_t height, AtlasRect& rect) {
+    if (width > width_ || height > height_) {
+        return false;
+    }
+    // the first page it fits on, so the early pages fill up before the later ones get anything
+    for (size_t p = 0; p < pages_.size(); ++p) {
+        Page& page = pages_[p];
+        size_t best = page.skyline.size();
+        uint32_t best_top = 0;
+        uint64_t best_waste = 0;
+        for (size_t i = 0; i < page.skyline.size(); ++i) {
+            uint32_t y;
+            uint64_t waste;
+            if (!fit(page, i, width, height, y, waste)) {
+                continue;
+            }
+            if (best == page.skyline.size() || y + height < best_top || (y + height == best_top && waste < best_waste)) {
+                best = i;
+                best_top = y + height;
+                best_waste = waste;
+            }
+        }
+        if (best < page.skyline.size()) {
+            rect = { static_cast<int>(p), page.skyline[best].x, best_top - height, width, height };
+            place(page, best, rect.x, rect.y, width, height);
+            return true;
+        }
+    }
+    if (max_pages_ > 0 && page_count() >= max_pages_) {
+        return false;
+    }
+    pages_.push_back(new_page());
+    rect = { page_count() - 1, 0, 0, width, height };
+    place(pages_.back(), 0, 0, 0, width, height);
+    return true;
+}
+
+bool AtlasPacker::insert(uint32_t width, uint32_t height, AtlasRect& rect) {
+    // sizes that are all multiples of the alignment keep every skyline segment on its grid
+    if (width == 0 || height == 0 || !insert_padded(padded_size(width), padded_size(height), rect)) {
+        return false;
+    }
+    rect.x += padding_;
+    rect.y += padding_;
+    rect.width = width;
+    rect.height = height;
+    return true;
+}
+
+bool AtlasPacker::pack(const std::vector<AtlasSize>& sizes, std::vector<AtlasRect>& rects) {
+    // tallest first keeps the skyline flat, the short ones fill in the steps the tall ones leave
+    std::vector<size_t> order(sizes.size());
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        if (sizes[a].height != sizes[b].height) {
+            return sizes[a].height > sizes[b].height;
+        }
+        return sizes[a].width > sizes[b].width;
+    });
+    const std::vector<Page> pages = pages_;
+    rects.resize(sizes.size());
+    for (size_t i : order) {
+        if (!insert(sizes[i].width, sizes[i].height, rects[i])) {
+            pages_ = pages;
+            return false;
+        }
+    }
+    return true;
+}
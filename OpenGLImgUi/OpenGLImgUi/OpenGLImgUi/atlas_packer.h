@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// where a packed image went, x and y are inside the padding
+struct AtlasRect {
+    int page;
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct AtlasSize {
+    uint32_t width;
+    uint32_t height;
+};
+
+// packs rectangles into pages of a fixed size with a skyline per page: the top edge of what's packed so far, as
+// segments from left to right. a rectangle goes where its top ends up lowest, ties go to the position that
+// wastes the least area under it, so the pages fill bottom up without tracking every free rectangle
+// - insert() packs one rectangle as it comes, for images that show up at runtime
+// - pack() takes a whole set and packs it tallest first, which fills the pages a lot better. it's what a build
+//   step would run, and what loading a known set of images at startup should use
+// every rectangle gets padding on all sides so filtering and mip levels don't bleed into the neighbours. with an
+// alignment the padded rectangles are rounded up to a multiple of it, so they all start on that grid and a mip
+// level's texels never cover two of them
+class AtlasPacker {
+public:
+    // 0 max pages is unlimited, alignment has to be a power of two
+    AtlasPacker(uint32_t width, uint32_t height, uint32_t padding = 0, int max_pages = 0, uint32_t alignment = 1);
+
+    // false if the rectangle doesn't fit on any page, even a new one
+    bool insert(uint32_t width, uint32_t height, AtlasRect& rect);
+    // rects[i] is where sizes[i] went, false and nothing packed if they don't all fit
+    bool pack(const std::vector<AtlasSize>& sizes, std::vector<AtlasRect>& rects);
+    void reset();
+
+    uint32_t width() const { return width_; }
+    uint32_t height() const { return height_; }
+    uint32_t padding() const { return padding_; }
+    uint32_t alignment() const { return alignment_; }
+    // what a rectangle of this width or height takes up, padding and alignment included
+    uint32_t padded_size(uint32_t size) const { return (size + 2 * padding_ + alignment_ - 1) & ~(alignment_ - 1); }
+    int page_count() const { return static_cast<int>(pages_.size()); }
+    // of the pages in use, padding counts as used
+    double occupancy() const;
+
+private:
+    struct Segment {
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+    };
+
+    struct Page {
+        std::vector<Segment> skyline;
+        uint64_t used_area = 0;
+    };
+
+    // lowest top for a width x height rectangle starting at segment, false if it doesn't fit there
+    bool fit(const Page& page, size_t segment, uint32_t width, uint32_t height, uint32_t& y, uint64_t& waste) const;
+    bool insert_padded(uint32_t width, uint32_t height, AtlasRect& rect);
+    void place(Page& page, size_t segment, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+    Page new_page() const;
+
+    uint32_t width_;
+    uint32_t height_;
+    uint32_t padding_;
+    int max_pages_;
+    uint32_t alignment_;
+    std::vector<Page> pages_;
+};
@@ -0,0 +1,134 @@
+#include "batch_renderer.h"
+#include "geometry_pool.h"
+#include "gl_extensions.h"
+#include "gl_state.h"
+#include <algorithm>
+
+BatchRenderer::BatchRenderer(GLStateCache& gl_state) : gl_state_(gl_state) {
+    // core since 4.3, the extension exports the same entry point without a suffix
+    if (GLAD_GL_VERSION_4_3) {
+        multi_draw_ = glad_glMultiDrawElementsIndirect;
+    } else if (has_gl_extension("GL_ARB_multi_draw_indirect") && has_gl_extension("GL_ARB_draw_indirect")) {
+        multi_draw_ = reinterpret_cast<PFNGLMULTIDRAWELEMENTSINDIRECTPROC>(get_gl_proc("glMultiDrawElementsIndirect"));
+    }
+    if (multi_draw_) {
+        indirect_stream_.reset(new StreamBuffer(gl_state_, GL_DRAW_INDIRECT_BUFFER, 1024 * sizeof(DrawElementsIndirectCommand)));
+    }
+}
+
+BatchRenderer::~BatchRenderer() {
+}
+
+void BatchRenderer::submit(unsigned int program, GeometryPool& pool, int mesh, uint32_t material) {
+    main_list_.draw(0, program, pool, mesh, material);
+}
+
+void BatchRenderer::submit(unsigned int program, GeometryPool& pool, int mesh, uint32_t first, uint32_t count, uint32_t material) {
+    main_list_.draw(0, program, pool, mesh, first, count, material);
+}
+
+void BatchRenderer::flush(const StateCallback& set_state) {
+    flush(nullptr, 0, set_state);
+}
+
+void BatchRenderer::flush(CommandList* const* lists, size_t list_count, const StateCallback& set_state) {
+    last_draw_count_ = 0;
+    last_run_count_ = 0;
+    last_draw_call_count_ = 0;
+
+    // the renderer's own list goes first, so with equal keys its commands stay ahead of the others
+    order_.clear();
+    for (size_t l = 0; l <= list_count; ++l) {
+        const CommandList* list = l == 0 ? &main_list_ : lists[l - 1];
+        for (const RenderCommand& command : list->commands()) {
+            order_.push_back(SortEntry{ command.key, &command });
+            if (command.type == RenderCommand::kDraw) {
+                ++last_draw_count_;
+            }
+        }
+    }
+    if (order_.empty()) {
+        return;
+    }
+    radix_sort(order_, sort_scratch_);
+
+    // the draw commands go straight into mapped memory in sorted order, each run is a contiguous slice of them
+    // state commands take no slot
+    size_t indirect_offset = 0;
+    if (multi_draw_ && last_draw_count_ > 0) {
+        size_t bytes = last_draw_count_ * sizeof(DrawElementsIndirectCommand);
+        if (bytes > indirect_stream_->frame_bytes()) {
+            indirect_stream_->resize(std::max(bytes, indirect_stream_->frame_bytes() * 2));
+        }
+        DrawElementsIndirectCommand* commands = static_cast<DrawElementsIndirectCommand*>(
+            indirect_stream_->allocate(bytes, sizeof(DrawElementsIndirectCommand), indirect_offset));
+        for (const SortEntry& entry : order_) {
+            if (entry.command->type == RenderCommand::kDraw) {
+                *commands++ = entry.command->draw;
+            }
+        }
+        indirect_stream_->commit();
+        gl_state_.bind_buffer(GL_DRAW_INDIRECT_BUFFER, indirect_stream_->buffer());
+    }
+
+    unsigned int current_program = 0;
+    uint32_t current_material = 0;
+    bool first_run = true;
+    size_t draw_index = 0;
+    for (size_t begin = 0; begin < order_.size(); ) {
+        const RenderCommand& command = *order_[begin].command;
+        if (command.type == RenderCommand::kClear) {
+            glClearColor(command.clear_color[0], command.clear_color[1], command.clear_color[2], command.clear_color[3]);
+            glClear(GL_COLOR_BUFFER_BIT);
+            ++begin;
+            continue;
+        }
+        if (command.type == RenderCommand::kPolygonMode) {
+            gl_state_.polygon_mode(command.polygon_mode);
+            ++begin;
+            continue;
+        }
+
+        size_t end = begin + 1;
+        while (end < order_.size()) {
+            const RenderCommand& next = *order_[end].command;
+            if (next.type != RenderCommand::kDraw || next.program != command.program || next.pool != command.pool ||
+                next.material != command.material) {
+                break;
+            }
+            ++end;
+        }
+
+        gl_state_.use_program(command.program);
+        command.pool->bind();
+        if (first_run || command.program != current_program || command.material != current_material) {
+            set_state(command.program, command.material);
+            current_program = command.program;
+            current_material = command.material;
+            first_run = false;
+        }
+
+        if (multi_draw_) {
+            const void* offset = reinterpret_cast<const void*>(indirect_offset + draw_index * sizeof(DrawElementsIndirectCommand));
+            multi_draw_(GL_TRIANGLES, command.pool->index_type(), offset, static_cast<GLsizei>(end - begin), 0);
+            ++last_draw_call_count_;
+        } else {
+            for (size_t i = begin; i < end; ++i) {
+                const DrawElementsIndirectCommand& draw = order_[i].command->draw;
+                const void* offset = reinterpret_cast<const void*>(size_t(draw.first_index) * command.pool->index_size());
+                glDrawElementsBaseVertex(GL_TRIANGLES, draw.count, command.pool->index_type(), offset, draw.base_vertex);
+            }
+            last_draw_call_count_ += end - begin;
+        }
+        draw_index += end - begin;
+        ++last_run_count_;
+        begin = end;
+    }
+    if (indirect_stream_ && last_draw_count_ > 0) {
+        indirect_stream_->end_frame();
+    }
+    main_list_.reset();
+    for (size_t l = 0; l < list_count; ++l) {
+        lists[l]->reset();
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "command_list.h"
+#include "stream_buffer.h"
+
+class GeometryPool;
+class GLStateCache;
+
+// replays the command lists of a frame, merged and radix sorted by their keys (layer, program, material, depth)
+// consecutive draws that share program, geometry pool and material are one run, and a run is one glMultiDrawElementsIndirect out of
+// the frame's region of a persistently mapped indirect buffer. without ARB_multi_draw_indirect (or GL 4.3) a run falls back to a loop of
+// glDrawElementsBaseVertex, the sorting still saves the state changes
+// everything is kept in flat arrays that are reused every frame, so submitting costs the same per draw
+// no matter how many there are
+class BatchRenderer {
+public:
+    // called whenever a run needs a different program or material, after the program is in use
+    // (set uniforms, bind textures, ...)
+    using StateCallback = std::function<void(unsigned int program, uint32_t material)>;
+
+    explicit BatchRenderer(GLStateCache& gl_state);
+    ~BatchRenderer();
+    BatchRenderer(const BatchRenderer&) = delete;
+    BatchRenderer& operator=(const BatchRenderer&) = delete;
+
+    // records into the renderer's own list at layer 0, for draws made on the gl thread
+    // first/count pick indices out of the mesh, e.g. one submesh. the pool has to outlive the flush
+    void submit(unsigned int program, GeometryPool& pool, int mesh, uint32_t material = 0);
+    void submit(unsigned int program, GeometryPool& pool, int mesh, uint32_t first, uint32_t count, uint32_t material = 0);
+
+    // sort, write the commands and draw everything submitted since the last flush
+    // the indirect buffer moves on to its next region afterwards, so flush once per frame
+    void flush(const StateCallback& set_state);
+    // the same with lists recorded elsewhere (e.g. by a CommandRecorder) merged in. all lists are reset
+    // afterwards, their recording threads must be done with them
+    void flush(CommandList* const* lists, size_t list_count, const StateCallback& set_state);
+
+    bool multi_draw_indirect() const { return multi_draw_ != nullptr; }
+    // of the last flush: draws submitted, runs, and the gl draw calls they took
+    size_t draw_count() const { return last_draw_count_; }
+    size_t run_count() const { return last_run_count_; }
+    size_t draw_call_count() const { return last_draw_call_count_; }
+
+private:
+    GLStateCache& gl_state_;
+    PFNGLMULTIDRAWELEMENTSINDIRECTPROC multi_draw_ = nullptr;
+    // only there with multi draw indirect
+    std::unique_ptr<StreamBuffer> indirect_stream_;
+
+    CommandList main_list_;
+    // key + command, sorted instead of the commands themselves
+    std::vector<SortEntry> order_;
+    std::vector<SortEntry> sort_scratch_;
+    size_t last_draw_count_ = 0;
+    size_t last_run_count_ = 0;
+    size_t last_draw_call_count_ = 0;
+};
@@ -0,0 +1,96 @@
+#include "command_list.h"
+#include "geometry_pool.h"
+#include <algorithm>
+#include <cstring>
+
+uint64_t CommandList::make_key(uint32_t layer, unsigned int program, uint32_t material, uint32_t depth) {
+    // gl names are handed out from 1 upwards, 18 bits is plenty
+    const uint64_t layer_mask = (1u << kLayerBits) - 1;
+    const uint64_t program_mask = (1u << kProgramBits) - 1;
+    const uint64_t material_mask = (1u << kMaterialBits) - 1;
+    const uint64_t depth_mask = (1u << kDepthBits) - 1;
+    return ((layer & layer_mask) << (kProgramBits + kMaterialBits + kDepthBits)) |
+           ((program & program_mask) << (kMaterialBits + kDepthBits)) |
+           ((material & material_mask) << kDepthBits) |
+           (depth & depth_mask);
+}
+
+uint32_t CommandList::quantize_depth(float depth) {
+    const float scale = static_cast<float>((1u << kDepthBits) - 1);
+    return static_cast<uint32_t>(std::min(std::max(depth, 0.0f), 1.0f) * scale);
+}
+
+RenderCommand& CommandList::add(RenderCommand::Type type, uint64_t key) {
+    commands_.emplace_back();
+    RenderCommand& command = commands_.back();
+    std::memset(&command, 0, sizeof(command));
+    command.key = key;
+    command.type = type;
+    return command;
+}
+
+void CommandList::draw(uint32_t layer, unsigned int program, GeometryPool& pool, int mesh, uint32_t material, float depth) {
+    draw(layer, program, pool, mesh, 0, pool.mesh(mesh).index_count, material, depth);
+}
+
+void CommandList::draw(uint32_t layer, unsigned int program, GeometryPool& pool, int mesh, uint32_t first, uint32_t count,
+                       uint32_t material, float depth) {
+    const MeshRange& range = pool.mesh(mesh);
+    RenderCommand& command = add(RenderCommand::kDraw, make_key(layer, program, material, quantize_depth(depth)));
+    command.program = program;
+    command.material = material;
+    command.pool = &pool;
+    command.draw.count = count;
+    command.draw.instance_count = 1;
+    command.draw.first_index = range.first_index + first;
+    command.draw.base_vertex = static_cast<int32_t>(range.base_vertex);
+    command.draw.base_instance = 0;
+}
+
+void CommandList::clear(uint32_t layer, const float color[4]) {
+    RenderCommand& command = add(RenderCommand::kClear, make_key(layer, 0, 0, 0));
+    std::memcpy(command.clear_color, color, sizeof(command.clear_color));
+}
+
+void CommandList::polygon_mode(uint32_t layer, GLenum mode) {
+    RenderCommand& command = add(RenderCommand::kPolygonMode, make_key(layer, 0, 0, 0));
+    command.polygon_mode = mode;
+}
+
+void radix_sort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch) {
+    const size_t count = entries.size();
+    if (count < 2) {
+        return;
+    }
+    // every pass's histogram in one go over the keys
+    size_t histograms[8][256] = {};
+    for (const SortEntry& entry : entries) {
+        for (int pass = 0; pass < 8; ++pass) {
+            ++histograms[pass][(entry.key >> (pass * 8)) & 0xFF];
+        }
+    }
+    scratch.resize(count);
+    SortEntry* source = entries.data();
+    SortEntry* target = scratch.data();
+    for (int pass = 0; pass < 8; ++pass) {
+        size_t* histogram = histograms[pass];
+        const int shift = pass * 8;
+        // all keys share this byte, the pass wouldn't move anything
+        if (histogram[(source[0].key >> shift) & 0xFF] == count) {
+            continue;
+        }
+        size_t offset = 0;
+        for (int digit = 0; digit < 256; ++digit) {
+            size_t digit_count = histogram[digit];
+            histogram[digit] = offset;
+            offset += digit_count;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            target[histogram[(source[i].key >> shift) & 0xFF]++] = source[i];
+        }
+        std::swap(source, target);
+    }
+    if (source != entries.data()) {
+        entries.swap(scratch);
+    }
+}
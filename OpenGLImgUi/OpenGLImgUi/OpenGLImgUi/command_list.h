@@ -0,0 +1,80 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class GeometryPool;
+
+// layout glMultiDrawElementsIndirect reads from the indirect buffer
+struct DrawElementsIndirectCommand {
+    uint32_t count;
+    uint32_t instance_count;
+    uint32_t first_index;
+    int32_t base_vertex;
+    uint32_t base_instance;
+};
+
+// one recorded command, plain data so lists fill up on any thread and merge by copying
+struct RenderCommand {
+    enum Type : uint8_t {
+        kDraw,
+        kClear,
+        kPolygonMode
+    };
+
+    uint64_t key;
+    Type type;
+    unsigned int program;
+    uint32_t material;
+    GeometryPool* pool;
+    union {
+        DrawElementsIndirectCommand draw;
+        float clear_color[4];
+        GLenum polygon_mode;
+    };
+};
+
+// commands recorded by one thread, replayed by BatchRenderer::flush after all lists are merged and sorted
+// the key sorts by layer, then program, then material, then depth, most significant first. state commands
+// (clear, polygon mode) have 0 for everything below the layer, so they go before every draw of their layer
+// and keep their recording order among themselves
+// recording only reads the pool's mesh table, meshes must not be added or removed while lists are recorded
+class CommandList {
+public:
+    static const int kLayerBits = 6;
+    static const int kProgramBits = 18;
+    static const int kMaterialBits = 16;
+    static const int kDepthBits = 24;
+
+    static uint64_t make_key(uint32_t layer, unsigned int program, uint32_t material, uint32_t depth);
+    // depth 0..1 to the key's depth bits, so nearer draws sort first. pass 1 - depth for back to front
+    static uint32_t quantize_depth(float depth);
+
+    void draw(uint32_t layer, unsigned int program, GeometryPool& pool, int mesh, uint32_t material = 0, float depth = 0.0f);
+    // first/count pick indices out of the mesh, e.g. one submesh
+    void draw(uint32_t layer, unsigned int program, GeometryPool& pool, int mesh, uint32_t first, uint32_t count,
+              uint32_t material = 0, float depth = 0.0f);
+    // glClear of the color buffer
+    void clear(uint32_t layer, const float color[4]);
+    void polygon_mode(uint32_t layer, GLenum mode);
+
+    void reset() { commands_.clear(); }
+    bool empty() const { return commands_.empty(); }
+    size_t size() const { return commands_.size(); }
+    const std::vector<RenderCommand>& commands() const { return commands_; }
+
+private:
+    RenderCommand& add(RenderCommand::Type type, uint64_t key);
+
+    std::vector<RenderCommand> commands_;
+};
+
+struct SortEntry {
+    uint64_t key;
+    const RenderCommand* command;
+};
+
+// lsd radix sort by key, a byte per pass, stable so equal keys keep the order they were added in
+// passes where every key has the same byte are skipped, which is most of them for real keys
+void radix_sort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch);
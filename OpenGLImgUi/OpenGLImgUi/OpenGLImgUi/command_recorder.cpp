@@ -0,0 +1,81 @@
+#include "command_recorder.h"
+#include <algorithm>
+
+CommandRecorder::CommandRecorder(unsigned int threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+    }
+    lists_.resize(threads);
+    ranges_.resize(threads);
+    for (CommandList& list : lists_) {
+        list_pointers_.push_back(&list);
+    }
+    for (unsigned int i = 1; i < threads; ++i) {
+        workers_.emplace_back(&CommandRecorder::worker_main, this, i);
+    }
+}
+
+CommandRecorder::~CommandRecorder() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    start_cv_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+void CommandRecorder::record(size_t item_count, const RecordFunction& record) {
+    for (CommandList& list : lists_) {
+        list.reset();
+    }
+    const size_t threads = std::max<size_t>(1, std::min<size_t>(lists_.size(), item_count / kMinItemsPerThread));
+    if (threads == 1) {
+        record(lists_[0], 0, item_count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < ranges_.size(); ++i) {
+            // workers past the used ones get an empty range and go back to sleep
+            ranges_[i].begin = std::min(item_count, item_count * i / threads);
+            ranges_[i].end = std::min(item_count, item_count * (i + 1) / threads);
+        }
+        record_ = &record;
+        busy_ = static_cast<unsigned int>(workers_.size());
+        ++generation_;
+    }
+    start_cv_.notify_all();
+    record(lists_[0], ranges_[0].begin, ranges_[0].end);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [&] { return busy_ == 0; });
+    record_ = nullptr;
+}
+
+void CommandRecorder::worker_main(unsigned int index) {
+    uint64_t seen = 0;
+    while (true) {
+        Range range;
+        const RecordFunction* record;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_cv_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+            if (stopping_) {
+                return;
+            }
+            seen = generation_;
+            range = ranges_[index];
+            record = record_;
+        }
+        if (range.begin < range.end) {
+            (*record)(lists_[index], range.begin, range.end);
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--busy_ == 0) {
+            done_cv_.notify_one();
+        }
+    }
+}
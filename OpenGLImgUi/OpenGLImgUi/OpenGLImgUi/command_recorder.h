@@ -0,0 +1,57 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "command_list.h"
+
+// records command lists on worker threads, one list per thread, so walking the scene and preparing draws
+// scales across cores while only BatchRenderer::flush talks to the driver
+// the workers live as long as the recorder and sleep between frames. a frame's items are split into one
+// contiguous range per thread, the calling thread takes the first one, and ranges smaller than
+// kMinItemsPerThread aren't worth waking a thread for, so small scenes are recorded inline
+class CommandRecorder {
+public:
+    // the range is [begin, end) of the items, everything recorded goes into list
+    using RecordFunction = std::function<void(CommandList& list, size_t begin, size_t end)>;
+
+    // 0 picks one per core, up to 4
+    explicit CommandRecorder(unsigned int threads = 0);
+    ~CommandRecorder();
+    CommandRecorder(const CommandRecorder&) = delete;
+    CommandRecorder& operator=(const CommandRecorder&) = delete;
+
+    // clears the lists and records item_count items with record, returns when all threads are done
+    void record(size_t item_count, const RecordFunction& record);
+
+    // what the last record() filled, for BatchRenderer::flush. some may be empty
+    CommandList* const* lists() { return list_pointers_.data(); }
+    size_t list_count() const { return list_pointers_.size(); }
+    unsigned int thread_count() const { return static_cast<unsigned int>(lists_.size()); }
+
+private:
+    static const size_t kMinItemsPerThread = 256;
+
+    struct Range {
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    void worker_main(unsigned int index);
+
+    std::vector<CommandList> lists_;
+    std::vector<CommandList*> list_pointers_;
+    std::vector<std::thread> workers_;
+    // worker i records ranges_[i + 1], the caller ranges_[0]
+    std::vector<Range> ranges_;
+    const RecordFunction* record_ = nullptr;
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    uint64_t generation_ = 0;
+    unsigned int busy_ = 0;
+    bool stopping_ = false;
+};
@@ -0,0 +1,72 @@
+#include "file_watcher.h"
+#include <algorithm>
+#include <iostream>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+FileWatcher::FileWatcher(const std::string& directory) : directory_(directory) {
+#ifdef __linux__
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    // close_write covers editors that write in place, moved_to the ones that write a temp file and rename it
+    if (inotify_fd_ < 0 || inotify_add_watch(inotify_fd_, directory_.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        std::cout << "file watcher: can't watch " << directory_ << ": " << std::strerror(errno) << std::endl;
+    }
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+    if (inotify_fd_ >= 0) {
+        close(inotify_fd_);
+    }
+#endif
+}
+
+void FileWatcher::watch(const std::string& file_name) {
+    std::error_code error;
+    files_[file_name] = std::filesystem::last_write_time(std::filesystem::path(directory_) / file_name, error);
+}
+
+std::vector<std::string> FileWatcher::poll() {
+    std::vector<std::string> changed;
+#ifdef __linux__
+    if (inotify_fd_ < 0) {
+        return changed;
+    }
+    alignas(inotify_event) char buffer[4096];
+    for (;;) {
+        ssize_t length = read(inotify_fd_, buffer, sizeof(buffer));
+        if (length <= 0) {
+            // EAGAIN, nothing more queued
+            break;
+        }
+        for (char* at = buffer; at < buffer + length; ) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(at);
+            if (event->len > 0 && files_.count(event->name) != 0 &&
+                std::find(changed.begin(), changed.end(), event->name) == changed.end()) {
+                changed.push_back(event->name);
+            }
+            at += sizeof(inotify_event) + event->len;
+        }
+    }
+#else
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_scan_ < kScanInterval) {
+        return changed;
+    }
+    last_scan_ = now;
+    for (auto& file : files_) {
+        std::error_code error;
+        auto write_time = std::filesystem::last_write_time(std::filesystem::path(directory_) / file.first, error);
+        if (!error && write_time != file.second) {
+            file.second = write_time;
+            changed.push_back(file.first);
+        }
+    }
+#endif
+    return changed;
+}
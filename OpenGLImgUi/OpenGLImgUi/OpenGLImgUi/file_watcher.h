@@ -0,0 +1,33 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// reports files in a directory that were written since the last poll, never blocks
+// on linux this is an inotify descriptor we drain once per frame, everywhere else we compare
+// modification times of the watched files every kScanInterval
+class FileWatcher {
+public:
+    explicit FileWatcher(const std::string& directory);
+    ~FileWatcher();
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // only files registered here are reported, name is relative to the directory
+    void watch(const std::string& file_name);
+
+    // names of the watched files that changed since the last call, each name at most once
+    std::vector<std::string> poll();
+
+private:
+    std::string directory_;
+    std::unordered_map<std::string, std::filesystem::file_time_type> files_;
+#ifdef __linux__
+    int inotify_fd_ = -1;
+#else
+    static constexpr std::chrono::milliseconds kScanInterval{ 250 };
+    std::chrono::steady_clock::time_point last_scan_;
+#endif
+};
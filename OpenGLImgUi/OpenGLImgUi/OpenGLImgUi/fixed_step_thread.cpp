@@ -0,0 +1,60 @@
+#include "fixed_step_thread.h"
+#include <algorithm>
+
+FixedStepThread::FixedStepThread(double rate, std::function<void(uint64_t step)> step)
+    : step_seconds_(1.0 / rate), step_(std::move(step)) {
+}
+
+FixedStepThread::~FixedStepThread() {
+    stop();
+}
+
+void FixedStepThread::start() {
+    if (running_) {
+        return;
+    }
+    start_ = Clock::now();
+    running_ = true;
+    thread_ = std::thread(&FixedStepThread::run, this);
+}
+
+void FixedStepThread::stop() {
+    running_ = false;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+double FixedStepThread::time() const {
+    if (!running_ && steps_ == 0) {
+        return 0.0;
+    }
+    auto elapsed = Clock::now() - start_ - std::chrono::nanoseconds(dropped_ns_.load());
+    return std::chrono::duration<double>(elapsed).count();
+}
+
+void FixedStepThread::run() {
+    const auto step_duration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(step_seconds_));
+    uint64_t step = 0;
+    while (running_) {
+        Clock::time_point due = start_ + std::chrono::nanoseconds(dropped_ns_.load()) + step_duration * (step + 1);
+        Clock::time_point now = Clock::now();
+        if (now < due) {
+            std::this_thread::sleep_until(due);
+            continue;
+        }
+        // too far behind to catch up, give up on the missed steps and go on from now
+        if (now - due > step_duration * kMaxCatchUp) {
+            uint64_t missed = static_cast<uint64_t>((now - due) / step_duration);
+            dropped_ += missed;
+            dropped_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(step_duration * missed).count();
+        }
+
+        auto begin = Clock::now();
+        step_(++step);
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+        step_ms_total_ += ms;
+        step_ms_max_ = std::max(step_ms_max_, ms);
+        ++steps_;
+    }
+}
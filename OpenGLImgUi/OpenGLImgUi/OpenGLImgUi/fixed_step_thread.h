@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+// calls step at a fixed rate on its own thread, so simulation cost doesn't add to the frame time and the
+// simulation advances the same no matter how fast the render loop runs
+// steps are scheduled on the steady clock from start(): if one runs late the next ones follow right away to
+// catch up, and if it falls more than kMaxCatchUp steps behind the missed time is dropped instead of running
+// a burst of steps that would only fall further behind
+class FixedStepThread {
+public:
+    // step gets the number of the step, starting at 1. step n simulates up to n / rate seconds
+    FixedStepThread(double rate, std::function<void(uint64_t step)> step);
+    ~FixedStepThread();
+    FixedStepThread(const FixedStepThread&) = delete;
+    FixedStepThread& operator=(const FixedStepThread&) = delete;
+
+    void start();
+    // finishes the step that is running, then joins
+    void stop();
+
+    double step_seconds() const { return step_seconds_; }
+    // seconds of simulation time the schedule is at right now, what the renderer interpolates with
+    double time() const;
+
+    uint64_t steps() const { return steps_; }
+    // steps skipped because the thread fell too far behind
+    uint64_t dropped() const { return dropped_; }
+    double step_ms_average() const { return steps_ ? step_ms_total_ / steps_ : 0.0; }
+    double step_ms_max() const { return step_ms_max_; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    static constexpr int kMaxCatchUp = 5;
+
+    void run();
+
+    double step_seconds_;
+    std::function<void(uint64_t)> step_;
+    std::thread thread_;
+    std::atomic<bool> running_{ false };
+    Clock::time_point start_;
+    // the schedule moves later by this much for every dropped step, so time() stays on the simulated steps
+    std::atomic<int64_t> dropped_ns_{ 0 };
+    std::atomic<uint64_t> steps_{ 0 };
+    std::atomic<uint64_t> dropped_{ 0 };
+    double step_ms_total_ = 0.0;
+    double step_ms_max_ = 0.0;
+};
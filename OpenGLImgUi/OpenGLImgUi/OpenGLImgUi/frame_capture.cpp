@@ -0,0 +1,196 @@
+#include "frame_capture.h"
+#include "gl_state.h"
+#include "png_writer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+FrameCapture::FrameCapture(GLStateCache& gl_state, const std::string& directory, Format format, int ring_size)
+    : gl_state_(gl_state), directory_(directory), format_(format), slots_(std::max(2, ring_size)) {
+    std::error_code error;
+    std::filesystem::create_directories(directory_, error);
+    if (error) {
+        std::cout << "ERROR::CAPTURE::NO_DIRECTORY: " << directory_ << ": " << error.message() << std::endl;
+        return;
+    }
+    valid_ = true;
+    writer_ = std::thread(&FrameCapture::writer_main, this);
+}
+
+FrameCapture::~FrameCapture() {
+    finish();
+}
+
+void FrameCapture::capture(unsigned int framebuffer, int width, int height) {
+    if (!valid_ || width <= 0 || height <= 0) {
+        return;
+    }
+    auto begin = std::chrono::steady_clock::now();
+    const int ring = static_cast<int>(slots_.size());
+    // whatever the gpu finished goes to the writer, oldest first so frames stay in order
+    while (in_flight_ > 0 && retire(slots_[(head_ - in_flight_ + ring) % ring], false)) {
+        --in_flight_;
+    }
+    Slot& slot = slots_[head_];
+    // the whole ring is in flight and the oldest read is the slot we want
+    if (in_flight_ == ring) {
+        ++stalls_;
+        retire(slot, true);
+        --in_flight_;
+    }
+
+    if (slot.buffer == 0) {
+        glGenBuffers(1, &slot.buffer);
+    }
+    gl_state_.bind_buffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    size_t bytes = size_t(width) * height * 4;
+    if (slot.bytes != bytes) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+        slot.bytes = bytes;
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadBuffer(framebuffer ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    // with a pack buffer bound this only queues the copy, the last argument is an offset into the buffer
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    // a plain glReadPixels elsewhere would write into the buffer otherwise
+    gl_state_.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = frame_++;
+    slot.width = width;
+    slot.height = height;
+    head_ = (head_ + 1) % ring;
+    ++in_flight_;
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    capture_ms_max_ = std::max(capture_ms_max_, ms);
+    capture_ms_total_ += ms;
+}
+
+bool FrameCapture::retire(Slot& slot, bool wait) {
+    GLenum status = glClientWaitSync(slot.fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        if (!wait) {
+            return false;
+        }
+        do {
+            status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    std::vector<unsigned char> pixels;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (queue_.size() >= kMaxQueuedFrames) {
+            if (!wait_for_writer_) {
+                ++dropped_;
+                return true;
+            }
+            ++writer_waits_;
+            room_cv_.wait(lock, [&] { return queue_.size() < kMaxQueuedFrames; });
+        }
+        if (!free_pixels_.empty()) {
+            pixels = std::move(free_pixels_.back());
+            free_pixels_.pop_back();
+        }
+    }
+    const size_t row = size_t(slot.width) * 4;
+    pixels.resize(row * slot.height);
+    gl_state_.bind_buffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    const unsigned char* mapped = static_cast<const unsigned char*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.bytes, GL_MAP_READ_BIT));
+    if (mapped) {
+        // gl's first row is the bottom one, flipped while copying since we touch every byte anyway
+        for (int y = 0; y < slot.height; ++y) {
+            std::memcpy(&pixels[y * row], mapped + (slot.height - 1 - y) * row, row);
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    gl_state_.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (!mapped) {
+        std::cout << "ERROR::CAPTURE::MAP_FAILED: frame " << slot.frame << std::endl;
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back({ slot.frame, slot.width, slot.height, std::move(pixels) });
+    }
+    cv_.notify_one();
+    return true;
+}
+
+void FrameCapture::finish() {
+    if (!valid_) {
+        return;
+    }
+    const int ring = static_cast<int>(slots_.size());
+    while (in_flight_ > 0) {
+        retire(slots_[(head_ - in_flight_ + ring) % ring], true);
+        --in_flight_;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_one();
+    writer_.join();
+    for (Slot& slot : slots_) {
+        if (slot.buffer) {
+            glDeleteBuffers(1, &slot.buffer);
+            slot.buffer = 0;
+            slot.bytes = 0;
+        }
+    }
+    // the deleted names were bound and may come back for other buffers
+    gl_state_.invalidate();
+    valid_ = false;
+}
+
+void FrameCapture::writer_main() {
+    const char* extension = format_ == kPng ? "png" : "rgba";
+    std::vector<unsigned char> png;
+    bool reported = false;
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [&] { return stopping_ || !queue_.empty(); });
+            // drain what is queued before stopping
+            if (queue_.empty()) {
+                return;
+            }
+            job = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        room_cv_.notify_one();
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%06llu.%s", static_cast<unsigned long long>(job.frame), extension);
+        std::string path = (std::filesystem::path(directory_) / name).string();
+        const unsigned char* data = job.pixels.data();
+        size_t size = job.pixels.size();
+        if (format_ == kPng) {
+            encode_png(job.width, job.height, job.pixels.data(), png);
+            data = png.data();
+            size = png.size();
+        }
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(data), size);
+        if (file) {
+            ++written_;
+        } else if (!reported) {
+            // once, a full disk would print this for every frame
+            std::cout << "ERROR::CAPTURE::WRITE_FAILED: " << path << std::endl;
+            reported = true;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_pixels_.push_back(std::move(job.pixels));
+    }
+}
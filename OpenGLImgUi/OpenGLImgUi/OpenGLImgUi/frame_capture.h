@@ -0,0 +1,104 @@
+#pragma once
+#include <glad/glad.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class GLStateCache;
+
+// writes rendered frames to disk without the stall of a plain glReadPixels
+// capture() reads the frame into one of a ring of pixel pack buffers and fences it, so the gpu copies while we
+// go on with the next frames. the pixels are picked up once the fence passed, normally ring_size - 1 frames
+// later, and all the render thread does with them is one copy out of the mapping. a writer thread encodes and
+// writes them. if it falls kMaxQueuedFrames behind, frames are dropped rather than making the render loop wait,
+// unless set_wait_for_writer says otherwise
+class FrameCapture {
+public:
+    enum Format {
+        kPng,
+        // the rgba bytes as read, top row first, e.g. for ffmpeg -f rawvideo -pix_fmt rgba -s <width>x<height>
+        kRaw
+    };
+
+    // files go to directory/frame_000000.png (or .rgba), numbered by capture
+    FrameCapture(GLStateCache& gl_state, const std::string& directory, Format format, int ring_size = 3);
+    ~FrameCapture();
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // call once the frame is drawn, before the swap. framebuffer 0 is the window's back buffer
+    void capture(unsigned int framebuffer, int width, int height);
+    // reads back what is still in flight, waits for the writer and frees the buffers
+    // the context has to be current, so call it before tearing that down
+    void finish();
+
+    // offline runs (--headless) have no frame deadline and would rather wait for the writer than lose frames
+    void set_wait_for_writer(bool wait) { wait_for_writer_ = wait; }
+
+    bool valid() const { return valid_; }
+    uint64_t captured() const { return frame_; }
+    uint64_t written() const { return written_; }
+    // frames the writer had no room for
+    uint64_t dropped() const { return dropped_; }
+    // captures that found the whole ring still in flight and waited for the oldest read
+    uint64_t stalls() const { return stalls_; }
+    // captures that waited for the writer to make room
+    uint64_t writer_waits() const { return writer_waits_; }
+    // time capture() took on the render thread
+    double capture_ms_max() const { return capture_ms_max_; }
+    double capture_ms_average() const { return frame_ ? capture_ms_total_ / frame_ : 0.0; }
+
+private:
+    static const size_t kMaxQueuedFrames = 8;
+
+    struct Slot {
+        unsigned int buffer = 0;
+        size_t bytes = 0;
+        GLsync fence = nullptr;
+        uint64_t frame = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    struct Job {
+        uint64_t frame;
+        int width;
+        int height;
+        std::vector<unsigned char> pixels;
+    };
+
+    // hands the slot's pixels to the writer, returns false without waiting if the read isn't done yet
+    bool retire(Slot& slot, bool wait);
+    void writer_main();
+
+    GLStateCache& gl_state_;
+    std::string directory_;
+    Format format_;
+    bool valid_ = false;
+    bool wait_for_writer_ = false;
+    std::vector<Slot> slots_;
+    // the next slot to read into, the in_flight_ ones before it are waiting on the gpu
+    int head_ = 0;
+    int in_flight_ = 0;
+    uint64_t frame_ = 0;
+    uint64_t dropped_ = 0;
+    uint64_t stalls_ = 0;
+    uint64_t writer_waits_ = 0;
+    double capture_ms_max_ = 0.0;
+    double capture_ms_total_ = 0.0;
+
+    std::thread writer_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable room_cv_;
+    std::deque<Job> queue_;
+    // pixel vectors the writer is done with, reused so steady capturing doesn't allocate
+    std::vector<std::vector<unsigned char>> free_pixels_;
+    bool stopping_ = false;
+    std::atomic<uint64_t> written_{ 0 };
+};
@@ -0,0 +1,514 @@
+#include "frame_graph.h"
+#include "gl_extensions.h"
+#include "gl_state.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+struct TextureFormat {
+    GLenum internal_format;
+    // what glTexImage2D wants along with it, there is no data so only the combination has to be valid
+    GLenum format;
+    GLenum type;
+    size_t bytes_per_pixel;
+};
+
+const TextureFormat kTextureFormats[] = {
+    { GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1 },
+    { GL_RG8, GL_RG, GL_UNSIGNED_BYTE, 2 },
+    { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4 },
+    { GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE, 4 },
+    { GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, 4 },
+    { GL_R11F_G11F_B10F, GL_RGB, GL_FLOAT, 4 },
+    { GL_R16F, GL_RED, GL_FLOAT, 2 },
+    { GL_RG16F, GL_RG, GL_FLOAT, 4 },
+    { GL_RGBA16F, GL_RGBA, GL_FLOAT, 8 },
+    { GL_R32F, GL_RED, GL_FLOAT, 4 },
+    { GL_RG32F, GL_RG, GL_FLOAT, 8 },
+    { GL_RGBA32F, GL_RGBA, GL_FLOAT, 16 },
+    { GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, 4 },
+    { GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 4 },
+    { GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, 4 },
+    { GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, 4 },
+    { GL_DEPTH32F_STENCIL8, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV, 8 }
+};
+
+const TextureFormat* find_texture_format(GLenum internal_format) {
+    for (const TextureFormat& format : kTextureFormats) {
+        if (format.internal_format == internal_format) {
+            return &format;
+        }
+    }
+    return nullptr;
+}
+
+bool same_desc(const FrameGraphTextureDesc& a, const FrameGraphTextureDesc& b) {
+    return a.width == b.width && a.height == b.height && a.format == b.format;
+}
+
+}
+
+FrameGraph::FrameGraph(GLStateCache& gl_state) : gl_state_(gl_state) {
+    // image load/store and storage buffers came with 4.2 and 4.3, without them there is nothing to synchronize
+    has_memory_barrier_ = GLAD_GL_VERSION_4_2 || has_gl_extension("GL_ARB_shader_image_load_store");
+}
+
+FrameGraph::~FrameGraph() {
+    for (const CachedFramebuffer& cached : framebuffers_) {
+        glDeleteFramebuffers(1, &cached.framebuffer);
+    }
+    for (const Physical& physical : physicals_) {
+        if (physical.type == kTexture) {
+            glDeleteTextures(1, &physical.object);
+        } else {
+            glDeleteBuffers(1, &physical.object);
+        }
+    }
+    gl_state_.invalidate();
+}
+
+FrameGraph::PassBuilder& FrameGraph::PassBuilder::read(int resource, Access access) {
+    graph_.passes_[pass_].accesses.push_back(AccessRecord{ resource, access, false });
+    return *this;
+}
+
+FrameGraph::PassBuilder& FrameGraph::PassBuilder::write(int resource, Access access) {
+    graph_.passes_[pass_].accesses.push_back(AccessRecord{ resource, access, true });
+    return *this;
+}
+
+FrameGraph::PassBuilder& FrameGraph::PassBuilder::side_effect() {
+    graph_.passes_[pass_].side_effect = true;
+    return *this;
+}
+
+int FrameGraph::add_resource(const char* name, ResourceType type, bool imported, const FrameGraphTextureDesc& desc, size_t size,
+                             unsigned int object) {
+    Resource resource;
+    resource.name = name;
+    resource.type = type;
+    resource.imported = imported;
+    resource.desc = desc;
+    resource.size = size;
+    resource.object = object;
+    resources_.push_back(resource);
+    return static_cast<int>(resources_.size() - 1);
+}
+
+int FrameGraph::create_texture(const char* name, const FrameGraphTextureDesc& desc) {
+    if (!find_texture_format(desc.format)) {
+        std::cout << "ERROR::FRAME_GRAPH::UNKNOWN_FORMAT: " << name << " 0x" << std::hex << desc.format << std::dec << std::endl;
+        return -1;
+    }
+    return add_resource(name, kTexture, false, desc, texture_bytes(desc), 0);
+}
+
+int FrameGraph::create_buffer(const char* name, size_t size) {
+    return add_resource(name, kBuffer, false, FrameGraphTextureDesc{ 0, 0, GL_NONE }, size, 0);
+}
+
+int FrameGraph::import_texture(const char* name, unsigned int texture, const FrameGraphTextureDesc& desc) {
+    return add_resource(name, kTexture, true, desc, 0, texture);
+}
+
+int FrameGraph::import_buffer(const char* name, unsigned int buffer, size_t size) {
+    return add_resource(name, kBuffer, true, FrameGraphTextureDesc{ 0, 0, GL_NONE }, size, buffer);
+}
+
+int FrameGraph::import_framebuffer(const char* name, unsigned int framebuffer, int width, int height) {
+    return add_resource(name, kFramebuffer, true, FrameGraphTextureDesc{ width, height, GL_NONE }, 0, framebuffer);
+}
+
+FrameGraph::PassBuilder FrameGraph::add_pass(const char* name, ExecuteFunction execute) {
+    Pass pass;
+    pass.name = name;
+    pass.execute = std::move(execute);
+    passes_.push_back(std::move(pass));
+    compiled_ = false;
+    return PassBuilder(*this, static_cast<int>(passes_.size() - 1));
+}
+
+unsigned int FrameGraph::texture(int resource) const {
+    return resources_[resource].object;
+}
+
+unsigned int FrameGraph::buffer(int resource) const {
+    return resources_[resource].object;
+}
+
+const FrameGraphTextureDesc& FrameGraph::texture_desc(int resource) const {
+    return resources_[resource].desc;
+}
+
+size_t FrameGraph::pooled_bytes() const {
+    size_t bytes = 0;
+    for (const Physical& physical : physicals_) {
+        bytes += physical.size;
+    }
+    return bytes;
+}
+
+size_t FrameGraph::texture_bytes(const FrameGraphTextureDesc& desc) {
+    const TextureFormat* format = find_texture_format(desc.format);
+    return size_t(desc.width) * desc.height * (format ? format->bytes_per_pixel : 4);
+}
+
+GLbitfield FrameGraph::barrier_bits(Access access) {
+    switch (access) {
+        case kColorAttachment:
+        case kDepthAttachment: return GL_FRAMEBUFFER_BARRIER_BIT;
+        case kSampled: return GL_TEXTURE_FETCH_BARRIER_BIT;
+        case kImage: return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+        case kStorageBuffer: return GL_SHADER_STORAGE_BARRIER_BIT;
+        case kUniformBuffer: return GL_UNIFORM_BARRIER_BIT;
+        case kIndirectBuffer: return GL_COMMAND_BARRIER_BIT;
+        case kVertexBuffer: return GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT;
+        case kTransfer: return GL_TEXTURE_UPDATE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT;
+    }
+    return 0;
+}
+
+void FrameGraph::cull() {
+    // every pass is referenced by what it writes, every resource by the passes reading it. resources nobody
+    // reads release their writers, culled writers release what they read, until nothing changes
+    for (Resource& resource : resources_) {
+        resource.references = 0;
+    }
+    for (Pass& pass : passes_) {
+        pass.culled = false;
+        pass.references = 0;
+        for (const AccessRecord& access : pass.accesses) {
+            if (access.write) {
+                ++pass.references;
+            } else {
+                ++resources_[access.resource].references;
+            }
+        }
+    }
+    std::vector<int> unreferenced;
+    auto release_reads = [&](Pass& pass) {
+        pass.culled = true;
+        for (const AccessRecord& access : pass.accesses) {
+            Resource& resource = resources_[access.resource];
+            if (!access.write && --resource.references == 0 && !resource.imported) {
+                unreferenced.push_back(access.resource);
+            }
+        }
+    };
+    for (size_t i = 0; i < resources_.size(); ++i) {
+        if (resources_[i].references == 0 && !resources_[i].imported) {
+            unreferenced.push_back(static_cast<int>(i));
+        }
+    }
+    // passes writing nothing at all only run as side effects
+    for (Pass& pass : passes_) {
+        if (pass.references == 0 && !pass.side_effect) {
+            release_reads(pass);
+        }
+    }
+    while (!unreferenced.empty()) {
+        int resource = unreferenced.back();
+        unreferenced.pop_back();
+        for (Pass& pass : passes_) {
+            if (pass.culled) {
+                continue;
+            }
+            for (const AccessRecord& access : pass.accesses) {
+                if (access.write && access.resource == resource && --pass.references == 0 && !pass.side_effect) {
+                    release_reads(pass);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+int FrameGraph::acquire(const Resource& resource) {
+    // the smallest free one that fits, textures have to match exactly
+    int best = -1;
+    for (size_t i = 0; i < physicals_.size(); ++i) {
+        const Physical& physical = physicals_[i];
+        if (physical.in_use || physical.type != resource.type) {
+            continue;
+        }
+        bool fits = resource.type == kTexture ? same_desc(physical.desc, resource.desc) : physical.size >= resource.size;
+        if (fits && (best < 0 || physical.size < physicals_[best].size)) {
+            best = static_cast<int>(i);
+        }
+    }
+    if (best < 0) {
+        Physical physical;
+        physical.type = resource.type;
+        physical.desc = resource.desc;
+        physical.size = resource.size;
+        if (resource.type == kTexture) {
+            const TextureFormat* format = find_texture_format(resource.desc.format);
+            glGenTextures(1, &physical.object);
+            glBindTexture(GL_TEXTURE_2D, physical.object);
+            glTexImage2D(GL_TEXTURE_2D, 0, format->internal_format, resource.desc.width, resource.desc.height, 0,
+                         format->format, format->type, nullptr);
+            // no mipmaps, the default filter would leave the texture incomplete for sampling
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        } else {
+            glGenBuffers(1, &physical.object);
+            gl_state_.bind_buffer(GL_COPY_WRITE_BUFFER, physical.object);
+            glBufferData(GL_COPY_WRITE_BUFFER, resource.size, nullptr, GL_DYNAMIC_COPY);
+        }
+        physicals_.push_back(physical);
+        best = static_cast<int>(physicals_.size() - 1);
+    }
+    physicals_[best].in_use = true;
+    physicals_[best].last_used_frame = frame_;
+    return best;
+}
+
+bool FrameGraph::assign_framebuffer(Pass& pass) {
+    pass.framebuffer = 0;
+    pass.viewport_width = 0;
+    pass.viewport_height = 0;
+    unsigned int color[kMaxColorAttachments] = {};
+    int color_count = 0;
+    const Resource* depth = nullptr;
+    const Resource* imported_framebuffer = nullptr;
+    for (const AccessRecord& access : pass.accesses) {
+        const Resource& resource = resources_[access.resource];
+        if (access.access != kColorAttachment && access.access != kDepthAttachment) {
+            continue;
+        }
+        // the same attachment is often declared as read and written (blending, depth testing)
+        int width = resource.desc.width;
+        int height = resource.desc.height;
+        if (pass.viewport_width && (width != pass.viewport_width || height != pass.viewport_height)) {
+            std::cout << "ERROR::FRAME_GRAPH::ATTACHMENT_SIZE: " << pass.name << " " << resource.name << std::endl;
+            return false;
+        }
+        pass.viewport_width = width;
+        pass.viewport_height = height;
+        if (resource.type == kFramebuffer) {
+            imported_framebuffer = &resource;
+        } else if (access.access == kDepthAttachment) {
+            depth = &resource;
+        } else if (std::find(color, color + color_count, resource.object) == color + color_count) {
+            if (color_count == kMaxColorAttachments) {
+                std::cout << "ERROR::FRAME_GRAPH::TOO_MANY_ATTACHMENTS: " << pass.name << std::endl;
+                return false;
+            }
+            color[color_count++] = resource.object;
+        }
+    }
+    if (imported_framebuffer) {
+        // it comes with its own attachments, nothing can be added to it
+        if (color_count > 0 || depth) {
+            std::cout << "ERROR::FRAME_GRAPH::MIXED_ATTACHMENTS: " << pass.name << std::endl;
+            return false;
+        }
+        pass.framebuffer = imported_framebuffer->object;
+        return true;
+    }
+    if (color_count == 0 && !depth) {
+        return true;
+    }
+
+    const unsigned int depth_object = depth ? depth->object : 0;
+    for (CachedFramebuffer& cached : framebuffers_) {
+        if (std::equal(color, color + kMaxColorAttachments, cached.color) && cached.depth == depth_object) {
+            cached.last_used_frame = frame_;
+            pass.framebuffer = cached.framebuffer;
+            return true;
+        }
+    }
+    CachedFramebuffer cached;
+    std::copy(color, color + kMaxColorAttachments, cached.color);
+    cached.depth = depth_object;
+    const TextureFormat* depth_format = depth ? find_texture_format(depth->desc.format) : nullptr;
+    cached.depth_stencil = depth_format && depth_format->format == GL_DEPTH_STENCIL;
+    cached.last_used_frame = frame_;
+    glGenFramebuffers(1, &cached.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, cached.framebuffer);
+    GLenum draw_buffers[kMaxColorAttachments];
+    for (int i = 0; i < color_count; ++i) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, color[i], 0);
+        draw_buffers[i] = GL_COLOR_ATTACHMENT0 + i;
+    }
+    if (depth) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, cached.depth_stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT,
+                               GL_TEXTURE_2D, depth_object, 0);
+    }
+    if (color_count > 0) {
+        glDrawBuffers(color_count, draw_buffers);
+    } else {
+        glDrawBuffer(GL_NONE);
+    }
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "ERROR::FRAME_GRAPH::INCOMPLETE_FRAMEBUFFER: " << pass.name << " 0x" << std::hex << status << std::dec << std::endl;
+        glDeleteFramebuffers(1, &cached.framebuffer);
+        return false;
+    }
+    framebuffers_.push_back(cached);
+    pass.framebuffer = cached.framebuffer;
+    return true;
+}
+
+bool FrameGraph::compile() {
+    for (const Pass& pass : passes_) {
+        for (const AccessRecord& access : pass.accesses) {
+            if (access.resource < 0 || access.resource >= static_cast<int>(resources_.size())) {
+                std::cout << "ERROR::FRAME_GRAPH::INVALID_RESOURCE: " << pass.name << std::endl;
+                return false;
+            }
+        }
+    }
+    cull();
+
+    for (Resource& resource : resources_) {
+        resource.first_pass = -1;
+        resource.last_pass = -1;
+        resource.unsynchronized_write = false;
+        resource.barriered = 0;
+        if (!resource.imported) {
+            resource.object = 0;
+            resource.physical = -1;
+        }
+    }
+    for (size_t i = 0; i < passes_.size(); ++i) {
+        if (passes_[i].culled) {
+            continue;
+        }
+        for (const AccessRecord& access : passes_[i].accesses) {
+            Resource& resource = resources_[access.resource];
+            if (resource.first_pass < 0) {
+                resource.first_pass = static_cast<int>(i);
+            }
+            resource.last_pass = static_cast<int>(i);
+        }
+    }
+
+    // walk the passes in order: a transient gets its object right before its first pass and hands it back to
+    // the pool right after its last one, so later resources of the same description alias it
+    last_pass_count_ = 0;
+    last_culled_count_ = 0;
+    last_barrier_count_ = 0;
+    last_requested_bytes_ = 0;
+    last_allocated_bytes_ = 0;
+    std::vector<bool> counted(physicals_.size(), false);
+    for (size_t i = 0; i < passes_.size(); ++i) {
+        Pass& pass = passes_[i];
+        if (pass.culled) {
+            ++last_culled_count_;
+            continue;
+        }
+        ++last_pass_count_;
+        for (Resource& resource : resources_) {
+            if (resource.imported || resource.first_pass != static_cast<int>(i)) {
+                continue;
+            }
+            resource.physical = acquire(resource);
+            resource.object = physicals_[resource.physical].object;
+            last_requested_bytes_ += resource.size;
+            counted.resize(physicals_.size(), false);
+            if (!counted[resource.physical]) {
+                counted[resource.physical] = true;
+                last_allocated_bytes_ += physicals_[resource.physical].size;
+            }
+        }
+        if (!assign_framebuffer(pass)) {
+            compiled_ = false;
+            for (Physical& physical : physicals_) {
+                physical.in_use = false;
+            }
+            return false;
+        }
+
+        // reads first, a pass's own writes don't need a barrier against themselves
+        pass.barriers = 0;
+        for (const AccessRecord& access : pass.accesses) {
+            Resource& resource = resources_[access.resource];
+            if (resource.unsynchronized_write) {
+                GLbitfield bits = barrier_bits(access.access) & ~resource.barriered;
+                pass.barriers |= bits;
+                resource.barriered |= bits;
+            }
+        }
+        for (const AccessRecord& access : pass.accesses) {
+            if (access.write) {
+                Resource& resource = resources_[access.resource];
+                resource.unsynchronized_write = access.access == kImage || access.access == kStorageBuffer;
+                resource.barriered = 0;
+            }
+        }
+        if (!has_memory_barrier_) {
+            pass.barriers = 0;
+        }
+        if (pass.barriers) {
+            ++last_barrier_count_;
+        }
+
+        for (const Resource& resource : resources_) {
+            if (!resource.imported && resource.last_pass == static_cast<int>(i)) {
+                physicals_[resource.physical].in_use = false;
+            }
+        }
+    }
+    compiled_ = true;
+    return true;
+}
+
+void FrameGraph::execute() {
+    if (compiled_) {
+        for (const Pass& pass : passes_) {
+            if (pass.culled) {
+                continue;
+            }
+            if (pass.barriers) {
+                glMemoryBarrier(pass.barriers);
+            }
+            if (pass.viewport_width > 0) {
+                glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+                glViewport(0, 0, pass.viewport_width, pass.viewport_height);
+            }
+            pass.execute(*this);
+        }
+    }
+    passes_.clear();
+    resources_.clear();
+    compiled_ = false;
+    release_idle();
+    ++frame_;
+}
+
+void FrameGraph::release_idle() {
+    // a framebuffer was last used along with its textures, so it never outlives them
+    auto idle = [&](uint64_t last_used_frame) { return frame_ - last_used_frame >= kMaxIdleFrames; };
+    bool deleted_buffer = false;
+    for (size_t i = 0; i < physicals_.size(); ) {
+        const Physical& physical = physicals_[i];
+        if (!idle(physical.last_used_frame)) {
+            ++i;
+            continue;
+        }
+        if (physical.type == kTexture) {
+            glDeleteTextures(1, &physical.object);
+        } else {
+            glDeleteBuffers(1, &physical.object);
+            deleted_buffer = true;
+        }
+        physicals_.erase(physicals_.begin() + i);
+    }
+    for (size_t i = 0; i < framebuffers_.size(); ) {
+        if (idle(framebuffers_[i].last_used_frame)) {
+            glDeleteFramebuffers(1, &framebuffers_[i].framebuffer);
+            framebuffers_.erase(framebuffers_.begin() + i);
+        } else {
+            ++i;
+        }
+    }
+    if (deleted_buffer) {
+        gl_state_.invalidate();
+    }
+}
@@ -0,0 +1,189 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class GLStateCache;
+
+struct FrameGraphTextureDesc {
+    int width;
+    int height;
+    // sized internal format, GL_RGBA8, GL_RGBA16F, GL_DEPTH24_STENCIL8, ...
+    GLenum format;
+};
+
+// the passes of a frame and the textures and buffers they read and write, rebuilt every frame
+// passes only declare what they use, compile() works out the rest:
+// - passes whose results nobody reads are culled. what an imported resource gets written counts as read,
+//   like the back buffer, and so do passes marked as side effects
+// - transient resources only exist from their first to their last pass. resources with the same description
+//   whose lifetimes don't overlap share one gl object, gl has no way to place different textures in the same
+//   memory, so equal descriptions are what can alias. the objects stay pooled across frames and are deleted
+//   after kMaxIdleFrames frames without use
+// - a read or write after a write gl doesn't synchronize by itself (image stores, storage buffers) gets the
+//   glMemoryBarrier bits for how it accesses the resource
+// - passes writing attachments run with a framebuffer of them bound and a viewport covering it
+// passes run in the order they were added, so add a resource's writers before its readers
+class FrameGraph {
+public:
+    enum Access : uint8_t {
+        kColorAttachment,
+        kDepthAttachment,
+        // texture fetches in shaders
+        kSampled,
+        // image load/store
+        kImage,
+        kStorageBuffer,
+        kUniformBuffer,
+        kIndirectBuffer,
+        kVertexBuffer,
+        // blits, copies, readbacks
+        kTransfer
+    };
+
+    using ExecuteFunction = std::function<void(const FrameGraph& graph)>;
+
+    // what add_pass returns to declare the pass's accesses with
+    class PassBuilder {
+    public:
+        PassBuilder& read(int resource, Access access);
+        PassBuilder& write(int resource, Access access);
+        // runs even when nothing reads what it writes (readbacks, captures, ...)
+        PassBuilder& side_effect();
+
+    private:
+        friend class FrameGraph;
+        PassBuilder(FrameGraph& graph, int pass) : graph_(graph), pass_(pass) {}
+
+        FrameGraph& graph_;
+        int pass_;
+    };
+
+    static const int kMaxColorAttachments = 4;
+    static const uint64_t kMaxIdleFrames = 3;
+
+    explicit FrameGraph(GLStateCache& gl_state);
+    ~FrameGraph();
+    FrameGraph(const FrameGraph&) = delete;
+    FrameGraph& operator=(const FrameGraph&) = delete;
+
+    // transient, the graph owns them. name is for stats and errors and has to stay valid, a string literal is what's meant
+    int create_texture(const char* name, const FrameGraphTextureDesc& desc);
+    int create_buffer(const char* name, size_t size);
+    // made elsewhere and outliving the frame, never culled or aliased
+    int import_texture(const char* name, unsigned int texture, const FrameGraphTextureDesc& desc);
+    int import_buffer(const char* name, unsigned int buffer, size_t size);
+    // a whole framebuffer as one color attachment, 0 for the window's
+    int import_framebuffer(const char* name, unsigned int framebuffer, int width, int height);
+
+    PassBuilder add_pass(const char* name, ExecuteFunction execute);
+
+    // culls, assigns gl objects and works out the barriers. false if the graph is invalid (missing attachments,
+    // attachments of different sizes), nothing is run then
+    bool compile();
+    // runs the passes that survived, then forgets the frame's passes and resources
+    void execute();
+
+    // for the execute functions, the gl object of a resource the pass declared
+    unsigned int texture(int resource) const;
+    unsigned int buffer(int resource) const;
+    const FrameGraphTextureDesc& texture_desc(int resource) const;
+
+    // of the last compile
+    size_t pass_count() const { return last_pass_count_; }
+    size_t culled_count() const { return last_culled_count_; }
+    size_t barrier_count() const { return last_barrier_count_; }
+    // transient bytes the passes asked for vs what the gl objects backing them take
+    size_t requested_bytes() const { return last_requested_bytes_; }
+    size_t allocated_bytes() const { return last_allocated_bytes_; }
+    // held by the pool right now, including idle objects
+    size_t pooled_bytes() const;
+
+private:
+    enum ResourceType : uint8_t {
+        kTexture,
+        kBuffer,
+        kFramebuffer
+    };
+
+    struct AccessRecord {
+        int resource;
+        Access access;
+        bool write;
+    };
+
+    struct Pass {
+        const char* name;
+        ExecuteFunction execute;
+        std::vector<AccessRecord> accesses;
+        bool side_effect = false;
+        // filled by compile
+        bool culled = false;
+        int references = 0;
+        GLbitfield barriers = 0;
+        unsigned int framebuffer = 0;
+        int viewport_width = 0;
+        int viewport_height = 0;
+    };
+
+    struct Resource {
+        const char* name;
+        ResourceType type;
+        bool imported;
+        FrameGraphTextureDesc desc;
+        size_t size;
+        // gl object, for transients the pooled one it was given
+        unsigned int object;
+        int physical = -1;
+        int references = 0;
+        int first_pass = -1;
+        int last_pass = -1;
+        // for barriers while walking the passes: last written through image stores or as a storage buffer,
+        // and the barrier bits issued since
+        bool unsynchronized_write = false;
+        GLbitfield barriered = 0;
+    };
+
+    struct Physical {
+        ResourceType type;
+        FrameGraphTextureDesc desc;
+        size_t size;
+        unsigned int object;
+        bool in_use = false;
+        uint64_t last_used_frame = 0;
+    };
+
+    struct CachedFramebuffer {
+        unsigned int color[kMaxColorAttachments];
+        unsigned int depth;
+        bool depth_stencil;
+        unsigned int framebuffer;
+        uint64_t last_used_frame;
+    };
+
+    int add_resource(const char* name, ResourceType type, bool imported, const FrameGraphTextureDesc& desc, size_t size,
+                     unsigned int object);
+    void cull();
+    int acquire(const Resource& resource);
+    bool assign_framebuffer(Pass& pass);
+    void release_idle();
+
+    static size_t texture_bytes(const FrameGraphTextureDesc& desc);
+    static GLbitfield barrier_bits(Access access);
+
+    GLStateCache& gl_state_;
+    std::vector<Pass> passes_;
+    std::vector<Resource> resources_;
+    std::vector<Physical> physicals_;
+    std::vector<CachedFramebuffer> framebuffers_;
+    bool compiled_ = false;
+    bool has_memory_barrier_ = false;
+    uint64_t frame_ = 0;
+    size_t last_pass_count_ = 0;
+    size_t last_culled_count_ = 0;
+    size_t last_barrier_count_ = 0;
+    size_t last_requested_bytes_ = 0;
+    size_t last_allocated_bytes_ = 0;
+};
@@ -0,0 +1,235 @@
+#include "frame_profiler.h"
+#include "gl_extensions.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+    const char* const kFramePass = "frame";
+
+    void write_percentiles_json(std::ostream& out, const FrameProfiler::Percentiles& p) {
+        out << "{ \"p50\": " << p.p50 << ", \"p95\": " << p.p95 << ", \"p99\": " << p.p99 << " }";
+    }
+
+    // pass names come from our code, only quotes and backslashes could break the string
+    std::string json_escape(const std::string& text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+}
+
+void FrameProfiler::SampleRing::add(float value, size_t capacity) {
+    if (values.size() < capacity) {
+        values.push_back(value);
+    } else {
+        values[next] = value;
+        next = (next + 1) % capacity;
+    }
+}
+
+FrameProfiler::Percentiles FrameProfiler::SampleRing::percentiles() const {
+    Percentiles result;
+    if (values.empty()) {
+        return result;
+    }
+    std::vector<float> sorted(values);
+    std::sort(sorted.begin(), sorted.end());
+    // nearest rank
+    auto rank = [&](double percent) {
+        size_t index = static_cast<size_t>(percent / 100.0 * sorted.size() + 0.999999);
+        return sorted[std::min(sorted.size(), std::max<size_t>(index, 1)) - 1];
+    };
+    result.p50 = rank(50.0);
+    result.p95 = rank(95.0);
+    result.p99 = rank(99.0);
+    return result;
+}
+
+FrameProfiler::FrameProfiler(int frames_in_flight, size_t history)
+    : history_(std::max<size_t>(history, 1)), ring_(std::max(2, frames_in_flight)) {
+    // timer queries are core since 3.3
+    gpu_timers_ = GLAD_GL_VERSION_3_3 || has_gl_extension("GL_ARB_timer_query");
+}
+
+FrameProfiler::~FrameProfiler() {
+    for (Frame& frame : ring_) {
+        if (!frame.queries.empty()) {
+            glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+        }
+    }
+}
+
+int FrameProfiler::find_pass(const char* name) {
+    // the same literal every frame, the pointer compare almost always hits
+    for (size_t i = 0; i < passes_.size(); ++i) {
+        if (passes_[i].name == name || std::strcmp(passes_[i].name, name) == 0) {
+            return static_cast<int>(i);
+        }
+    }
+    passes_.emplace_back();
+    passes_.back().name = name;
+    return static_cast<int>(passes_.size() - 1);
+}
+
+int FrameProfiler::next_query(Frame& frame) {
+    if (frame.used_queries == static_cast<int>(frame.queries.size())) {
+        // grows until it fits the busiest frame, then stays
+        size_t count = std::max<size_t>(16, frame.queries.size());
+        size_t first = frame.queries.size();
+        frame.queries.resize(first + count);
+        glGenQueries(static_cast<GLsizei>(count), &frame.queries[first]);
+    }
+    return frame.used_queries++;
+}
+
+void FrameProfiler::collect(Frame& frame) {
+    if (frame.pending && gpu_timers_ && frame.used_queries > 0) {
+        // timestamps complete in order, once the last one is there all of them are
+        GLuint available = 0;
+        glGetQueryObjectuiv(frame.queries[frame.used_queries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            ++skipped_;
+        } else {
+            std::vector<double> sums(passes_.size(), -1.0);
+            for (const Record& record : frame.records) {
+                GLuint64 begin = 0;
+                GLuint64 end = 0;
+                glGetQueryObjectui64v(frame.queries[record.begin_query], GL_QUERY_RESULT, &begin);
+                glGetQueryObjectui64v(frame.queries[record.end_query], GL_QUERY_RESULT, &end);
+                sums[record.pass] = std::max(sums[record.pass], 0.0) + (end - begin) / 1e6;
+            }
+            for (size_t pass = 0; pass < sums.size(); ++pass) {
+                if (sums[pass] >= 0.0) {
+                    passes_[pass].gpu.add(static_cast<float>(sums[pass]), history_);
+                }
+            }
+        }
+    }
+    frame.records.clear();
+    frame.used_queries = 0;
+    frame.pending = false;
+}
+
+void FrameProfiler::begin_frame() {
+    // the oldest frame in the ring, frames_in_flight frames ago
+    collect(ring_[current_]);
+    open_.clear();
+    begin(kFramePass);
+}
+
+void FrameProfiler::end_frame() {
+    // anything left open ends with the frame
+    while (!open_.empty()) {
+        end();
+    }
+    for (Pass& pass : passes_) {
+        if (pass.frame_cpu_ms >= 0.0) {
+            pass.cpu.add(static_cast<float>(pass.frame_cpu_ms), history_);
+            ++pass.frames;
+            pass.frame_cpu_ms = -1.0;
+        }
+    }
+    ring_[current_].pending = true;
+    current_ = (current_ + 1) % static_cast<int>(ring_.size());
+    ++frames_;
+}
+
+void FrameProfiler::begin(const char* name) {
+    Frame& frame = ring_[current_];
+    Record record;
+    record.pass = find_pass(name);
+    record.begin_query = -1;
+    record.end_query = -1;
+    if (gpu_timers_) {
+        record.begin_query = next_query(frame);
+        glQueryCounter(frame.queries[record.begin_query], GL_TIMESTAMP);
+    }
+    record.cpu_begin = Clock::now();
+    open_.push_back(static_cast<int>(frame.records.size()));
+    frame.records.push_back(record);
+}
+
+void FrameProfiler::end() {
+    if (open_.empty()) {
+        return;
+    }
+    Frame& frame = ring_[current_];
+    Record& record = frame.records[open_.back()];
+    open_.pop_back();
+    double cpu_ms = std::chrono::duration<double, std::milli>(Clock::now() - record.cpu_begin).count();
+    Pass& pass = passes_[record.pass];
+    pass.frame_cpu_ms = std::max(pass.frame_cpu_ms, 0.0) + cpu_ms;
+    if (gpu_timers_) {
+        record.end_query = next_query(frame);
+        glQueryCounter(frame.queries[record.end_query], GL_TIMESTAMP);
+    }
+}
+
+std::vector<FrameProfiler::PassTimings> FrameProfiler::timings() const {
+    std::vector<PassTimings> result;
+    result.reserve(passes_.size());
+    for (const Pass& pass : passes_) {
+        PassTimings timings;
+        timings.name = pass.name;
+        timings.frames = pass.frames;
+        timings.cpu_samples = pass.cpu.values.size();
+        timings.gpu_samples = pass.gpu.values.size();
+        timings.cpu = pass.cpu.percentiles();
+        timings.gpu = pass.gpu.percentiles();
+        result.push_back(timings);
+    }
+    return result;
+}
+
+void FrameProfiler::print_stats() const {
+    std::cout << "timings: " << frames_ << " frames, p50/p95/p99 in ms over the last " << history_ << " (cpu | gpu"
+              << (gpu_timers_ ? "" : " unavailable") << ", " << skipped_ << " gpu frames skipped)" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    for (const PassTimings& pass : timings()) {
+        std::cout << "  " << std::left << std::setw(16) << pass.name << std::right << pass.cpu.p50 << " " << pass.cpu.p95
+                  << " " << pass.cpu.p99 << " | " << pass.gpu.p50 << " " << pass.gpu.p95 << " " << pass.gpu.p99 << std::endl;
+    }
+    std::cout << std::defaultfloat;
+}
+
+bool FrameProfiler::write(const std::string& path) const {
+    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    return json ? write_json(path) : write_csv(path);
+}
+
+bool FrameProfiler::write_csv(const std::string& path) const {
+    std::ofstream file(path, std::ios::trunc);
+    file << "pass,frames,cpu_samples,cpu_p50_ms,cpu_p95_ms,cpu_p99_ms,gpu_samples,gpu_p50_ms,gpu_p95_ms,gpu_p99_ms\n";
+    for (const PassTimings& pass : timings()) {
+        file << pass.name << "," << pass.frames << "," << pass.cpu_samples << "," << pass.cpu.p50 << "," << pass.cpu.p95
+             << "," << pass.cpu.p99 << "," << pass.gpu_samples << "," << pass.gpu.p50 << "," << pass.gpu.p95 << ","
+             << pass.gpu.p99 << "\n";
+    }
+    return static_cast<bool>(file);
+}
+
+bool FrameProfiler::write_json(const std::string& path) const {
+    std::ofstream file(path, std::ios::trunc);
+    file << "{\n  \"frames\": " << frames_ << ",\n  \"history\": " << history_ << ",\n  \"gpu_timers\": "
+         << (gpu_timers_ ? "true" : "false") << ",\n  \"gpu_frames_skipped\": " << skipped_ << ",\n  \"passes\": [";
+    std::vector<PassTimings> passes = timings();
+    for (size_t i = 0; i < passes.size(); ++i) {
+        const PassTimings& pass = passes[i];
+        file << (i ? ",\n" : "\n") << "    { \"name\": \"" << json_escape(pass.name) << "\", \"frames\": " << pass.frames
+             << ", \"cpu_samples\": " << pass.cpu_samples << ", \"gpu_samples\": " << pass.gpu_samples << ", \"cpu_ms\": ";
+        write_percentiles_json(file, pass.cpu);
+        file << ", \"gpu_ms\": ";
+        write_percentiles_json(file, pass.gpu);
+        file << " }";
+    }
+    file << "\n  ]\n}\n";
+    return static_cast<bool>(file);
+}
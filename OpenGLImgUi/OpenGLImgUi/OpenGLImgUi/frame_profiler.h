@@ -0,0 +1,119 @@
+#pragma once
+#include <glad/glad.h>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// cpu and gpu time per pass of the frame, as rolling p50/p95/p99 over the last frames
+// cpu time comes from the steady clock, gpu time from a pair of GL_TIMESTAMP queries around the pass (unlike
+// GL_TIME_ELAPSED they nest). the queries of a frame are only read frames_in_flight frames later when they
+// are long done, so reading never waits on the gpu. a frame whose results still aren't there by then is skipped
+// a pass that runs several times in a frame counts with the sum
+class FrameProfiler {
+public:
+    struct Percentiles {
+        float p50 = 0.0f;
+        float p95 = 0.0f;
+        float p99 = 0.0f;
+    };
+
+    // in milliseconds, over the frames still in the history
+    struct PassTimings {
+        std::string name;
+        // frames the pass ran in, in total and in the history
+        uint64_t frames = 0;
+        size_t cpu_samples = 0;
+        size_t gpu_samples = 0;
+        Percentiles cpu;
+        Percentiles gpu;
+    };
+
+    explicit FrameProfiler(int frames_in_flight = 4, size_t history = 300);
+    ~FrameProfiler();
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+    // the frame itself is a pass called "frame", the others go between these two
+    void begin_frame();
+    void end_frame();
+    // passes nest, end() closes the innermost one. name has to stay valid, a string literal is what's meant
+    void begin(const char* name);
+    void end();
+
+    bool gpu_timers() const { return gpu_timers_; }
+    uint64_t frames() const { return frames_; }
+    // frames whose gpu results weren't ready when their queries were needed again
+    uint64_t skipped() const { return skipped_; }
+    // passes in the order they first ran
+    std::vector<PassTimings> timings() const;
+
+    void print_stats() const;
+    // picks the format by extension, .json or .csv
+    bool write(const std::string& path) const;
+    bool write_csv(const std::string& path) const;
+    bool write_json(const std::string& path) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // the last history values, oldest overwritten first
+    struct SampleRing {
+        std::vector<float> values;
+        size_t next = 0;
+
+        void add(float value, size_t capacity);
+        Percentiles percentiles() const;
+    };
+
+    struct Pass {
+        const char* name;
+        uint64_t frames = 0;
+        SampleRing cpu;
+        SampleRing gpu;
+        // this frame's cpu sum, negative if it didn't run yet
+        double frame_cpu_ms = -1.0;
+    };
+
+    // one begin/end pair, query indices point into the frame's pool
+    struct Record {
+        int pass;
+        int begin_query;
+        int end_query;
+        Clock::time_point cpu_begin;
+    };
+
+    struct Frame {
+        std::vector<Record> records;
+        std::vector<unsigned int> queries;
+        int used_queries = 0;
+        bool pending = false;
+    };
+
+    int find_pass(const char* name);
+    int next_query(Frame& frame);
+    // reads the frame's gpu results if they are there, then makes it ready for reuse
+    void collect(Frame& frame);
+
+    bool gpu_timers_ = false;
+    size_t history_;
+    std::vector<Pass> passes_;
+    std::vector<Frame> ring_;
+    int current_ = 0;
+    // records of the current frame that are still open, innermost last
+    std::vector<int> open_;
+    uint64_t frames_ = 0;
+    uint64_t skipped_ = 0;
+};
+
+// begin() and end() for a scope
+class ProfileScope {
+public:
+    ProfileScope(FrameProfiler& profiler, const char* name) : profiler_(profiler) { profiler_.begin(name); }
+    ~ProfileScope() { profiler_.end(); }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    FrameProfiler& profiler_;
+};
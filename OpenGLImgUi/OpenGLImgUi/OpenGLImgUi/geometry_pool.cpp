@@ -0,0 +1,237 @@
+#include "geometry_pool.h"
+#include "gl_state.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+    unsigned int create_buffer(GLStateCache& gl_state, size_t bytes) {
+        unsigned int buffer = 0;
+        glGenBuffers(1, &buffer);
+        // the copy targets don't touch the vertex array state
+        gl_state.bind_buffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_STATIC_DRAW);
+        return buffer;
+    }
+
+    void accumulate(VertexCacheStats& total, const VertexCacheStats& stats) {
+        total.triangles += stats.triangles;
+        total.vertices += stats.vertices;
+        total.transforms += stats.transforms;
+    }
+}
+
+GeometryPool::GeometryPool(GLStateCache& gl_state, const std::vector<VertexAttribute>& attributes, uint32_t vertex_stride,
+                           uint32_t vertex_capacity, uint32_t index_capacity, GLenum index_type)
+    : gl_state_(gl_state), attributes_(attributes), vertex_stride_(vertex_stride), index_type_(index_type),
+      index_size_(index_type_size(index_type)), vertex_allocator_(vertex_capacity), index_allocator_(index_capacity) {
+    vertex_buffer_ = create_buffer(gl_state_, size_t(vertex_capacity) * vertex_stride_);
+    index_buffer_ = create_buffer(gl_state_, size_t(index_capacity) * index_size_);
+    glGenVertexArrays(1, &vertex_array_);
+    setup_vertex_array();
+}
+
+GeometryPool::~GeometryPool() {
+    glDeleteVertexArrays(1, &vertex_array_);
+    glDeleteBuffers(1, &vertex_buffer_);
+    glDeleteBuffers(1, &index_buffer_);
+    gl_state_.invalidate();
+}
+
+void GeometryPool::setup_vertex_array() {
+    gl_state_.bind_vertex_array(vertex_array_);
+    gl_state_.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer_);
+    for (const VertexAttribute& attribute : attributes_) {
+        glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized,
+                              vertex_stride_, reinterpret_cast<void*>(size_t(attribute.offset)));
+        glEnableVertexAttribArray(attribute.location);
+    }
+    gl_state_.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+}
+
+int GeometryPool::add_mesh(const void* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count,
+                           const std::vector<uint32_t>& submesh_starts) {
+    if (vertex_count == 0 || index_count == 0) {
+        std::cout << "ERROR::GEOMETRY::POOL: empty mesh" << std::endl;
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < index_count; ++i) {
+        if (indices[i] >= vertex_count) {
+            std::cout << "ERROR::GEOMETRY::POOL: index " << indices[i] << " out of range" << std::endl;
+            return -1;
+        }
+    }
+
+    // optimize a copy, the overdraw pass needs positions, which are whatever the attribute at location 0 holds
+    const unsigned char* vertex_bytes = static_cast<const unsigned char*>(vertices);
+    std::vector<unsigned char> optimized_vertices(vertex_bytes, vertex_bytes + size_t(vertex_count) * vertex_stride_);
+    std::vector<uint32_t> optimized_indices(indices, indices + index_count);
+    std::vector<float> positions;
+    for (const VertexAttribute& attribute : attributes_) {
+        if (attribute.location != 0) {
+            continue;
+        }
+        positions.resize(size_t(vertex_count) * 3);
+        for (uint32_t v = 0; v < vertex_count; ++v) {
+            float position[4];
+            read_vertex_attribute(attribute, vertex_bytes + size_t(v) * vertex_stride_, position);
+            std::copy(position, position + 3, positions.begin() + size_t(v) * 3);
+        }
+    }
+    MeshOptimizeStats stats = optimize_mesh(optimized_vertices, vertex_stride_, optimized_indices, submesh_starts,
+                                            positions.empty() ? nullptr : positions.data());
+    vertex_count = static_cast<uint32_t>(optimized_vertices.size() / vertex_stride_);
+    if (index_type_size(index_type_for(vertex_count)) > index_size_) {
+        std::cout << "ERROR::GEOMETRY::POOL: " << vertex_count << " vertices don't fit the pool's index type" << std::endl;
+        return -1;
+    }
+    accumulate(optimizer_stats_.before, stats.before);
+    accumulate(optimizer_stats_.after, stats.after);
+    std::vector<unsigned char> narrowed(size_t(index_count) * index_size_);
+    narrow_indices(narrowed.data(), optimized_indices.data(), index_count, index_type_);
+    return add_prepared_mesh(optimized_vertices.data(), vertex_count, narrowed.data(), index_type_, index_count);
+}
+
+int GeometryPool::add_prepared_mesh(const void* vertices, uint32_t vertex_count, const void* indices, GLenum index_type,
+                                    uint32_t index_count) {
+    if (vertex_count == 0 || index_count == 0) {
+        std::cout << "ERROR::GEOMETRY::POOL: empty mesh" << std::endl;
+        return -1;
+    }
+    // the slow path, indices stored at another width than ours need converting
+    std::vector<unsigned char> converted;
+    if (index_type != index_type_) {
+        if (index_type_size(index_type_for(vertex_count)) > index_size_) {
+            std::cout << "ERROR::GEOMETRY::POOL: " << vertex_count << " vertices don't fit the pool's index type" << std::endl;
+            return -1;
+        }
+        std::vector<uint32_t> wide(index_count);
+        for (uint32_t i = 0; i < index_count; ++i) {
+            switch (index_type) {
+                case GL_UNSIGNED_BYTE: wide[i] = static_cast<const uint8_t*>(indices)[i]; break;
+                case GL_UNSIGNED_SHORT: wide[i] = static_cast<const uint16_t*>(indices)[i]; break;
+                default: wide[i] = static_cast<const uint32_t*>(indices)[i]; break;
+            }
+        }
+        converted.resize(size_t(index_count) * index_size_);
+        narrow_indices(converted.data(), wide.data(), index_count, index_type_);
+        indices = converted.data();
+    }
+
+    uint32_t base_vertex = vertex_allocator_.allocate(vertex_count);
+    uint32_t first_index = index_allocator_.allocate(index_count);
+    if (base_vertex == RangeAllocator::kInvalid || first_index == RangeAllocator::kInvalid) {
+        if (base_vertex != RangeAllocator::kInvalid) {
+            vertex_allocator_.free(base_vertex);
+        }
+        if (first_index != RangeAllocator::kInvalid) {
+            index_allocator_.free(first_index);
+        }
+        // compacting is enough if the free space is only scattered, otherwise the buffers double
+        uint32_t vertices_needed = vertex_allocator_.used() + vertex_count;
+        uint32_t indices_needed = index_allocator_.used() + index_count;
+        if (vertices_needed < vertex_count || indices_needed < index_count) {
+            std::cout << "ERROR::GEOMETRY::POOL: mesh too large" << std::endl;
+            return -1;
+        }
+        uint32_t vertex_capacity = vertex_allocator_.capacity();
+        uint32_t index_capacity = index_allocator_.capacity();
+        if (vertices_needed > vertex_capacity) {
+            vertex_capacity = std::max(vertices_needed, vertex_capacity * 2);
+        }
+        if (indices_needed > index_capacity) {
+            index_capacity = std::max(indices_needed, index_capacity * 2);
+        }
+        rebuild(vertex_capacity, index_capacity);
+        base_vertex = vertex_allocator_.allocate(vertex_count);
+        first_index = index_allocator_.allocate(index_count);
+    }
+
+    gl_state_.bind_buffer(GL_COPY_WRITE_BUFFER, vertex_buffer_);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, size_t(base_vertex) * vertex_stride_, size_t(vertex_count) * vertex_stride_, vertices);
+    gl_state_.bind_buffer(GL_COPY_WRITE_BUFFER, index_buffer_);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, size_t(first_index) * index_size_, size_t(index_count) * index_size_, indices);
+
+    MeshRange range;
+    range.base_vertex = base_vertex;
+    range.vertex_count = vertex_count;
+    range.first_index = first_index;
+    range.index_count = index_count;
+    int mesh;
+    if (!free_mesh_ids_.empty()) {
+        mesh = free_mesh_ids_.back();
+        free_mesh_ids_.pop_back();
+        meshes_[mesh] = range;
+        mesh_alive_[mesh] = true;
+    } else {
+        mesh = static_cast<int>(meshes_.size());
+        meshes_.push_back(range);
+        mesh_alive_.push_back(true);
+    }
+    return mesh;
+}
+
+void GeometryPool::remove_mesh(int mesh) {
+    if (mesh < 0 || static_cast<size_t>(mesh) >= meshes_.size() || !mesh_alive_[mesh]) {
+        return;
+    }
+    vertex_allocator_.free(meshes_[mesh].base_vertex);
+    index_allocator_.free(meshes_[mesh].first_index);
+    meshes_[mesh] = MeshRange();
+    mesh_alive_[mesh] = false;
+    free_mesh_ids_.push_back(mesh);
+}
+
+void GeometryPool::bind() {
+    gl_state_.bind_vertex_array(vertex_array_);
+}
+
+void GeometryPool::draw(int mesh) {
+    draw(mesh, 0, meshes_[mesh].index_count);
+}
+
+void GeometryPool::draw(int mesh, uint32_t first, uint32_t count) {
+    const MeshRange& range = meshes_[mesh];
+    size_t index_offset = size_t(range.first_index + first) * index_size_;
+    glDrawElementsBaseVertex(GL_TRIANGLES, count, index_type_, reinterpret_cast<void*>(index_offset),
+                             static_cast<GLint>(range.base_vertex));
+}
+
+void GeometryPool::defragment() {
+    rebuild(vertex_allocator_.capacity(), index_allocator_.capacity());
+}
+
+void GeometryPool::rebuild(uint32_t vertex_capacity, uint32_t index_capacity) {
+    unsigned int vertex_buffer = create_buffer(gl_state_, size_t(vertex_capacity) * vertex_stride_);
+    unsigned int index_buffer = create_buffer(gl_state_, size_t(index_capacity) * index_size_);
+    vertex_allocator_.reset(vertex_capacity);
+    index_allocator_.reset(index_capacity);
+
+    // the copies stay on the gpu, a fresh allocator hands the ranges out back to back
+    for (size_t i = 0; i < meshes_.size(); ++i) {
+        if (!mesh_alive_[i]) {
+            continue;
+        }
+        MeshRange& range = meshes_[i];
+        uint32_t base_vertex = vertex_allocator_.allocate(range.vertex_count);
+        uint32_t first_index = index_allocator_.allocate(range.index_count);
+        gl_state_.bind_buffer(GL_COPY_READ_BUFFER, vertex_buffer_);
+        gl_state_.bind_buffer(GL_COPY_WRITE_BUFFER, vertex_buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, size_t(range.base_vertex) * vertex_stride_,
+                            size_t(base_vertex) * vertex_stride_, size_t(range.vertex_count) * vertex_stride_);
+        gl_state_.bind_buffer(GL_COPY_READ_BUFFER, index_buffer_);
+        gl_state_.bind_buffer(GL_COPY_WRITE_BUFFER, index_buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, size_t(range.first_index) * index_size_,
+                            size_t(first_index) * index_size_, size_t(range.index_count) * index_size_);
+        range.base_vertex = base_vertex;
+        range.first_index = first_index;
+    }
+
+    glDeleteBuffers(1, &vertex_buffer_);
+    glDeleteBuffers(1, &index_buffer_);
+    // the deleted names were bound, and may come back for someone else
+    gl_state_.invalidate();
+    vertex_buffer_ = vertex_buffer;
+    index_buffer_ = index_buffer;
+    setup_vertex_array();
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <vector>
+#include "mesh_optimizer.h"
+#include "range_allocator.h"
+#include "vertex_layout.h"
+
+class GLStateCache;
+
+// where a mesh lives inside the pool's buffers, in vertices and indices (not bytes)
+struct MeshRange {
+    uint32_t base_vertex = 0;
+    uint32_t vertex_count = 0;
+    uint32_t first_index = 0;
+    uint32_t index_count = 0;
+};
+
+// every mesh of one vertex format shares a single vertex buffer, index buffer and vertex array
+// meshes are sub-allocated from the two buffers and drawn with glDrawElementsBaseVertex, so there is one
+// upload per mesh, no buffer object per mesh and no vertex array switches between them
+// removing meshes leaves holes, defragment() packs everything to the front again and the buffers grow
+// when a mesh doesn't fit anymore. indices are relative to the mesh's own vertices, so a pool of small meshes
+// can store them as 8 or 16 bit. every mesh is run through the mesh optimizer on the way in
+class GeometryPool {
+public:
+    // index_type is GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT and limits the vertices per mesh,
+    // index_type_for() picks the narrowest one for the largest mesh. capacities are in vertices and indices
+    GeometryPool(GLStateCache& gl_state, const std::vector<VertexAttribute>& attributes, uint32_t vertex_stride,
+                 uint32_t vertex_capacity, uint32_t index_capacity, GLenum index_type = GL_UNSIGNED_INT);
+    GeometryPool(GLStateCache& gl_state, const VertexLayout& layout, uint32_t vertex_capacity, uint32_t index_capacity,
+                 GLenum index_type = GL_UNSIGNED_INT)
+        : GeometryPool(gl_state, layout.attributes(), layout.stride(), vertex_capacity, index_capacity, index_type) {}
+    ~GeometryPool();
+    GeometryPool(const GeometryPool&) = delete;
+    GeometryPool& operator=(const GeometryPool&) = delete;
+
+    // returns the mesh id, -1 if the data doesn't fit even after growing or has too many vertices for the index type
+    // triangles get reordered for the vertex cache and overdraw, only within each submesh, submesh_starts are
+    // the first index of every submesh after the first. vertices are reordered for fetching and unused ones dropped
+    int add_mesh(const void* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count,
+                 const std::vector<uint32_t>& submesh_starts = {});
+    // a mesh that is already optimized and in the pool's vertex format (e.g. out of a MeshFile), it is uploaded
+    // straight from the given memory. indices of another type than the pool's are converted first
+    int add_prepared_mesh(const void* vertices, uint32_t vertex_count, const void* indices, GLenum index_type, uint32_t index_count);
+    void remove_mesh(int mesh);
+    const MeshRange& mesh(int mesh) const { return meshes_[mesh]; }
+
+    // binds the pool's vertex array, every draw needs it but it only changes when switching pools
+    void bind();
+    // whole mesh, or first/count indices of it (e.g. one submesh)
+    void draw(int mesh);
+    void draw(int mesh, uint32_t first, uint32_t count);
+
+    // move every mesh to the front of new buffers so the free space is one block again
+    void defragment();
+
+    unsigned int vertex_buffer() const { return vertex_buffer_; }
+    unsigned int index_buffer() const { return index_buffer_; }
+    unsigned int vertex_array() const { return vertex_array_; }
+    uint32_t vertex_stride() const { return vertex_stride_; }
+    GLenum index_type() const { return index_type_; }
+    size_t index_size() const { return index_size_; }
+    const RangeAllocator& vertex_allocator() const { return vertex_allocator_; }
+    const RangeAllocator& index_allocator() const { return index_allocator_; }
+    // vertex cache behaviour of every mesh added so far, as it came in and as it was uploaded
+    const MeshOptimizeStats& optimizer_stats() const { return optimizer_stats_; }
+
+private:
+    // copies the live meshes into buffers of the given capacity, packed in mesh order
+    void rebuild(uint32_t vertex_capacity, uint32_t index_capacity);
+    void setup_vertex_array();
+
+    GLStateCache& gl_state_;
+    std::vector<VertexAttribute> attributes_;
+    uint32_t vertex_stride_;
+    GLenum index_type_;
+    size_t index_size_;
+    unsigned int vertex_buffer_ = 0;
+    unsigned int index_buffer_ = 0;
+    unsigned int vertex_array_ = 0;
+    RangeAllocator vertex_allocator_;
+    RangeAllocator index_allocator_;
+    std::vector<MeshRange> meshes_;
+    std::vector<bool> mesh_alive_;
+    std::vector<int> free_mesh_ids_;
+    MeshOptimizeStats optimizer_stats_;
+};
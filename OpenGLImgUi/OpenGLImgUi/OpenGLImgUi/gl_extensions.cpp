@@ -0,0 +1,29 @@
+#include "gl_extensions.h"
+#include <string>
+#include <unordered_set>
+
+namespace {
+    GLADloadproc loader = nullptr;
+    std::unordered_set<std::string> extensions;
+}
+
+void init_gl_extensions(GLADloadproc load) {
+    loader = load;
+    extensions.clear();
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int i = 0; i < count; ++i) {
+        const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (name) {
+            extensions.insert(name);
+        }
+    }
+}
+
+bool has_gl_extension(const char* name) {
+    return extensions.count(name) != 0;
+}
+
+void* get_gl_proc(const char* name) {
+    return loader ? loader(name) : nullptr;
+}
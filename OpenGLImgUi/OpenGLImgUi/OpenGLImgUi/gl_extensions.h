@@ -0,0 +1,14 @@
+#pragma once
+#include <glad/glad.h>
+
+// glad is generated for core 4.6 without any extensions, anything we want on top of that
+// (parallel shader compile, bindless textures, ...) is queried and loaded through here
+
+// call once after gladLoadGLLoader with the same loader (e.g. glfwGetProcAddress)
+void init_gl_extensions(GLADloadproc load);
+
+// true if the current context advertises the extension, e.g. "GL_KHR_parallel_shader_compile"
+bool has_gl_extension(const char* name);
+
+// entry point of an extension function, nullptr if the driver doesn't know it
+void* get_gl_proc(const char* name);
@@ -0,0 +1,103 @@
+#include "gl_state.h"
+
+GLStateCache::GLStateCache() {
+    invalidate();
+}
+
+void GLStateCache::invalidate() {
+    program_ = kUnknown;
+    vertex_array_ = kUnknown;
+    for (unsigned int& buffer : buffers_) {
+        buffer = kUnknown;
+    }
+    polygon_mode_ = kUnknown;
+    element_buffers_.clear();
+}
+
+bool GLStateCache::changed(unsigned int& current, unsigned int wanted) {
+    if (current == wanted) {
+        ++skipped_;
+        return false;
+    }
+    current = wanted;
+    ++issued_;
+    return true;
+}
+
+int GLStateCache::buffer_slot(GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER: return 0;
+        case GL_UNIFORM_BUFFER: return 1;
+        case GL_SHADER_STORAGE_BUFFER: return 2;
+        case GL_DRAW_INDIRECT_BUFFER: return 3;
+        case GL_DISPATCH_INDIRECT_BUFFER: return 4;
+        case GL_PIXEL_PACK_BUFFER: return 5;
+        case GL_PIXEL_UNPACK_BUFFER: return 6;
+        case GL_COPY_READ_BUFFER: return 7;
+        case GL_COPY_WRITE_BUFFER: return 8;
+        case GL_PARAMETER_BUFFER: return 9;
+        default: return -1;
+    }
+}
+
+void GLStateCache::use_program(unsigned int program) {
+    if (changed(program_, program)) {
+        glUseProgram(program);
+    }
+}
+
+void GLStateCache::bind_vertex_array(unsigned int vertex_array) {
+    if (changed(vertex_array_, vertex_array)) {
+        glBindVertexArray(vertex_array);
+    }
+}
+
+void GLStateCache::bind_buffer(GLenum target, unsigned int buffer) {
+    if (target == GL_ELEMENT_ARRAY_BUFFER) {
+        // without knowing which vertex array is bound we can't know what it holds
+        if (vertex_array_ == kUnknown) {
+            ++issued_;
+            glBindBuffer(target, buffer);
+            return;
+        }
+        auto found = element_buffers_.find(vertex_array_);
+        unsigned int current = found != element_buffers_.end() ? found->second : kUnknown;
+        if (changed(current, buffer)) {
+            element_buffers_[vertex_array_] = buffer;
+            glBindBuffer(target, buffer);
+        }
+        return;
+    }
+
+    int slot = buffer_slot(target);
+    if (slot < 0) {
+        ++issued_;
+        glBindBuffer(target, buffer);
+    } else if (changed(buffers_[slot], buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void GLStateCache::bind_buffer_base(GLenum target, unsigned int index, unsigned int buffer) {
+    ++issued_;
+    glBindBufferBase(target, index, buffer);
+    int slot = buffer_slot(target);
+    if (slot >= 0) {
+        buffers_[slot] = buffer;
+    }
+}
+
+void GLStateCache::bind_buffer_range(GLenum target, unsigned int index, unsigned int buffer, GLintptr offset, GLsizeiptr size) {
+    ++issued_;
+    glBindBufferRange(target, index, buffer, offset, size);
+    int slot = buffer_slot(target);
+    if (slot >= 0) {
+        buffers_[slot] = buffer;
+    }
+}
+
+void GLStateCache::polygon_mode(GLenum mode) {
+    if (changed(polygon_mode_, mode)) {
+        glPolygonMode(GL_FRONT_AND_BACK, mode);
+    }
+}
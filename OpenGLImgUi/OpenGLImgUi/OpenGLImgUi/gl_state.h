@@ -0,0 +1,50 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <unordered_map>
+
+// shadows the GL binding state we touch every frame and only calls into the driver when something
+// actually changes. everything that binds programs, vertex arrays or buffers on the main context should
+// go through here, after raw GL binds (or deleting something that is bound) call invalidate
+class GLStateCache {
+public:
+    GLStateCache();
+
+    void use_program(unsigned int program);
+    void bind_vertex_array(unsigned int vertex_array);
+    // GL_ELEMENT_ARRAY_BUFFER is tracked per vertex array since it is part of the vertex array state
+    void bind_buffer(GLenum target, unsigned int buffer);
+    // indexed binding points (uniform, storage buffers) aren't shadowed, but glBindBufferBase binds the generic
+    // target as well, so that one is kept up to date
+    void bind_buffer_base(GLenum target, unsigned int index, unsigned int buffer);
+    // the same for glBindBufferRange, offset has to respect the target's offset alignment
+    void bind_buffer_range(GLenum target, unsigned int index, unsigned int buffer, GLintptr offset, GLsizeiptr size);
+    // core profile only knows GL_FRONT_AND_BACK
+    void polygon_mode(GLenum mode);
+
+    // forget everything, the next call of each kind goes to the driver
+    void invalidate();
+    // the bound program was deleted and its name may come back for a new one
+    void forget_program() { program_ = kUnknown; }
+
+    // calls that reached the driver vs ones we dropped because the state was already set
+    uint64_t issued() const { return issued_; }
+    uint64_t skipped() const { return skipped_; }
+
+private:
+    static const unsigned int kUnknown = 0xFFFFFFFFu;
+    static const int kBufferTargetCount = 10;
+
+    // slot for the non vertex array buffer targets, -1 for ones we don't track
+    static int buffer_slot(GLenum target);
+    bool changed(unsigned int& current, unsigned int wanted);
+
+    unsigned int program_;
+    unsigned int vertex_array_;
+    unsigned int buffers_[kBufferTargetCount];
+    unsigned int polygon_mode_;
+    // element buffer each vertex array had bound when we last saw it
+    std::unordered_map<unsigned int, unsigned int> element_buffers_;
+    uint64_t issued_ = 0;
+    uint64_t skipped_ = 0;
+};
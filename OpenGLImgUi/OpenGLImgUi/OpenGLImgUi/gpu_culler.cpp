@@ -0,0 +1,209 @@
+#include "gpu_culler.h"
+#include "geometry_pool.h"
+#include "gl_extensions.h"
+#include "gl_state.h"
+#include "instance_buffer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+static_assert(sizeof(InstanceData) == 10 * sizeof(uint32_t), "cull.comp copies instances as 10 words");
+
+namespace {
+    const uint32_t kCommandWords = sizeof(DrawElementsIndirectCommand) / sizeof(uint32_t);
+
+    // binds [offset, offset + size) from the alignment below it on, returns the word the range starts at
+    uint32_t bind_slice(GLStateCache& gl_state, unsigned int index, unsigned int buffer, size_t offset, size_t size,
+                        size_t alignment) {
+        const size_t aligned = offset / alignment * alignment;
+        gl_state.bind_buffer_range(GL_SHADER_STORAGE_BUFFER, index, buffer, static_cast<GLintptr>(aligned),
+                                   static_cast<GLsizeiptr>(offset - aligned + size));
+        return static_cast<uint32_t>((offset - aligned) / sizeof(uint32_t));
+    }
+}
+
+void frustum_planes(const float view_projection[16], float planes[6][4]) {
+    // rows of the matrix, clip space is inside where -w <= x, y, z <= w
+    auto row = [&](int r, int column) { return view_projection[column * 4 + r]; };
+    for (int i = 0; i < 6; ++i) {
+        const int axis = i / 2;
+        const float sign = i % 2 == 0 ? 1.0f : -1.0f;
+        for (int column = 0; column < 4; ++column) {
+            planes[i][column] = row(3, column) + sign * row(axis, column);
+        }
+        float length = std::sqrt(planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1] + planes[i][2] * planes[i][2]);
+        if (length > 0.0f) {
+            for (float& value : planes[i]) {
+                value /= length;
+            }
+        }
+    }
+}
+
+uint32_t count_visible(const InstanceData* instances, uint32_t count, const float planes[6][4], float radius) {
+    uint32_t visible = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        const float* center = instances[i].translation;
+        const float instance_radius = radius * std::abs(instances[i].scale);
+        bool inside = true;
+        for (int plane = 0; plane < 6 && inside; ++plane) {
+            inside = planes[plane][0] * center[0] + planes[plane][1] * center[1] + planes[plane][2] * center[2] +
+                     planes[plane][3] >= -instance_radius;
+        }
+        visible += inside ? 1 : 0;
+    }
+    return visible;
+}
+
+bool GpuCuller::supported() {
+    // ARB_compute_shader and friends on an older context would need every entry point loaded by hand, and the
+    // shader asks for 430 anyway
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+GpuCuller::GpuCuller(GLStateCache& gl_state, GeometryPool& pool, unsigned int cull_program, unsigned int args_program)
+    : gl_state_(gl_state), pool_(pool), cull_program_(cull_program), args_program_(args_program) {
+    if (GLAD_GL_VERSION_4_6) {
+        draw_indirect_count_ = glad_glMultiDrawElementsIndirectCount;
+    } else if (has_gl_extension("GL_ARB_indirect_parameters")) {
+        draw_indirect_count_ = reinterpret_cast<PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC>(
+            get_gl_proc("glMultiDrawElementsIndirectCountARB"));
+    }
+    GLint max_groups = 0;
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &max_groups);
+    max_batch_ = static_cast<uint32_t>(std::max(max_groups, 1)) * kGroupSize;
+    // a batch's slice is bound from the offset alignment below it, so it may start that much earlier. the spec
+    // only promises 16 MB, less than a million instances need
+    GLint64 max_block_size = 0;
+    glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &max_block_size);
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &offset_alignment_);
+    offset_alignment_ = std::max(offset_alignment_, GLint(sizeof(uint32_t)));
+    const GLint64 block_instances = (max_block_size - offset_alignment_) / GLint64(sizeof(InstanceData));
+    max_batch_ = static_cast<uint32_t>(std::max<GLint64>(1, std::min<GLint64>(max_batch_, block_instances)));
+
+    glGenBuffers(1, &command_buffer_);
+    gl_state_.bind_buffer(GL_DRAW_INDIRECT_BUFFER, command_buffer_);
+    command_capacity_ = kMaxDraws;
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, command_capacity_ * sizeof(DrawElementsIndirectCommand) + sizeof(uint32_t),
+                 nullptr, GL_DYNAMIC_DRAW);
+}
+
+GpuCuller::~GpuCuller() {
+    glDeleteBuffers(1, &command_buffer_);
+    gl_state_.invalidate();
+}
+
+bool GpuCuller::add_draw(int mesh, uint32_t first, uint32_t count) {
+    if (draws_.size() >= kMaxDraws) {
+        return false;
+    }
+    draws_.push_back({ mesh, first, count });
+    return true;
+}
+
+bool GpuCuller::cull(InstanceBuffer& instances, uint32_t first_instance, uint32_t count, const float planes[6][4],
+                     float radius) {
+    culled_ = false;
+    last_count_ = count;
+    uint32_t output_instance = 0;
+    if (draws_.empty() || count == 0 || !instances.allocate(count, output_instance)) {
+        return false;
+    }
+    // the shader reads what the cpu wrote
+    instances.commit();
+
+    // no instances yet, each batch counts its survivors into its first command and they go to the batch's part
+    // of the output slice. the mesh ranges are looked up every frame, the pool may move them
+    commands_.clear();
+    for (uint32_t done = 0; done < count; done += max_batch_) {
+        for (const Draw& draw : draws_) {
+            const MeshRange& range = pool_.mesh(draw.mesh);
+            commands_.push_back({ draw.count, 0, range.first_index + draw.first, static_cast<int32_t>(range.base_vertex),
+                                  output_instance + done });
+        }
+    }
+    gl_state_.bind_buffer(GL_DRAW_INDIRECT_BUFFER, command_buffer_);
+    if (commands_.size() > command_capacity_) {
+        command_capacity_ = commands_.size();
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, command_capacity_ * sizeof(DrawElementsIndirectCommand) + sizeof(uint32_t),
+                     nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands_.size() * sizeof(DrawElementsIndirectCommand), commands_.data());
+    gl_state_.bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 1, command_buffer_);
+
+    gl_state_.use_program(cull_program_);
+    if (cull_uniforms_.program() != cull_program_) {
+        cull_uniforms_.reflect(cull_program_);
+        input_word_uniform_ = cull_uniforms_.find("uInputWord");
+        output_word_uniform_ = cull_uniforms_.find("uOutputWord");
+        instance_count_uniform_ = cull_uniforms_.find("uInstanceCount");
+        count_word_uniform_ = cull_uniforms_.find("uCountWord");
+        planes_uniform_ = cull_uniforms_.find("uPlanes");
+        radius_uniform_ = cull_uniforms_.find("uRadius");
+    }
+    cull_uniforms_.set(planes_uniform_, planes, 6 * 4 * sizeof(float));
+    cull_uniforms_.set(radius_uniform_, radius);
+    const size_t alignment = static_cast<size_t>(offset_alignment_);
+    for (uint32_t done = 0, command = 0; done < count; done += max_batch_, command += static_cast<uint32_t>(draws_.size())) {
+        const uint32_t batch = std::min(count - done, max_batch_);
+        const size_t bytes = size_t(batch) * sizeof(InstanceData);
+        uint32_t input_word = bind_slice(gl_state_, 0, instances.buffer(), size_t(first_instance + done) * sizeof(InstanceData),
+                                         bytes, alignment);
+        uint32_t output_word = bind_slice(gl_state_, 2, instances.buffer(),
+                                          size_t(output_instance + done) * sizeof(InstanceData), bytes, alignment);
+        cull_uniforms_.set(input_word_uniform_, input_word);
+        cull_uniforms_.set(output_word_uniform_, output_word);
+        cull_uniforms_.set(instance_count_uniform_, batch);
+        cull_uniforms_.set(count_word_uniform_, command * kCommandWords + 1);
+        cull_uniforms_.flush();
+        glDispatchCompute((batch + kGroupSize - 1) / kGroupSize, 1, 1);
+    }
+    // the counter is complete once every invocation is done
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    gl_state_.use_program(args_program_);
+    if (args_uniforms_.program() != args_program_) {
+        args_uniforms_.reflect(args_program_);
+        draw_count_uniform_ = args_uniforms_.find("uDrawCount");
+        command_count_uniform_ = args_uniforms_.find("uCommandCount");
+    }
+    args_uniforms_.set(draw_count_uniform_, static_cast<uint32_t>(draws_.size()));
+    args_uniforms_.set(command_count_uniform_, static_cast<uint32_t>(commands_.size()));
+    args_uniforms_.flush();
+    glDispatchCompute(1, 1, 1);
+    // the draws read the commands, the draw count and the instances the cull wrote
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    culled_ = true;
+    return true;
+}
+
+void GpuCuller::draw() {
+    if (!culled_) {
+        return;
+    }
+    pool_.bind();
+    gl_state_.bind_buffer(GL_DRAW_INDIRECT_BUFFER, command_buffer_);
+    const GLsizei draw_count = static_cast<GLsizei>(commands_.size());
+    if (draw_indirect_count_) {
+        gl_state_.bind_buffer(GL_PARAMETER_BUFFER, command_buffer_);
+        draw_indirect_count_(GL_TRIANGLES, pool_.index_type(), nullptr, draw_count * sizeof(DrawElementsIndirectCommand),
+                             draw_count, 0);
+    } else {
+        // commands nothing survived for have no instances and draw nothing
+        glMultiDrawElementsIndirect(GL_TRIANGLES, pool_.index_type(), nullptr, draw_count, 0);
+    }
+}
+
+uint32_t GpuCuller::read_visible_count() {
+    if (!culled_) {
+        return 0;
+    }
+    // the first command of each batch has the batch's survivors
+    gl_state_.bind_buffer(GL_DRAW_INDIRECT_BUFFER, command_buffer_);
+    glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands_.size() * sizeof(DrawElementsIndirectCommand), commands_.data());
+    uint32_t visible = 0;
+    for (size_t i = 0; i < commands_.size(); i += draws_.size()) {
+        visible += commands_[i].instance_count;
+    }
+    return visible;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <vector>
+#include "command_list.h"
+#include "uniform_table.h"
+
+class GeometryPool;
+class GLStateCache;
+class InstanceBuffer;
+struct InstanceData;
+
+// the six planes of a column major view projection matrix, normalized, inside is dot(xyz, p) + w >= 0
+void frustum_planes(const float view_projection[16], float planes[6][4]);
+// the test cull.comp runs, on the cpu. how many of the instances survive it, to check the gpu's count against
+uint32_t count_visible(const InstanceData* instances, uint32_t count, const float planes[6][4], float radius);
+
+// frustum culling on the gpu, the cpu never learns how many instances are visible
+// cull() runs cull.comp over the frame's instances: each invocation tests its instance's bounding sphere
+// (translation and scale of InstanceData times the mesh's radius) against the planes and copies the survivors
+// into a second slice of the instance buffer, counting them with an atomic in the first indirect command.
+// a one invocation pass (WRITE_ARGS) then fills the other commands' instance counts and the draw count, and
+// draw() submits them all with one glMultiDrawElementsIndirectCount (4.6 / ARB_indirect_parameters) or
+// glMultiDrawElementsIndirect without it. the commands' base instance is where the survivors went
+// only the slices a dispatch reads and writes are bound, so the instances are culled in batches that fit
+// GL_MAX_SHADER_STORAGE_BLOCK_SIZE (and the work group count). each batch has its own commands and survivors
+// needs 4.3 for compute shaders and storage buffers, check supported() and draw the instances directly otherwise
+class GpuCuller {
+public:
+    static const uint32_t kGroupSize = 64;
+    static const size_t kMaxDraws = 16;
+
+    static bool supported();
+
+    // the programs are cull.comp without and with WRITE_ARGS, they have to be linked before the first cull
+    GpuCuller(GLStateCache& gl_state, GeometryPool& pool, unsigned int cull_program, unsigned int args_program);
+    ~GpuCuller();
+    GpuCuller(const GpuCuller&) = delete;
+    GpuCuller& operator=(const GpuCuller&) = delete;
+
+    // what every visible instance draws, indices [first, first + count) of the pool mesh. false past kMaxDraws
+    // per batch
+    bool add_draw(int mesh, uint32_t first, uint32_t count);
+
+    // culls count instances written this frame from first_instance on, radius is the mesh's bounding sphere
+    // around its origin. false if the instance buffer has no room left for the survivors, nothing is drawn then
+    bool cull(InstanceBuffer& instances, uint32_t first_instance, uint32_t count, const float planes[6][4], float radius);
+    // the commands of the last cull, with the program that draws the instances in use
+    void draw();
+
+    bool draw_count() const { return draw_indirect_count_ != nullptr; }
+    // instances tested by the last cull
+    uint32_t culled_count() const { return last_count_; }
+    // survivors of the last cull, waits for the gpu to get there so only for stats
+    uint32_t read_visible_count();
+    // instances one dispatch culls at most
+    uint32_t max_batch() const { return max_batch_; }
+
+private:
+    struct Draw {
+        int mesh;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    GLStateCache& gl_state_;
+    GeometryPool& pool_;
+    unsigned int cull_program_;
+    unsigned int args_program_;
+    // the commands of every batch followed by the draw count, grows with the batches
+    unsigned int command_buffer_ = 0;
+    size_t command_capacity_ = 0;
+    std::vector<Draw> draws_;
+    std::vector<DrawElementsIndirectCommand> commands_;
+    // per dispatch, by the group count and by how big a bound storage block may be
+    uint32_t max_batch_ = 0;
+    GLint offset_alignment_ = 1;
+    bool culled_ = false;
+    uint32_t last_count_ = 0;
+    PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC draw_indirect_count_ = nullptr;
+
+    UniformTable cull_uniforms_;
+    int input_word_uniform_ = -1;
+    int output_word_uniform_ = -1;
+    int instance_count_uniform_ = -1;
+    int count_word_uniform_ = -1;
+    int planes_uniform_ = -1;
+    int radius_uniform_ = -1;
+    UniformTable args_uniforms_;
+    int draw_count_uniform_ = -1;
+    int command_count_uniform_ = -1;
+};
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// FNV-1a, 64 bit. good enough to tell shader sources and driver strings apart, not meant to be secure
+const uint64_t kHashSeed = 0xcbf29ce484222325ull;
+
+inline uint64_t hash_bytes(const void* data, size_t size, uint64_t hash = kHashSeed) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+inline uint64_t hash_string(std::string_view str, uint64_t hash = kHashSeed) {
+    // include the length so "ab" + "c" and "a" + "bc" don't end up with the same hash
+    uint64_t size = str.size();
+    hash = hash_bytes(&size, sizeof(size), hash);
+    return hash_bytes(str.data(), str.size(), hash);
+}
@@ -0,0 +1,334 @@
+#include "headless_context.h"
+#include <cstdint>
+#include <cstring>
+#ifdef __linux__
+#include <dlfcn.h>
+#endif
+
+namespace {
+    // whatever the current backend resolves gl functions with
+    void* (*backend_proc_address)(const char* name) = nullptr;
+
+    void* load_backend_proc(const char* name) {
+        return backend_proc_address ? backend_proc_address(name) : nullptr;
+    }
+
+    const char* backend_label(HeadlessContext::Backend backend) {
+        switch (backend) {
+            case HeadlessContext::kEglSurfaceless: return "egl surfaceless";
+            case HeadlessContext::kEglDevice: return "egl device";
+            case HeadlessContext::kEglDefault: return "egl default display";
+            case HeadlessContext::kOSMesa: return "osmesa";
+            case HeadlessContext::kHiddenWindow: return "hidden window";
+            default: return "none";
+        }
+    }
+
+#ifdef __linux__
+    // the parts of egl and osmesa we use, declared here so their headers aren't needed to build
+    typedef int32_t EGLint;
+    typedef unsigned int EGLBoolean;
+    typedef unsigned int EGLenum;
+    const EGLint kEglNone = 0x3038;
+    const EGLint kEglExtensions = 0x3055;
+    const EGLint kEglRenderableType = 0x3040;
+    const EGLint kEglOpenGLBit = 0x0008;
+    const EGLenum kEglOpenGLApi = 0x30A2;
+    const EGLint kEglContextMajorVersion = 0x3098;
+    const EGLint kEglContextMinorVersion = 0x30FB;
+    const EGLint kEglContextProfileMask = 0x30FD;
+    const EGLint kEglContextCoreProfileBit = 0x0001;
+    const EGLenum kEglPlatformSurfacelessMesa = 0x31DD;
+    const EGLenum kEglPlatformDeviceExt = 0x313F;
+
+    struct EglApi {
+        void* (*get_proc_address)(const char* name);
+        void* (*get_display)(void* native_display);
+        EGLBoolean (*initialize)(void* display, EGLint* major, EGLint* minor);
+        EGLBoolean (*terminate)(void* display);
+        const char* (*query_string)(void* display, EGLint name);
+        EGLBoolean (*bind_api)(EGLenum api);
+        EGLBoolean (*choose_config)(void* display, const EGLint* attributes, void** configs, EGLint size, EGLint* count);
+        void* (*create_context)(void* display, void* config, void* share, const EGLint* attributes);
+        EGLBoolean (*destroy_context)(void* display, void* context);
+        EGLBoolean (*make_current)(void* display, void* draw, void* read, void* context);
+        EGLint (*get_error)();
+        // extensions
+        void* (*get_platform_display)(EGLenum platform, void* native_display, const EGLint* attributes);
+        EGLBoolean (*query_devices)(EGLint max_devices, void** devices, EGLint* count);
+    };
+    EglApi egl = {};
+
+    const int kOSMesaRgba = 0x1908;
+    const int kOSMesaFormat = 0x22;
+    const int kOSMesaDepthBits = 0x30;
+    const int kOSMesaProfile = 0x33;
+    const int kOSMesaCoreProfile = 0x34;
+    const int kOSMesaContextMajorVersion = 0x36;
+    const int kOSMesaContextMinorVersion = 0x37;
+
+    struct OSMesaApi {
+        void* (*create_context_attribs)(const int* attributes, void* share);
+        unsigned char (*make_current)(void* context, void* buffer, GLenum type, GLsizei width, GLsizei height);
+        void (*destroy_context)(void* context);
+        void* (*get_proc_address)(const char* name);
+    };
+    OSMesaApi osmesa = {};
+
+    template <typename Function>
+    bool load_symbol(void* library, const char* name, Function& function) {
+        function = reinterpret_cast<Function>(dlsym(library, name));
+        return function != nullptr;
+    }
+
+    bool has_word(const char* list, const char* word) {
+        if (list == nullptr) {
+            return false;
+        }
+        size_t length = std::strlen(word);
+        for (const char* at = std::strstr(list, word); at; at = std::strstr(at + 1, word)) {
+            if ((at == list || at[-1] == ' ') && (at[length] == ' ' || at[length] == '\0')) {
+                return true;
+            }
+        }
+        return false;
+    }
+#endif
+}
+
+HeadlessContext::~HeadlessContext() {
+    destroy();
+}
+
+bool HeadlessContext::create(int major, int minor, std::string& error) {
+    destroy();
+    error.clear();
+#ifdef __linux__
+    if (create_egl(major, minor, error) || create_osmesa(major, minor, error)) {
+        return true;
+    }
+#endif
+    return create_hidden_window(major, minor, error);
+}
+
+void HeadlessContext::destroy() {
+    if (backend_ == kNone) {
+        return;
+    }
+    for (GLsync& fence : frame_fences_) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    frame_ = 0;
+    switch (backend_) {
+#ifdef __linux__
+        case kEglSurfaceless:
+        case kEglDevice:
+        case kEglDefault:
+            egl.make_current(display_, nullptr, nullptr, nullptr);
+            egl.destroy_context(display_, context_);
+            egl.terminate(display_);
+            break;
+        case kOSMesa:
+            osmesa.destroy_context(context_);
+            break;
+#endif
+        case kHiddenWindow:
+            glfwDestroyWindow(window_);
+            break;
+        default:
+            break;
+    }
+    // the library stays loaded, glad's pointers lead into it and objects that outlive the context still call them
+    backend_ = kNone;
+    window_ = nullptr;
+    display_ = nullptr;
+    context_ = nullptr;
+    backend_proc_address = nullptr;
+}
+
+const char* HeadlessContext::backend_name() const {
+    return backend_label(backend_);
+}
+
+GLADloadproc HeadlessContext::loader() const {
+    if (backend_ == kHiddenWindow) {
+        return (GLADloadproc)glfwGetProcAddress;
+    }
+    return load_backend_proc;
+}
+
+void HeadlessContext::present() {
+    // the fence of kFramesInFlight frames ago has to pass before this frame goes in
+    GLsync& fence = frame_fences_[frame_ % kFramesInFlight];
+    if (fence) {
+        GLenum status;
+        do {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        } while (status == GL_TIMEOUT_EXPIRED);
+        glDeleteSync(fence);
+    }
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    ++frame_;
+}
+
+bool HeadlessContext::create_egl(int major, int minor, std::string& error) {
+#ifdef __linux__
+    library_ = dlopen("libEGL.so.1", RTLD_NOW | RTLD_LOCAL);
+    if (library_ == nullptr) {
+        error += std::string("egl: ") + dlerror() + "\n";
+        return false;
+    }
+    egl = {};
+    if (!load_symbol(library_, "eglGetProcAddress", egl.get_proc_address) ||
+        !load_symbol(library_, "eglGetDisplay", egl.get_display) ||
+        !load_symbol(library_, "eglInitialize", egl.initialize) ||
+        !load_symbol(library_, "eglTerminate", egl.terminate) ||
+        !load_symbol(library_, "eglQueryString", egl.query_string) ||
+        !load_symbol(library_, "eglBindAPI", egl.bind_api) ||
+        !load_symbol(library_, "eglChooseConfig", egl.choose_config) ||
+        !load_symbol(library_, "eglCreateContext", egl.create_context) ||
+        !load_symbol(library_, "eglDestroyContext", egl.destroy_context) ||
+        !load_symbol(library_, "eglMakeCurrent", egl.make_current) ||
+        !load_symbol(library_, "eglGetError", egl.get_error)) {
+        error += "egl: libEGL is missing entry points\n";
+        dlclose(library_);
+        library_ = nullptr;
+        return false;
+    }
+    egl.get_platform_display = reinterpret_cast<decltype(egl.get_platform_display)>(egl.get_proc_address("eglGetPlatformDisplayEXT"));
+    egl.query_devices = reinterpret_cast<decltype(egl.query_devices)>(egl.get_proc_address("eglQueryDevicesEXT"));
+    const char* client_extensions = egl.query_string(nullptr, kEglExtensions);
+
+    // first display that gives us a context wins
+    const EGLint context_attributes[] = {
+        kEglContextMajorVersion, major,
+        kEglContextMinorVersion, minor,
+        kEglContextProfileMask, kEglContextCoreProfileBit,
+        kEglNone
+    };
+    for (Backend candidate : { kEglSurfaceless, kEglDevice, kEglDefault }) {
+        void* display = nullptr;
+        if (candidate == kEglSurfaceless && egl.get_platform_display && has_word(client_extensions, "EGL_MESA_platform_surfaceless")) {
+            display = egl.get_platform_display(kEglPlatformSurfacelessMesa, nullptr, nullptr);
+        } else if (candidate == kEglDevice && egl.get_platform_display && egl.query_devices &&
+                   has_word(client_extensions, "EGL_EXT_platform_device")) {
+            void* device = nullptr;
+            EGLint count = 0;
+            if (egl.query_devices(1, &device, &count) && count > 0) {
+                display = egl.get_platform_display(kEglPlatformDeviceExt, device, nullptr);
+            }
+        } else if (candidate == kEglDefault) {
+            display = egl.get_display(nullptr);
+        }
+        if (display == nullptr || !egl.initialize(display, nullptr, nullptr)) {
+            continue;
+        }
+        // no surface at all, the context is made current on its own
+        const char* display_extensions = egl.query_string(display, kEglExtensions);
+        void* config = nullptr;
+        EGLint config_count = 0;
+        const EGLint config_attributes[] = { kEglRenderableType, kEglOpenGLBit, kEglNone };
+        bool has_config = has_word(display_extensions, "EGL_KHR_no_config_context") ||
+                          (egl.choose_config(display, config_attributes, &config, 1, &config_count) && config_count > 0);
+        void* context = nullptr;
+        if (has_config && has_word(display_extensions, "EGL_KHR_surfaceless_context") && egl.bind_api(kEglOpenGLApi)) {
+            context = egl.create_context(display, config, nullptr, context_attributes);
+        }
+        if (context == nullptr || !egl.make_current(display, nullptr, nullptr, context)) {
+            error += std::string("egl: ") + backend_label(candidate) + " failed (error " + std::to_string(egl.get_error()) + ")\n";
+            if (context) {
+                egl.destroy_context(display, context);
+            }
+            egl.terminate(display);
+            continue;
+        }
+        backend_ = candidate;
+        display_ = display;
+        context_ = context;
+        backend_proc_address = egl.get_proc_address;
+        return true;
+    }
+    dlclose(library_);
+    library_ = nullptr;
+    return false;
+#else
+    (void)major;
+    (void)minor;
+    (void)error;
+    return false;
+#endif
+}
+
+bool HeadlessContext::create_osmesa(int major, int minor, std::string& error) {
+#ifdef __linux__
+    library_ = dlopen("libOSMesa.so.8", RTLD_NOW | RTLD_LOCAL);
+    if (library_ == nullptr) {
+        library_ = dlopen("libOSMesa.so", RTLD_NOW | RTLD_LOCAL);
+    }
+    if (library_ == nullptr) {
+        error += std::string("osmesa: ") + dlerror() + "\n";
+        return false;
+    }
+    osmesa = {};
+    if (!load_symbol(library_, "OSMesaCreateContextAttribs", osmesa.create_context_attribs) ||
+        !load_symbol(library_, "OSMesaMakeCurrent", osmesa.make_current) ||
+        !load_symbol(library_, "OSMesaDestroyContext", osmesa.destroy_context) ||
+        !load_symbol(library_, "OSMesaGetProcAddress", osmesa.get_proc_address)) {
+        error += "osmesa: libOSMesa is missing entry points\n";
+        dlclose(library_);
+        library_ = nullptr;
+        return false;
+    }
+    const int attributes[] = {
+        kOSMesaFormat, kOSMesaRgba,
+        kOSMesaDepthBits, 0,
+        kOSMesaProfile, kOSMesaCoreProfile,
+        kOSMesaContextMajorVersion, major,
+        kOSMesaContextMinorVersion, minor,
+        0
+    };
+    context_ = osmesa.create_context_attribs(attributes, nullptr);
+    if (context_ == nullptr || !osmesa.make_current(context_, osmesa_buffer_, GL_UNSIGNED_BYTE, 1, 1)) {
+        error += "osmesa: no core profile context\n";
+        if (context_) {
+            osmesa.destroy_context(context_);
+            context_ = nullptr;
+        }
+        dlclose(library_);
+        library_ = nullptr;
+        return false;
+    }
+    backend_ = kOSMesa;
+    backend_proc_address = osmesa.get_proc_address;
+    return true;
+#else
+    (void)major;
+    (void)minor;
+    (void)error;
+    return false;
+#endif
+}
+
+bool HeadlessContext::create_hidden_window(int major, int minor, std::string& error) {
+    if (!glfwInit()) {
+        error += "glfw: can't initialize, no display?\n";
+        return false;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    window_ = glfwCreateWindow(1, 1, "headless", nullptr, nullptr);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    if (window_ == nullptr) {
+        error += "glfw: can't create a hidden window\n";
+        return false;
+    }
+    glfwMakeContextCurrent(window_);
+    backend_ = kHiddenWindow;
+    return true;
+}
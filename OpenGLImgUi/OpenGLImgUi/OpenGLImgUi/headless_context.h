@@ -0,0 +1,60 @@
+#pragma once
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <string>
+
+// a gl context without a visible window, for render nodes and ci machines without a display
+// on linux it comes from egl (mesa's surfaceless platform, which also runs on llvmpipe, then the first egl
+// device, then the default display) or from osmesa. both libraries are loaded at runtime, so neither is a build
+// dependency and a machine that has neither still runs the windowed mode. elsewhere there is always a desktop
+// and a hidden glfw window does it
+// there is no default framebuffer in any case, render into an OffscreenTarget
+class HeadlessContext {
+public:
+    enum Backend {
+        kNone,
+        kEglSurfaceless,
+        kEglDevice,
+        kEglDefault,
+        kOSMesa,
+        kHiddenWindow
+    };
+
+    HeadlessContext() = default;
+    ~HeadlessContext();
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // a core profile context of at least major.minor, current on this thread when it returns true
+    // fills error with what every backend said otherwise
+    bool create(int major, int minor, std::string& error);
+    void destroy();
+
+    Backend backend() const { return backend_; }
+    const char* backend_name() const;
+    // for gladLoadGLLoader and init_gl_extensions
+    GLADloadproc loader() const;
+    // the hidden window with kHiddenWindow (the shader compiler shares with it), nullptr otherwise
+    GLFWwindow* window() const { return window_; }
+
+    // stands in for glfwSwapBuffers: flushes the frame and blocks while more than kFramesInFlight are queued,
+    // so the cpu runs as far ahead of the gpu as it would with a swap chain
+    void present();
+
+private:
+    static const int kFramesInFlight = 2;
+
+    bool create_egl(int major, int minor, std::string& error);
+    bool create_osmesa(int major, int minor, std::string& error);
+    bool create_hidden_window(int major, int minor, std::string& error);
+
+    Backend backend_ = kNone;
+    GLFWwindow* window_ = nullptr;
+    void* library_ = nullptr;
+    void* display_ = nullptr;
+    void* context_ = nullptr;
+    // osmesa wants a color buffer to make the context current, even though nothing renders into it
+    unsigned char osmesa_buffer_[4] = {};
+    GLsync frame_fences_[kFramesInFlight] = {};
+    int frame_ = 0;
+};
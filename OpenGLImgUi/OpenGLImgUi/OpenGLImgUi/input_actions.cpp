@@ -0,0 +1,86 @@
+#include "input_actions.h"
+
+namespace {
+    // bindings for every joystick use this device
+    const int kAnyDevice = 0xFF;
+}
+
+uint64_t InputActions::binding_key(InputEvent::Type type, int code, int device) {
+    return (static_cast<uint64_t>(type) << 40) | (static_cast<uint64_t>(device & 0xFF) << 32) | static_cast<uint32_t>(code);
+}
+
+void InputActions::bind(uint64_t key, int action) {
+    bindings_[key] = action;
+    if (action >= static_cast<int>(held_.size())) {
+        held_.resize(action + 1, 0);
+    }
+}
+
+void InputActions::bind_key(int key, int action) {
+    bind(binding_key(InputEvent::kKey, key, 0), action);
+}
+
+void InputActions::bind_mouse_button(int button, int action) {
+    bind(binding_key(InputEvent::kMouseButton, button, 0), action);
+}
+
+void InputActions::bind_joystick_button(int button, int action, int device) {
+    bind(binding_key(InputEvent::kJoystickButton, button, device < 0 ? kAnyDevice : device), action);
+}
+
+bool InputActions::held(int action) const {
+    return action >= 0 && action < static_cast<int>(held_.size()) && held_[action] > 0;
+}
+
+float InputActions::take_scroll() {
+    float scroll = scroll_;
+    scroll_ = 0.0f;
+    return scroll;
+}
+
+void InputActions::change(int action, bool pressed, int64_t time, const Handler& handler) {
+    int& count = held_[action];
+    if (pressed) {
+        if (count++ == 0) {
+            handler(action, true, time);
+        }
+    } else if (count > 0) {
+        // a release without its press (held before we started) is dropped
+        if (--count == 0) {
+            handler(action, false, time);
+        }
+    }
+}
+
+void InputActions::dispatch(InputEventQueue& queue, const Handler& handler) {
+    InputEvent event;
+    while (queue.pop(event)) {
+        switch (event.type) {
+            case InputEvent::kCursor:
+                cursor_x_ = event.x;
+                cursor_y_ = event.y;
+                continue;
+            case InputEvent::kScroll:
+                scroll_ += event.y;
+                continue;
+            case InputEvent::kJoystickConnected:
+                continue;
+            default:
+                break;
+        }
+        if (event.action == GLFW_REPEAT) {
+            continue;
+        }
+        bool pressed = event.action == GLFW_PRESS;
+        auto found = bindings_.find(binding_key(event.type, event.code, event.device));
+        if (found != bindings_.end()) {
+            change(found->second, pressed, event.time, handler);
+        }
+        if (event.type == InputEvent::kJoystickButton) {
+            found = bindings_.find(binding_key(event.type, event.code, kAnyDevice));
+            if (found != bindings_.end()) {
+                change(found->second, pressed, event.time, handler);
+            }
+        }
+    }
+}
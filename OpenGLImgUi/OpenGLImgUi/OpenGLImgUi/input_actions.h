@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include "input_events.h"
+
+// turns input events into the app's actions through a binding table
+// an action can have several bindings (a key and a joystick button), it goes down with the first of them and up
+// with the last, and the handler only hears about those transitions. key repeats are ignored, so whatever an
+// action does happens once per press. never calls glfw, so any thread can own it, as long as it is the
+// only one popping the queue
+class InputActions {
+public:
+    // time is the event's, on the steady clock in nanoseconds
+    using Handler = std::function<void(int action, bool pressed, int64_t time)>;
+
+    // device -1 matches every joystick
+    void bind_key(int key, int action);
+    void bind_mouse_button(int button, int action);
+    void bind_joystick_button(int button, int action, int device = -1);
+
+    // pops every queued event, calls handler for each action that went down or up
+    void dispatch(InputEventQueue& queue, const Handler& handler);
+
+    bool held(int action) const;
+    // from the last cursor event, in screen coordinates
+    float cursor_x() const { return cursor_x_; }
+    float cursor_y() const { return cursor_y_; }
+    // scrolling since the last call
+    float take_scroll();
+
+private:
+    static uint64_t binding_key(InputEvent::Type type, int code, int device);
+    void bind(uint64_t key, int action);
+    void change(int action, bool pressed, int64_t time, const Handler& handler);
+
+    std::unordered_map<uint64_t, int> bindings_;
+    // per action, how many of its bindings are down
+    std::vector<int> held_;
+    float cursor_x_ = 0.0f;
+    float cursor_y_ = 0.0f;
+    float scroll_ = 0.0f;
+};
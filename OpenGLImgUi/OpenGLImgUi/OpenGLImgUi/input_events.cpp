@@ -0,0 +1,133 @@
+#include "input_events.h"
+#include <chrono>
+
+namespace {
+    // the joystick callback has no window to find its GlfwInput through
+    GlfwInput* joystick_listener = nullptr;
+
+    int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+InputEventQueue::InputEventQueue(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+        size *= 2;
+    }
+    events_.resize(size);
+    mask_ = size - 1;
+}
+
+bool InputEventQueue::push(const InputEvent& event) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    // acquire, the consumer has to be done reading the slot before we overwrite it
+    if (head - tail_.load(std::memory_order_acquire) == events_.size()) {
+        overflows_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    events_[head & mask_] = event;
+    // release, the event is written before the consumer can see it
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+bool InputEventQueue::pop(InputEvent& event) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    event = events_[tail & mask_];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+GlfwInput::GlfwInput(GLFWwindow* window, InputEventQueue& queue) : window_(window), queue_(queue) {
+    glfwSetWindowUserPointer(window_, this);
+    glfwSetKeyCallback(window_, key_callback);
+    glfwSetMouseButtonCallback(window_, mouse_button_callback);
+    glfwSetCursorPosCallback(window_, cursor_callback);
+    glfwSetScrollCallback(window_, scroll_callback);
+    joystick_listener = this;
+    glfwSetJoystickCallback(joystick_callback);
+}
+
+GlfwInput::~GlfwInput() {
+    glfwSetKeyCallback(window_, nullptr);
+    glfwSetMouseButtonCallback(window_, nullptr);
+    glfwSetCursorPosCallback(window_, nullptr);
+    glfwSetScrollCallback(window_, nullptr);
+    glfwSetWindowUserPointer(window_, nullptr);
+    if (joystick_listener == this) {
+        glfwSetJoystickCallback(nullptr);
+        joystick_listener = nullptr;
+    }
+}
+
+void GlfwInput::push(InputEvent::Type type, int code, int action, int mods, int device, float x, float y) {
+    InputEvent event;
+    event.type = type;
+    event.action = static_cast<uint8_t>(action);
+    event.device = static_cast<uint8_t>(device);
+    event.mods = static_cast<uint8_t>(mods);
+    event.code = code;
+    event.x = x;
+    event.y = y;
+    event.time = now_ns();
+    queue_.push(event);
+}
+
+void GlfwInput::key_callback(GLFWwindow* window, int key, int, int action, int mods) {
+    if (GlfwInput* input = static_cast<GlfwInput*>(glfwGetWindowUserPointer(window))) {
+        input->push(InputEvent::kKey, key, action, mods);
+    }
+}
+
+void GlfwInput::mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
+    if (GlfwInput* input = static_cast<GlfwInput*>(glfwGetWindowUserPointer(window))) {
+        input->push(InputEvent::kMouseButton, button, action, mods);
+    }
+}
+
+void GlfwInput::cursor_callback(GLFWwindow* window, double x, double y) {
+    if (GlfwInput* input = static_cast<GlfwInput*>(glfwGetWindowUserPointer(window))) {
+        input->push(InputEvent::kCursor, 0, 0, 0, 0, static_cast<float>(x), static_cast<float>(y));
+    }
+}
+
+void GlfwInput::scroll_callback(GLFWwindow* window, double x, double y) {
+    if (GlfwInput* input = static_cast<GlfwInput*>(glfwGetWindowUserPointer(window))) {
+        input->push(InputEvent::kScroll, 0, 0, 0, 0, static_cast<float>(x), static_cast<float>(y));
+    }
+}
+
+void GlfwInput::joystick_callback(int joystick, int event) {
+    if (joystick_listener) {
+        joystick_listener->push(InputEvent::kJoystickConnected, 0, event, 0, joystick);
+    }
+}
+
+void GlfwInput::poll_joysticks() {
+    for (int joystick = GLFW_JOYSTICK_1; joystick <= GLFW_JOYSTICK_LAST; ++joystick) {
+        std::vector<unsigned char>& last = joystick_buttons_[joystick];
+        int count = 0;
+        const unsigned char* buttons = glfwJoystickPresent(joystick) ? glfwGetJoystickButtons(joystick, &count) : nullptr;
+        if (buttons == nullptr) {
+            // a disconnect releases whatever was held
+            for (size_t button = 0; button < last.size(); ++button) {
+                if (last[button] == GLFW_PRESS) {
+                    push(InputEvent::kJoystickButton, static_cast<int>(button), GLFW_RELEASE, 0, joystick);
+                }
+            }
+            last.clear();
+            continue;
+        }
+        last.resize(count, GLFW_RELEASE);
+        for (int button = 0; button < count; ++button) {
+            if (buttons[button] != last[button]) {
+                push(InputEvent::kJoystickButton, button, buttons[button], 0, joystick);
+                last[button] = buttons[button];
+            }
+        }
+    }
+}
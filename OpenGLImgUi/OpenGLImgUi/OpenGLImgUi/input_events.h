@@ -0,0 +1,85 @@
+#pragma once
+#include <GLFW/glfw3.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct InputEvent {
+    enum Type : uint8_t {
+        kKey,
+        kMouseButton,
+        kCursor,
+        kScroll,
+        kJoystickButton,
+        kJoystickConnected
+    };
+
+    Type type;
+    // GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT, for kJoystickConnected GLFW_CONNECTED or GLFW_DISCONNECTED
+    uint8_t action;
+    // the joystick, 0 for keyboard and mouse
+    uint8_t device;
+    uint8_t mods;
+    // key, mouse button or joystick button
+    int32_t code;
+    // cursor position in screen coordinates, or the scroll offsets
+    float x;
+    float y;
+    // steady clock, in nanoseconds
+    int64_t time;
+};
+
+// hands input events from the thread glfw delivers them on to whichever thread consumes them
+// one producer and one consumer, neither ever blocks or takes a lock: each side only moves its own index
+// and reads the other's. a full queue drops the new event and counts it
+class InputEventQueue {
+public:
+    // rounded up to a power of two
+    explicit InputEventQueue(size_t capacity = 1024);
+    InputEventQueue(const InputEventQueue&) = delete;
+    InputEventQueue& operator=(const InputEventQueue&) = delete;
+
+    // producer
+    bool push(const InputEvent& event);
+    // consumer, false once it's empty
+    bool pop(InputEvent& event);
+
+    uint64_t overflows() const { return overflows_; }
+
+private:
+    std::vector<InputEvent> events_;
+    size_t mask_;
+    // on their own cache lines, the two threads write one each
+    alignas(64) std::atomic<size_t> head_{ 0 };
+    alignas(64) std::atomic<size_t> tail_{ 0 };
+    std::atomic<uint64_t> overflows_{ 0 };
+};
+
+// feeds a window's key, mouse button, cursor and scroll callbacks and joystick (dis)connects into a queue
+// glfw 3.2 has no callbacks for joystick buttons, poll_joysticks() compares them with the last poll and only
+// queues the changes. uses the window's user pointer, one instance per window
+class GlfwInput {
+public:
+    GlfwInput(GLFWwindow* window, InputEventQueue& queue);
+    ~GlfwInput();
+    GlfwInput(const GlfwInput&) = delete;
+    GlfwInput& operator=(const GlfwInput&) = delete;
+
+    // call after glfwPollEvents, on the main thread like everything else glfw
+    void poll_joysticks();
+
+private:
+    static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+    static void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+    static void cursor_callback(GLFWwindow* window, double x, double y);
+    static void scroll_callback(GLFWwindow* window, double x, double y);
+    static void joystick_callback(int joystick, int event);
+
+    void push(InputEvent::Type type, int code, int action, int mods, int device = 0, float x = 0.0f, float y = 0.0f);
+
+    GLFWwindow* window_;
+    InputEventQueue& queue_;
+    // button states of the last poll per joystick, empty while it isn't connected
+    std::vector<unsigned char> joystick_buttons_[GLFW_JOYSTICK_LAST + 1];
+};
@@ -0,0 +1,60 @@
+#include "instance_buffer.h"
+#include "geometry_pool.h"
+#include "gl_extensions.h"
+#include "gl_state.h"
+#include <cstddef>
+
+InstanceBuffer::InstanceBuffer(GLStateCache& gl_state, GeometryPool& pool, uint32_t max_instances_per_frame, int frames_in_flight)
+    : gl_state_(gl_state), pool_(pool), max_instances_(max_instances_per_frame),
+      stream_(gl_state, GL_ARRAY_BUFFER, size_t(max_instances_per_frame) * sizeof(InstanceData), frames_in_flight) {
+    if (GLAD_GL_VERSION_4_2) {
+        draw_base_instance_ = glad_glDrawElementsInstancedBaseVertexBaseInstance;
+    } else if (has_gl_extension("GL_ARB_base_instance")) {
+        draw_base_instance_ = reinterpret_cast<PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCEPROC>(
+            get_gl_proc("glDrawElementsInstancedBaseVertexBaseInstance"));
+    }
+    gl_state_.bind_vertex_array(pool_.vertex_array());
+    for (unsigned int location = kFirstLocation; location < kFirstLocation + 4; ++location) {
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+    point_attributes(0);
+}
+
+void InstanceBuffer::point_attributes(size_t offset) {
+    // the attribute pointers live in the vertex array, the buffer is captured when they are set
+    gl_state_.bind_vertex_array(pool_.vertex_array());
+    gl_state_.bind_buffer(GL_ARRAY_BUFFER, stream_.buffer());
+    const GLsizei stride = sizeof(InstanceData);
+    glVertexAttribPointer(kFirstLocation, 4, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<void*>(offset + offsetof(InstanceData, translation)));
+    glVertexAttribPointer(kFirstLocation + 1, 4, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<void*>(offset + offsetof(InstanceData, color)));
+    glVertexAttribPointer(kFirstLocation + 2, 1, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<void*>(offset + offsetof(InstanceData, rotation)));
+    glVertexAttribIPointer(kFirstLocation + 3, 1, GL_UNSIGNED_INT, stride,
+                           reinterpret_cast<void*>(offset + offsetof(InstanceData, user_data)));
+}
+
+InstanceData* InstanceBuffer::allocate(uint32_t count, uint32_t& base_instance) {
+    size_t offset = 0;
+    // aligned to whole instances, so the offset is always a valid base instance
+    void* data = stream_.allocate(size_t(count) * sizeof(InstanceData), sizeof(InstanceData), offset);
+    base_instance = static_cast<uint32_t>(offset / sizeof(InstanceData));
+    return static_cast<InstanceData*>(data);
+}
+
+void InstanceBuffer::draw(int mesh, uint32_t first, uint32_t count, uint32_t instance_count, uint32_t base_instance) {
+    stream_.commit();
+    pool_.bind();
+    const MeshRange& range = pool_.mesh(mesh);
+    const void* indices = reinterpret_cast<const void*>(size_t(range.first_index + first) * pool_.index_size());
+    if (draw_base_instance_) {
+        draw_base_instance_(GL_TRIANGLES, count, pool_.index_type(), indices, instance_count,
+                            static_cast<GLint>(range.base_vertex), base_instance);
+        return;
+    }
+    point_attributes(size_t(base_instance) * sizeof(InstanceData));
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, count, pool_.index_type(), indices, instance_count,
+                                      static_cast<GLint>(range.base_vertex));
+}
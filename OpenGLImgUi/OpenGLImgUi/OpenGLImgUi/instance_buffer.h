@@ -0,0 +1,51 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include "stream_buffer.h"
+
+class GeometryPool;
+class GLStateCache;
+
+// what one instance gets, shader.vert reads it with USE_INSTANCING defined
+struct InstanceData {
+    float translation[3];
+    float scale;
+    float color[4];
+    float rotation;         // radians around z
+    uint32_t user_data;     // free for the caller, e.g. an id to pick by
+};
+
+// per instance attributes streamed every frame, drawn as many copies of one pool mesh in a single call
+// the attributes are set up once on the pool's vertex array (divisor 1, locations kFirstLocation and up),
+// so the pool's meshes can be drawn instanced without switching vertex arrays. one instance buffer per pool
+// each frame's instances are a slice of a StreamBuffer, with GL 4.2 / ARB_base_instance the slice is picked
+// with the base instance, otherwise the attribute pointers are moved to it before the draw
+class InstanceBuffer {
+public:
+    // locations kFirstLocation .. kFirstLocation + 3 are taken
+    static const unsigned int kFirstLocation = 4;
+
+    InstanceBuffer(GLStateCache& gl_state, GeometryPool& pool, uint32_t max_instances_per_frame, int frames_in_flight = 3);
+
+    // room for count instances this frame, nullptr if the frame is full
+    InstanceData* allocate(uint32_t count, uint32_t& base_instance);
+    // draw first/count indices of the mesh once per instance, starting at base_instance
+    void draw(int mesh, uint32_t first, uint32_t count, uint32_t instance_count, uint32_t base_instance);
+    // everything allocated so far visible to the gpu, draw() does this itself, shaders reading the instances don't
+    void commit() { stream_.commit(); }
+    // all draws with this frame's instances are issued
+    void end_frame() { stream_.end_frame(); }
+
+    bool base_instance() const { return draw_base_instance_ != nullptr; }
+    unsigned int buffer() const { return stream_.buffer(); }
+    uint32_t max_instances() const { return max_instances_; }
+
+private:
+    void point_attributes(size_t offset);
+
+    GLStateCache& gl_state_;
+    GeometryPool& pool_;
+    uint32_t max_instances_;
+    StreamBuffer stream_;
+    PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXBASEINSTANCEPROC draw_base_instance_ = nullptr;
+};
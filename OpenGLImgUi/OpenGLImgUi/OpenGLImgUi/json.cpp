@@ -0,0 +1,275 @@
+#include "json.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+    const JsonValue kNullValue;
+    // nesting deeper than this is rejected instead of running out of stack
+    const int kMaxDepth = 256;
+}
+
+// recursive descent over the text, each parse_* leaves pos_ behind what it read
+class JsonParser {
+public:
+    explicit JsonParser(std::string_view text) : text_(text) {}
+
+    bool parse(JsonValue& value, std::string& error) {
+        if (!parse_value(value, 0)) {
+            error = error_ + " at line " + std::to_string(line());
+            return false;
+        }
+        skip_whitespace();
+        if (pos_ != text_.size()) {
+            error = "trailing characters at line " + std::to_string(line());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    bool fail(const char* message) {
+        error_ = message;
+        return false;
+    }
+
+    size_t line() const {
+        return std::count(text_.begin(), text_.begin() + std::min(pos_, text_.size()), '\n') + 1;
+    }
+
+    void skip_whitespace() {
+        while (pos_ < text_.size() && (text_[pos_] == ' ' || text_[pos_] == '\t' || text_[pos_] == '\n' || text_[pos_] == '\r')) {
+            ++pos_;
+        }
+    }
+
+    bool consume(std::string_view word) {
+        if (text_.substr(pos_, word.size()) != word) {
+            return false;
+        }
+        pos_ += word.size();
+        return true;
+    }
+
+    bool parse_value(JsonValue& value, int depth) {
+        if (depth > kMaxDepth) {
+            return fail("nested too deep");
+        }
+        skip_whitespace();
+        if (pos_ >= text_.size()) {
+            return fail("unexpected end");
+        }
+        switch (text_[pos_]) {
+            case '{': return parse_object(value, depth);
+            case '[': return parse_array(value, depth);
+            case '"':
+                value.type_ = JsonValue::kString;
+                return parse_string(value.string_);
+            case 't':
+            case 'f':
+                value.type_ = JsonValue::kBool;
+                value.bool_ = text_[pos_] == 't';
+                return consume(value.bool_ ? "true" : "false") || fail("invalid literal");
+            case 'n':
+                value.type_ = JsonValue::kNull;
+                return consume("null") || fail("invalid literal");
+            default: return parse_number(value);
+        }
+    }
+
+    bool parse_object(JsonValue& value, int depth) {
+        value.type_ = JsonValue::kObject;
+        ++pos_;
+        skip_whitespace();
+        if (pos_ < text_.size() && text_[pos_] == '}') {
+            ++pos_;
+            return true;
+        }
+        while (true) {
+            skip_whitespace();
+            std::string key;
+            if (pos_ >= text_.size() || text_[pos_] != '"' || !parse_string(key)) {
+                return error_.empty() ? fail("expected a member name") : false;
+            }
+            skip_whitespace();
+            if (pos_ >= text_.size() || text_[pos_] != ':') {
+                return fail("expected ':'");
+            }
+            ++pos_;
+            value.members_.emplace_back(std::move(key), JsonValue());
+            if (!parse_value(value.members_.back().second, depth + 1)) {
+                return false;
+            }
+            skip_whitespace();
+            if (pos_ < text_.size() && text_[pos_] == ',') {
+                ++pos_;
+                continue;
+            }
+            if (pos_ < text_.size() && text_[pos_] == '}') {
+                ++pos_;
+                return true;
+            }
+            return fail("expected ',' or '}'");
+        }
+    }
+
+    bool parse_array(JsonValue& value, int depth) {
+        value.type_ = JsonValue::kArray;
+        ++pos_;
+        skip_whitespace();
+        if (pos_ < text_.size() && text_[pos_] == ']') {
+            ++pos_;
+            return true;
+        }
+        while (true) {
+            value.elements_.emplace_back();
+            if (!parse_value(value.elements_.back(), depth + 1)) {
+                return false;
+            }
+            skip_whitespace();
+            if (pos_ < text_.size() && text_[pos_] == ',') {
+                ++pos_;
+                continue;
+            }
+            if (pos_ < text_.size() && text_[pos_] == ']') {
+                ++pos_;
+                return true;
+            }
+            return fail("expected ',' or ']'");
+        }
+    }
+
+    bool parse_hex4(unsigned int& code) {
+        if (pos_ + 4 > text_.size()) {
+            return fail("truncated \\u escape");
+        }
+        code = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = text_[pos_++];
+            code <<= 4;
+            if (c >= '0' && c <= '9') {
+                code |= c - '0';
+            } else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+                code |= (c | 0x20) - 'a' + 10;
+            } else {
+                return fail("invalid \\u escape");
+            }
+        }
+        return true;
+    }
+
+    static void append_utf8(std::string& out, unsigned int code) {
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    bool parse_string(std::string& out) {
+        ++pos_;
+        while (pos_ < text_.size()) {
+            char c = text_[pos_++];
+            if (c == '"') {
+                return true;
+            }
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (pos_ >= text_.size()) {
+                break;
+            }
+            switch (text_[pos_++]) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    unsigned int code;
+                    if (!parse_hex4(code)) {
+                        return false;
+                    }
+                    // a surrogate pair is two escapes for one code point
+                    if (code >= 0xD800 && code < 0xDC00 && consume("\\u")) {
+                        unsigned int low;
+                        if (!parse_hex4(low)) {
+                            return false;
+                        }
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    append_utf8(out, code);
+                    break;
+                }
+                default: return fail("invalid escape");
+            }
+        }
+        return fail("unterminated string");
+    }
+
+    bool parse_number(JsonValue& value) {
+        size_t start = pos_;
+        while (pos_ < text_.size() && std::string_view("+-.eE0123456789").find(text_[pos_]) != std::string_view::npos) {
+            ++pos_;
+        }
+        std::string token(text_.substr(start, pos_ - start));
+        char* token_end = nullptr;
+        value.number_ = std::strtod(token.c_str(), &token_end);
+        if (token.empty() || token_end != token.c_str() + token.size()) {
+            pos_ = start;
+            return fail("invalid value");
+        }
+        value.type_ = JsonValue::kNumber;
+        return true;
+    }
+
+    std::string_view text_;
+    size_t pos_ = 0;
+    std::string error_;
+};
+
+long long JsonValue::integer(long long fallback) const {
+    if (type_ != kNumber || number_ != std::floor(number_) || std::fabs(number_) > 9007199254740992.0) {
+        return fallback;
+    }
+    return static_cast<long long>(number_);
+}
+
+size_t JsonValue::size() const {
+    return type_ == kArray ? elements_.size() : type_ == kObject ? members_.size() : 0;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const {
+    return type_ == kArray && index < elements_.size() ? elements_[index] : kNullValue;
+}
+
+const JsonValue& JsonValue::operator[](std::string_view key) const {
+    if (type_ == kObject) {
+        for (const auto& member : members_) {
+            if (member.first == key) {
+                return member.second;
+            }
+        }
+    }
+    return kNullValue;
+}
+
+bool parse_json(std::string_view text, JsonValue& value, std::string& error) {
+    value = JsonValue();
+    JsonParser parser(text);
+    return parser.parse(value, error);
+}
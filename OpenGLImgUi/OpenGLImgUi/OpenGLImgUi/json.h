@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// just enough json for asset descriptions like gltf: parsed into a tree in one go, read through accessors
+// that fall back to defaults, so a missing or mistyped member reads as "not there" instead of throwing
+class JsonValue {
+public:
+    enum Type { kNull, kBool, kNumber, kString, kArray, kObject };
+
+    Type type() const { return type_; }
+    bool is_null() const { return type_ == kNull; }
+    bool is_number() const { return type_ == kNumber; }
+    bool is_string() const { return type_ == kString; }
+    bool is_array() const { return type_ == kArray; }
+    bool is_object() const { return type_ == kObject; }
+
+    bool boolean(bool fallback = false) const { return type_ == kBool ? bool_ : fallback; }
+    double number(double fallback = 0.0) const { return type_ == kNumber ? number_ : fallback; }
+    // numbers that are whole and fit, everything else is fallback
+    long long integer(long long fallback = -1) const;
+    const std::string& string() const { return string_; }
+
+    // elements of an array, members of an object, 0 for anything else
+    size_t size() const;
+    // a null value when out of range or not an array
+    const JsonValue& operator[](size_t index) const;
+    // a null value when missing or not an object
+    const JsonValue& operator[](std::string_view key) const;
+    const JsonValue& operator[](const char* key) const { return (*this)[std::string_view(key)]; }
+    bool has(std::string_view key) const { return !(*this)[key].is_null(); }
+
+private:
+    friend class JsonParser;
+
+    Type type_ = kNull;
+    bool bool_ = false;
+    double number_ = 0.0;
+    std::string string_;
+    std::vector<JsonValue> elements_;
+    std::vector<std::pair<std::string, JsonValue>> members_;
+};
+
+// returns false and fills error (with the line) if text isn't valid json
+bool parse_json(std::string_view text, JsonValue& value, std::string& error);
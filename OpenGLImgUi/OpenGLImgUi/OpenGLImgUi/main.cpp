@@ -2,152 +2,273 @@
 // VC++ directories, Include directories ../opengl/include; library dirs ../opengl/libs
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "asset_registry.h"
+#include "batch_renderer.h"
+#include "command_recorder.h"
+#include "fixed_step_thread.h"
+#include "frame_capture.h"
+#include "frame_graph.h"
+#include "frame_profiler.h"
+#include "gl_extensions.h"
+#include "geometry_pool.h"
+#include "gpu_culler.h"
+#include "gl_state.h"
+#include "headless_context.h"
+#include "input_actions.h"
+#include "input_events.h"
+#include "instance_buffer.h"
+#include "mesh_file.h"
+#include "mesh_importer.h"
+#include "offscreen_target.h"
+#include "png_writer.h"
+#include "program_cache.h"
+#include "shader_compiler.h"
+#include "shader_preprocessor.h"
+#include "shader_reloader.h"
+#include "snapshot_buffer.h"
+#include "stress_scene.h"
+#include "texture_atlas.h"
+#include "texture_file.h"
+#include "texture_streamer.h"
+#include "uniform_table.h"
+#include "vertex_layout.h"
 
-enum IntType {
-    kShader,
-    kProgram
-};
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
-void processInput(GLFWwindow *window);
-
-void prepare_shader_source(const char* fname, std::string& source);
-void check_errors(unsigned int item, IntType type);
+int import_model(const char* path);
+std::vector<std::string> list_textures(const char* directory);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+// --stress draws this many instances of the quad every frame
+const unsigned int STRESS_GRID = 1000;
+const unsigned int STRESS_INSTANCES = STRESS_GRID * STRESS_GRID;
+// the quad's corners are 0.5 from its center on both axes, what the gpu culling tests is the sphere around them
+const float QUAD_RADIUS = 0.70711f;
+// steps per second of the simulation thread, however fast we render
+const double SIMULATION_RATE = 60.0;
+// --headless renders this many frames unless --frames says otherwise
+const unsigned int HEADLESS_FRAMES = 300;
+// --textures keeps the streamed levels within this budget, --texture-budget <MB> overrides it
+const size_t TEXTURE_BUDGET_MB = 512;
+// what the texture streamer may upload per frame
+const size_t TEXTURE_UPLOAD_BYTES = 8 * 1024 * 1024;
+// --atlas packs its images into layers of this size, 16 MB each
+const unsigned int ATLAS_SIZE = 2048;
+const int ATLAS_LAYERS = 4;
+const unsigned int ATLAS_MAX_REGIONS = 4096;
+// the units the atlas and its region table are bound to when there are no bindless textures
+const unsigned int ATLAS_TEXTURE_UNIT = 1;
+const unsigned int ATLAS_REGION_UNIT = 2;
+
+// what the input bindings map to
+enum InputAction {
+    kActionQuit,
+    kActionWireframe,
+    kActionFill
+};
 
-void check_errors(unsigned int obj_int, IntType type) {
-    // check if the shader loading failed
-    int  success;
-    char infoLog[512];
-    switch (type) {
-        case IntType::kShader:
-            glGetShaderiv(obj_int, GL_COMPILE_STATUS, &success);
-            if (!success) {
-                glGetShaderInfoLog(obj_int, 512, NULL, infoLog);
-                std::cout << "ERROR::SHADER:COMPILATION_FAILED\n" << infoLog << std::endl;
-            }
-            break;
+// one entry of the scene, recorded into command lists every frame. the program is looked up at recording
+// time, hot reloads swap it
+struct SceneDraw {
+    const unsigned int* program;
+    uint32_t first_index;
+    uint32_t index_count;
+};
 
-        case IntType::kProgram:
-            glGetProgramiv(obj_int, GL_LINK_STATUS, &success);
-            if (!success) {
-                glGetProgramInfoLog(obj_int, 512, NULL, infoLog);
-                std::cout << "ERROR::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-            }
-            break;
-        default:
-            break;
+int main(int argc, char** argv) {
+    bool stress = false;
+    bool headless = false;
+    const char* import_path = nullptr;
+    // --frames stops after that many frames (0 runs until the window closes), --output saves the last one
+    // (.png or .ppm), --capture <directory> saves every frame as png, raw rgba with --capture-raw
+    // --timings <file> writes the per pass timings on exit, .csv or .json
+    // --textures <directory> streams every .dds and .ktx2 in it and uses all of them every frame
+    // --atlas <directory> packs the rgba8 .dds and .ktx2 in it into an atlas the --stress quads are textured from
+    // --zoom <factor> zooms the --stress camera in so the quads outside get culled, --check-cull counts the
+    // survivors on the cpu as well and compares
+    unsigned int frame_limit = 0;
+    const char* output_path = nullptr;
+    const char* capture_directory = nullptr;
+    bool capture_raw = false;
+    const char* timings_path = nullptr;
+    const char* texture_directory = nullptr;
+    const char* atlas_directory = nullptr;
+    size_t texture_budget_mb = TEXTURE_BUDGET_MB;
+    float zoom = 1.0f;
+    bool check_cull = false;
+    for (int i = 1; i < argc; ++i) {
+        stress = stress || std::strcmp(argv[i], "--stress") == 0;
+        headless = headless || std::strcmp(argv[i], "--headless") == 0;
+        capture_raw = capture_raw || std::strcmp(argv[i], "--capture-raw") == 0;
+        check_cull = check_cull || std::strcmp(argv[i], "--check-cull") == 0;
+        if (std::strcmp(argv[i], "--import") == 0 && i + 1 < argc) {
+            import_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frame_limit = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            capture_directory = argv[++i];
+        } else if (std::strcmp(argv[i], "--timings") == 0 && i + 1 < argc) {
+            timings_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--textures") == 0 && i + 1 < argc) {
+            texture_directory = argv[++i];
+        } else if (std::strcmp(argv[i], "--atlas") == 0 && i + 1 < argc) {
+            atlas_directory = argv[++i];
+        } else if (std::strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc) {
+            texture_budget_mb = static_cast<size_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--zoom") == 0 && i + 1 < argc) {
+            zoom = std::strtof(argv[++i], nullptr);
+        }
+    }
+    // --import <model> only bakes, no window needed
+    if (import_path) {
+        return import_model(import_path);
+    }
+    // nothing would ever close it
+    if (headless && frame_limit == 0) {
+        frame_limit = HEADLESS_FRAMES;
     }
-}
-
-
-void prepare_shader_source(const char* fname, std::string& source) {
-    std::ifstream file;
-    file.open(fname);
-    std::stringstream stream;
-    stream << file.rdbuf();
-    source = stream.str();
-}
-
-int main() {
-
-    // file names for the shader sources
-    const char* vertex_shader_source_name = "shader.vert";
-    const char* fragment_shader_source_name_t1 = "shader_t1.frag";
-    const char* fragment_shader_source_name_t2 = "shader_t2.frag";
-
-    // what we load as the shader source
-    std::string vertex_shader_source;
-    std::string fragment_shader_source_t1;
-    std::string fragment_shader_source_t2;
-
-
-    // glfw: initialize and configure
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    // glfw window creation
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", nullptr, nullptr);
-    if (window == nullptr) {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+    // the shader stages, both triangles share one fragment shader and only differ in the defines
+    ShaderStage vertex_stage = { "shader.vert", {} };
+    ShaderStage fragment_stage_t1 = { "shader.frag", { "USE_VERTEX_COLOR" } };
+    ShaderStage fragment_stage_t2 = { "shader.frag", {} };
+    // the stress test's quads take their transform and color from the instance attributes
+    ShaderStage vertex_stage_instanced = { "shader.vert", { "USE_INSTANCING" } };
+    ShaderStage fragment_stage_instanced = { "shader.frag", { "USE_VERTEX_COLOR" } };
+    // frustum culling of the stress quads and the indirect commands for the survivors
+    ShaderStage cull_stage = { "cull.comp", {} };
+    ShaderStage cull_args_stage = { "cull.comp", { "WRITE_ARGS" } };
+
+
+    GLFWwindow* window = nullptr;
+    GLADloadproc gl_loader = (GLADloadproc)glfwGetProcAddress;
+    // --headless: same 3.3 core context without a window, the frames go into an offscreen target of the window's size
+    HeadlessContext headless_context;
+    OffscreenTarget offscreen_target;
+    if (headless) {
+        std::string context_error;
+        if (!headless_context.create(3, 3, context_error)) {
+            std::cout << "ERROR::HEADLESS::NO_CONTEXT\n" << context_error << std::endl;
+            return -1;
+        }
+        // only the hidden window fallback has one, the shader compiler's worker contexts share with it
+        window = headless_context.window();
+        gl_loader = headless_context.loader();
+    } else {
+        // glfw: initialize and configure
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+        // glfw window creation
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", nullptr, nullptr);
+        if (window == nullptr) {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
     // glad: load all OpenGL function pointers
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+    if (!gladLoadGLLoader(gl_loader)) {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    init_gl_extensions(gl_loader);
+    // with compute shaders the gpu culls the stress quads itself and draws what's left indirectly
+    const bool gpu_cull = stress && GpuCuller::supported();
+    // --atlas: each quad samples its image from the atlas, the region comes with the instance so they stay one draw
+    const bool use_atlas = stress && atlas_directory;
+    const bool atlas_bindless = use_atlas && TextureAtlas::bindless_supported();
+    if (use_atlas) {
+        vertex_stage_instanced.defines.push_back("USE_ATLAS");
+        fragment_stage_instanced.defines.push_back("USE_ATLAS");
+        if (atlas_bindless) {
+            vertex_stage_instanced.defines.push_back("USE_BINDLESS");
+            fragment_stage_instanced.defines.push_back("USE_BINDLESS");
+        }
+    }
+    if (headless) {
+        if (!offscreen_target.create(SCR_WIDTH, SCR_HEIGHT)) {
+            std::cout << "ERROR::HEADLESS::NO_FRAMEBUFFER" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        // stays bound, nothing else renders into a framebuffer
+        offscreen_target.bind();
+    }
 
-    // read the shader into a string for later usage
-    prepare_shader_source(vertex_shader_source_name, vertex_shader_source);
-    prepare_shader_source(fragment_shader_source_name_t1, fragment_shader_source_t1);
-    prepare_shader_source(fragment_shader_source_name_t2, fragment_shader_source_t2);
-
-    // ! VERTEX SHADER
-    unsigned int vertex_shader;
-    vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    // take the string data and pass it as a const char*
-    const char* vertex_data = vertex_shader_source.data();
-    glShaderSource(vertex_shader, 1, &vertex_data, nullptr);
-    // compile the shader and check for errors
-    glCompileShader(vertex_shader);
-    check_errors(vertex_shader, IntType::kShader);
-
-
-    // ! FRAGMENT SHADER 1
-    unsigned int fragment_shader_t1;
-    fragment_shader_t1 = glCreateShader(GL_FRAGMENT_SHADER);
-    const char* fragment_data = fragment_shader_source_t1.data();
-    glShaderSource(fragment_shader_t1, 1, &fragment_data, nullptr);
-    glCompileShader(fragment_shader_t1);
-    check_errors(fragment_shader_t1, IntType::kShader);
-
-    // ! SHADER PROGRAM
-    unsigned int shader_program_t1;
-    // create a shader program
-    shader_program_t1 = glCreateProgram();
-    // link the vertex and fragment shader
-    glAttachShader(shader_program_t1, vertex_shader);
-    glAttachShader(shader_program_t1, fragment_shader_t1);
-    // link the program and check for errors
-    glLinkProgram(shader_program_t1);
-    check_errors(shader_program_t1, IntType::kProgram);
-
-
-    // ! FRAGMENT SHADER 2
-    unsigned int fragment_shader_t2;
-    fragment_shader_t2 = glCreateShader(GL_FRAGMENT_SHADER);
-    fragment_data = fragment_shader_source_t2.data();
-    glShaderSource(fragment_shader_t2, 1, &fragment_data, nullptr);
-    glCompileShader(fragment_shader_t2);
-    check_errors(fragment_shader_t2, IntType::kShader);
-
-    // ! SHADER PROGRAM
-    unsigned int shader_program_t2;
-    // create a shader program
-    shader_program_t2 = glCreateProgram();
-    // link the vertex and fragment shader
-    glAttachShader(shader_program_t2, vertex_shader);
-    glAttachShader(shader_program_t2, fragment_shader_t2);
-    // link the program and check for errors
-    glLinkProgram(shader_program_t2);
-    check_errors(shader_program_t2, IntType::kProgram);
-
-    // delete the shaders since they are loaded in the program
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader_t1);
-    glDeleteShader(fragment_shader_t2);
+    // map every shader in the directory in one go, the registry owns the mappings for the rest of main
+    AssetRegistry shader_sources;
+    shader_sources.load_directory(".", { ".vert", ".frag", ".glsl", ".comp" });
+    // resolve includes and defines, stages that expand to the same source share one variant
+    ShaderPreprocessor shader_preprocessor(shader_sources);
+    // positions as snorm16, 8 instead of 12 bytes per vertex, everything we draw is within -1..1
+    VertexLayout vertex_layout({ { kPosition, kSnorm16x4 } });
+    // the vertex shader declares and decodes its inputs with what the layout generates
+    shader_preprocessor.add_generated("vertex_layout.glsl", vertex_layout.glsl());
+    const ShaderVariant* vertex_variant = shader_preprocessor.expand(vertex_stage);
+    const ShaderVariant* fragment_variant_t1 = shader_preprocessor.expand(fragment_stage_t1);
+    const ShaderVariant* fragment_variant_t2 = shader_preprocessor.expand(fragment_stage_t2);
+    const ShaderVariant* vertex_variant_instanced = shader_preprocessor.expand(vertex_stage_instanced);
+    const ShaderVariant* fragment_variant_instanced = shader_preprocessor.expand(fragment_stage_instanced);
+    const ShaderVariant* cull_variant = gpu_cull ? shader_preprocessor.expand(cull_stage) : nullptr;
+    const ShaderVariant* cull_args_variant = gpu_cull ? shader_preprocessor.expand(cull_args_stage) : nullptr;
+    if (!vertex_variant || !fragment_variant_t1 || !fragment_variant_t2 || !vertex_variant_instanced || !fragment_variant_instanced ||
+        (gpu_cull && (!cull_variant || !cull_args_variant))) {
+        std::cout << "Failed to load shader sources" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    shader_preprocessor.print_stats();
+
+    // ! SHADER PROGRAMS
+    // measure how long it takes until both programs are ready for the first frame, this is the bulk of our startup
+    auto shader_startup_begin = std::chrono::steady_clock::now();
+    // programs are keyed by their sources, if the binary is still valid we skip compiling altogether
+    ProgramCache program_cache("shader_cache");
+    // everything is submitted here and compiles in the background while we set up the geometry,
+    // the shared vertex shader is only compiled once
+    ShaderCompiler shader_compiler(window, program_cache);
+#ifndef NDEBUG
+    // debug builds recompile shaders as we edit them, has to exist before the programs are submitted
+    ShaderReloader shader_reloader(shader_compiler, shader_preprocessor, ".");
+#endif
+    unsigned int shader_program_t1 = shader_compiler.submit_program(vertex_variant->source, fragment_variant_t1->source);
+    unsigned int shader_program_t2 = shader_compiler.submit_program(vertex_variant->source, fragment_variant_t2->source);
+    unsigned int shader_program_instanced = 0;
+    if (stress) {
+        shader_program_instanced = shader_compiler.submit_program(vertex_variant_instanced->source, fragment_variant_instanced->source);
+    }
+    unsigned int cull_program = 0;
+    unsigned int cull_args_program = 0;
+    if (gpu_cull) {
+        cull_program = shader_compiler.submit_compute_program(cull_variant->source);
+        cull_args_program = shader_compiler.submit_compute_program(cull_args_variant->source);
+    }
+#ifndef NDEBUG
+    shader_reloader.track(&shader_program_t1, vertex_stage, fragment_stage_t1);
+    shader_reloader.track(&shader_program_t2, vertex_stage, fragment_stage_t2);
+    if (stress) {
+        shader_reloader.track(&shader_program_instanced, vertex_stage_instanced, fragment_stage_instanced);
+    }
+#endif
+    bool startup_reported = false;
 
 
     // ! VERTEX INPUT
@@ -164,107 +285,490 @@ int main() {
          0.0f, -1.0f, 0.0f, // bottom - 7
     };
 
-    // here we define what vertices get used to form shapes
-    unsigned int indices_t1[] = {
+    // here we define what vertices get used to form shapes, both triangles live in one index range
+    unsigned int indices[] = {
         // define triangles
-        0, 1, 2,
-        // 2, 3, 0,
+        0, 1, 2, // t1
+        2, 3, 0, // t2
         //2, 4, 3,
         //2, 5, 1,
         //0, 6, 1,
         //3, 7, 0
     };
 
-    unsigned int indices_t2[] = {
-        // define triangles
-        //0, 1, 2,
-        2, 3, 0,
-        //2, 4, 3,
-        //2, 5, 1,
-        //0, 6, 1,
-        //3, 7, 0
+    // every bind goes through here so we only talk to the driver when the state really changes
+    GLStateCache gl_state;
+
+    // quantize into the layout's format
+    const size_t vertex_count = sizeof(vertices) / (3 * sizeof(float));
+    const uint32_t index_count = sizeof(indices) / sizeof(indices[0]);
+    std::vector<unsigned char> packed_vertices(vertex_count * vertex_layout.stride());
+    VertexStreams vertex_streams;
+    vertex_streams.positions = vertices;
+    vertex_layout.encode(vertex_streams, vertex_count, packed_vertices.data());
+    // the optimized quad is baked into a mesh file and mapped from there, it is only baked again when the
+    // vertices, indices or layout above change. t2 starts at index 3, the optimizer keeps the two triangles apart
+    const std::vector<uint32_t> quad_submeshes = { 3 };
+    const uint64_t quad_hash = mesh_source_hash(vertex_layout, packed_vertices.data(), static_cast<uint32_t>(vertex_count),
+                                                indices, index_count, quad_submeshes);
+    MeshFile quad_file;
+    std::string mesh_error;
+    if (!quad_file.open("quad.mesh", mesh_error) || quad_file.layout() != vertex_layout ||
+        quad_file.header().source_hash != quad_hash) {
+        MeshOptimizeStats mesh_stats;
+        if (!write_mesh_file("quad.mesh", vertex_layout, packed_vertices.data(), static_cast<uint32_t>(vertex_count), indices,
+                             index_count, quad_submeshes, GL_UNSIGNED_SHORT, mesh_error, &mesh_stats) ||
+            !quad_file.open("quad.mesh", mesh_error)) {
+            std::cout << "ERROR::MESH::" << mesh_error << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        std::cout << "baked quad.mesh: ACMR " << mesh_stats.before.acmr() << " -> " << mesh_stats.after.acmr()
+                  << ", ATVR " << mesh_stats.before.atvr() << " -> " << mesh_stats.after.atvr() << std::endl;
+    }
+    // the hash only says what the file was baked from, t1 and t2 are read from its submesh table
+    if (quad_file.submesh_count() < 2) {
+        std::cout << "ERROR::MESH::quad.mesh: " << quad_file.submesh_count() << " submeshes, t1 and t2 need 2" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    // all meshes share one vertex buffer, one index buffer and one vertex array, the vertices are uploaded once
+    // our meshes are small, 16 bit indices are plenty
+    std::unique_ptr<GeometryPool> geometry_pool(new GeometryPool(gl_state, vertex_layout, 1024, 4096, GL_UNSIGNED_SHORT));
+    // straight from the mapping into the pool's buffers
+    int quad_mesh = geometry_pool->add_prepared_mesh(quad_file.vertices(), quad_file.vertex_count(), quad_file.indices(),
+                                                     quad_file.index_type(), quad_file.index_count());
+    if (quad_mesh < 0) {
+        std::cout << "ERROR::MESH::quad.mesh: doesn't fit the geometry pool" << std::endl;
+        geometry_pool.reset();
+        glfwTerminate();
+        return -1;
+    }
+    const MeshFileSubmesh quad_t1 = quad_file.submeshes()[0];
+    const MeshFileSubmesh quad_t2 = quad_file.submeshes()[1];
+    // sorts each frame's command lists by layer, program and material and submits the draws with multi draw indirect
+    std::unique_ptr<BatchRenderer> batch_renderer(new BatchRenderer(gl_state));
+    // scenes big enough to be worth it are recorded on worker threads, the batch renderer replays the lists
+    CommandRecorder command_recorder;
+    std::vector<SceneDraw> scene_draws = {
+        { &shader_program_t1, quad_t1.first_index, quad_t1.index_count },
+        { &shader_program_t2, quad_t2.first_index, quad_t2.index_count }
     };
+    // per instance attributes on the pool's vertex array, only sized for the stress test when it runs. the gpu
+    // culling copies the visible ones into a second slice of the same size
+    std::unique_ptr<InstanceBuffer> instance_buffer(
+        new InstanceBuffer(gl_state, *geometry_pool, stress ? STRESS_INSTANCES * (gpu_cull ? 2 : 1) : 1024));
+    std::unique_ptr<GpuCuller> gpu_culler;
+    if (gpu_cull) {
+        gpu_culler.reset(new GpuCuller(gl_state, *geometry_pool, cull_program, cull_args_program));
+        // both triangles of the quad
+        gpu_culler->add_draw(quad_mesh, 0, 2 * 3);
+    }
+    // the quads are at -2..2, at w = 2 the whole grid is on screen. zoomed in only the middle is left and
+    // the culling has something to do
+    const float stress_view_projection[16] = {
+        zoom, 0.0f, 0.0f, 0.0f,
+        0.0f, zoom, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 2.0f
+    };
+    float stress_frustum[6][4];
+    frustum_planes(stress_view_projection, stress_frustum);
+    uint64_t frame_count = 0;
+    // main's result, a frame that can't be rendered ends the loop early
+    int exit_code = 0;
+    // what the cpu counted for the last cull with --check-cull
+    uint32_t cull_reference = 0;
+    // the same frame interpolated again for it, the stream buffer's mapping is write only
+    std::vector<InstanceData> cull_check_instances;
+    // reads back through pixel pack buffers a few frames late, the files are written on its own thread
+    std::unique_ptr<FrameCapture> frame_capture;
+    if (capture_directory) {
+        frame_capture.reset(new FrameCapture(gl_state, capture_directory, capture_raw ? FrameCapture::kRaw : FrameCapture::kPng));
+        frame_capture->set_wait_for_writer(headless);
+    }
+    // binds each pass's targets, pools its transient textures and buffers and culls what nobody reads
+    std::unique_ptr<FrameGraph> frame_graph(new FrameGraph(gl_state));
+
+    // ! TEXTURES
+    // loaded on worker threads, coarse levels first, finer ones while there is budget and uploaded a few MB a frame
+    std::unique_ptr<TextureStreamer> texture_streamer;
+    std::vector<int> streamed_textures;
+    if (texture_directory) {
+        texture_streamer.reset(new TextureStreamer(gl_state, texture_budget_mb * 1024 * 1024, TEXTURE_UPLOAD_BYTES));
+        for (const std::string& path : list_textures(texture_directory)) {
+            streamed_textures.push_back(texture_streamer->request(path));
+        }
+    }
+    // many small images in the layers of one array texture, so the quads drawing different ones are still one draw
+    std::unique_ptr<TextureAtlas> texture_atlas;
+    if (use_atlas) {
+        texture_atlas.reset(new TextureAtlas(gl_state, ATLAS_SIZE, ATLAS_LAYERS, ATLAS_MAX_REGIONS, atlas_bindless));
+        const std::vector<std::string> atlas_paths = list_textures(atlas_directory);
+        std::vector<TextureFile> atlas_files(atlas_paths.size());
+        std::vector<AtlasImage> atlas_images;
+        for (size_t i = 0; i < atlas_paths.size(); ++i) {
+            std::string error;
+            AtlasImage image;
+            if (!atlas_files[i].open(atlas_paths[i], error) || !TextureAtlas::image_from_file(atlas_files[i], image, error)) {
+                std::cout << "ERROR::ATLAS::" << atlas_paths[i] << ": " << error << std::endl;
+                continue;
+            }
+            atlas_images.push_back(image);
+        }
+        // the whole set at once packs tighter than one by one, if that doesn't fit we take what does
+        std::vector<int> atlas_regions;
+        if (!texture_atlas->add_all(atlas_images, atlas_regions)) {
+            for (const AtlasImage& image : atlas_images) {
+                if (texture_atlas->add(image) < 0) {
+                    std::cout << "ERROR::ATLAS::FULL: " << image.width << "x" << image.height << " image left out" << std::endl;
+                }
+            }
+        }
+        // nothing to pack, a white texel keeps the quads their colors
+        if (texture_atlas->region_count() == 0) {
+            const unsigned char white[4] = { 255, 255, 255, 255 };
+            texture_atlas->add({ white, 1, 1, GL_RGBA });
+        }
+        std::cout << "atlas: " << texture_atlas->region_count() << " images in " << texture_atlas->layers_used() << " of "
+                  << texture_atlas->layer_count() << " layers, " << texture_atlas->occupancy() * 100.0 << "% occupied ("
+                  << (texture_atlas->bindless() ? "bindless" : "bound") << ")" << std::endl;
+    }
 
-    // need to create a vertex attribute objects, that holds the info for vertices in the vertex buffer object
-    unsigned int vertex_attribute_objects[2];
-    unsigned int vertex_buffer_objects[2];
-    glGenBuffers(2, vertex_buffer_objects);
-    glGenVertexArrays(2, vertex_attribute_objects);
-    
-    // t1
-    glBindVertexArray(vertex_attribute_objects[0]);
-    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_objects[0]);
-    // could splitvertices since its shitty we pass data twice
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    // how to use the data
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-    // t2
-    glBindVertexArray(vertex_attribute_objects[1]);
-    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_objects[1]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-
-    // define the element buffer, enables us to pass indices instead of vertex chunks
-    unsigned int element_buffer_objects[2];
-    glGenBuffers(2, element_buffer_objects);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer_objects[0]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices_t1), indices_t1, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer_objects[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices_t2), indices_t2, GL_STATIC_DRAW);
+    // ! UNIFORMS
+    // the compiler reflects the programs into these once they are linked, and again after every hot reload.
+    // the names are resolved here and the frame loop only uses the indices
+    UniformTable uniforms_t2;
+    shader_compiler.reflect_uniforms(shader_program_t2, &uniforms_t2);
+    const int color_uniform_t2 = uniforms_t2.declare("uColor");
+    const float color_t2[4] = { 1.0f, 1.0f, 0.2f, 1.0f };
+    UniformTable uniforms_instanced;
+    if (stress) {
+        shader_compiler.reflect_uniforms(shader_program_instanced, &uniforms_instanced);
+    }
+    const int view_projection_uniform = uniforms_instanced.declare("uViewProjection");
+    const int atlas_uniform = uniforms_instanced.declare("uAtlas");
+    const int atlas_region_uniform = uniforms_instanced.declare("uAtlasRegions");
+    // bindless handles are set once per program, hot reloads relink it
+    unsigned int atlas_handles_program = 0;
+
+    // ! SIMULATION
+    // the stress scene moves at a fixed rate on its own thread, every step is published as a complete snapshot
+    // and the render loop interpolates between the last two it got, so neither waits for the other
+    std::unique_ptr<StressScene> stress_scene;
+    SnapshotBuffer<StressState> stress_snapshots;
+    FixedStepThread simulation(SIMULATION_RATE, [&](uint64_t) {
+        StressState& next = stress_snapshots.write_slot();
+        stress_scene->simulate(*stress_snapshots.latest(), next);
+        stress_snapshots.publish();
+    });
+    if (stress) {
+        stress_scene.reset(new StressScene(STRESS_GRID, simulation.step_seconds(), texture_atlas ? texture_atlas->region_count() : 0));
+        stress_scene->initial_state(stress_snapshots.write_slot());
+        stress_snapshots.publish();
+        simulation.start();
+    }
+
+    // ! INPUT
+    // glfw's callbacks queue timestamped events, the bindings turn them into actions and we only act when one
+    // goes down or up. the queue is lock free, a simulation thread could consume it just as well
+    InputEventQueue input_events;
+    std::unique_ptr<GlfwInput> glfw_input;
+    if (!headless) {
+        glfw_input.reset(new GlfwInput(window, input_events));
+    }
+    InputActions input_actions;
+    input_actions.bind_key(GLFW_KEY_ESCAPE, kActionQuit);
+    input_actions.bind_key(GLFW_KEY_1, kActionWireframe);
+    input_actions.bind_key(GLFW_KEY_2, kActionFill);
+    // a and b on most gamepads
+    input_actions.bind_joystick_button(0, kActionWireframe);
+    input_actions.bind_joystick_button(1, kActionFill);
+    const InputActions::Handler input_handler = [&](int action, bool pressed, int64_t) {
+        if (!pressed) {
+            return;
+        }
+        switch (action) {
+            case kActionQuit: glfwSetWindowShouldClose(window, true); break;
+            case kActionWireframe: gl_state.polygon_mode(GL_LINE); break;
+            case kActionFill: gl_state.polygon_mode(GL_FILL); break;
+        }
+    };
+
+    // cpu and gpu time of every pass below, the gpu's is read a few frames late so it never waits
+    std::unique_ptr<FrameProfiler> profiler(new FrameProfiler());
+    // frame times, the first one includes waiting on the compiler so it's kept apart from the rest
+    auto frames_begin = std::chrono::steady_clock::now();
+    double first_frame_ms = 0.0;
+    double frame_ms_min = 0.0;
+    double frame_ms_max = 0.0;
+    std::vector<unsigned char> output_pixels;
+    int output_width = 0;
+    int output_height = 0;
 
     // render loop
-    while (!glfwWindowShouldClose(window)) {
-        // input
-        processInput(window);
-
-
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        // use our program
-        glUseProgram(shader_program_t1);
-        // bind the attribute object first
-        glBindVertexArray(vertex_attribute_objects[0]);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer_objects[0]);
-        glDrawElements(GL_TRIANGLES, 1 * 3, GL_UNSIGNED_INT, 0);
-        
-        // use our program
-        glUseProgram(shader_program_t2);
-        // bind the attribute object first
-        glBindVertexArray(vertex_attribute_objects[1]);
-        
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer_objects[1]);
-        glDrawElements(GL_TRIANGLES, 1 * 3, GL_UNSIGNED_INT, 0);
+    while (frame_limit ? frame_count < frame_limit : !glfwWindowShouldClose(window)) {
+        auto frame_begin = std::chrono::steady_clock::now();
+        profiler->begin_frame();
+        // input, only what changed since the last frame
+        input_actions.dispatch(input_events, input_handler);
+        profiler->begin("shaders");
+        // pick up programs that finished compiling without waiting on the rest
+        shader_compiler.poll();
+#ifndef NDEBUG
+        // swaps in shaders we edited since the last frame, never waits on the compiler
+        if (shader_reloader.update()) {
+            // the old program is gone and a new one may get its name
+            gl_state.forget_program();
+        }
+#endif
+        // the first frame with a program blocks until it's linked
+        shader_compiler.wait(shader_program_t1);
+        shader_compiler.wait(shader_program_t2);
+        profiler->end();
+
+
+        if (texture_streamer || texture_atlas) {
+            profiler->begin("textures");
+            if (texture_streamer) {
+                for (int texture : streamed_textures) {
+                    texture_streamer->use(texture);
+                }
+                texture_streamer->update();
+            }
+            if (texture_atlas) {
+                texture_atlas->update();
+            }
+            profiler->end();
+        }
+
+        // ! FRAME GRAPH
+        // rebuilt every frame, the passes only say what they read and write and the graph binds their targets
+        int frame_width = offscreen_target.width();
+        int frame_height = offscreen_target.height();
+        if (!headless) {
+            glfwGetFramebufferSize(window, &frame_width, &frame_height);
+        }
+        int back_buffer = frame_graph->import_framebuffer("back buffer", offscreen_target.framebuffer(), frame_width, frame_height);
+        frame_graph->add_pass("scene", [&](const FrameGraph&) {
+            profiler->begin("clear");
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            profiler->end();
+
+            // draws are only recorded here, the flush merges the lists, sorts them and submits each program's run in one go
+            command_recorder.record(scene_draws.size(), [&](CommandList& list, size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    const SceneDraw& draw = scene_draws[i];
+                    list.draw(0, *draw.program, *geometry_pool, quad_mesh, draw.first_index, draw.index_count);
+                }
+            });
+            if (stress) {
+                profiler->begin("instances");
+                const StressState* previous = nullptr;
+                const StressState* current = nullptr;
+                stress_snapshots.acquire(previous, current);
+                // we show the scene one step behind the simulation's clock, so the step after it is usually there
+                double shown_step = simulation.time() / simulation.step_seconds() - 1.0;
+                float alpha = 1.0f;
+                if (current->step > previous->step) {
+                    alpha = static_cast<float>((shown_step - previous->step) / (current->step - previous->step));
+                    alpha = std::min(std::max(alpha, 0.0f), 1.0f);
+                }
+                // every instance is rewritten each frame, straight into the mapped stream buffer
+                uint32_t base_instance = 0;
+                InstanceData* instances = instance_buffer->allocate(STRESS_INSTANCES, base_instance);
+                if (instances) {
+                    stress_scene->interpolate(*previous, *current, alpha, instances);
+                }
+                shader_compiler.wait(shader_program_instanced);
+                bool culled = false;
+                if (instances && gpu_culler) {
+                    profiler->begin("cull");
+                    shader_compiler.wait(cull_program);
+                    shader_compiler.wait(cull_args_program);
+                    culled = gpu_culler->cull(*instance_buffer, base_instance, STRESS_INSTANCES, stress_frustum, QUAD_RADIUS);
+                    profiler->end();
+                    if (culled && check_cull) {
+                        cull_check_instances.resize(STRESS_INSTANCES);
+                        stress_scene->interpolate(*previous, *current, alpha, cull_check_instances.data());
+                        cull_reference = count_visible(cull_check_instances.data(), STRESS_INSTANCES, stress_frustum, QUAD_RADIUS);
+                    }
+                }
+                gl_state.use_program(shader_program_instanced);
+                if (texture_atlas && texture_atlas->bindless() && atlas_handles_program != shader_program_instanced) {
+                    texture_atlas->set_handles(uniforms_instanced.uniforms()[atlas_uniform].location,
+                                               uniforms_instanced.uniforms()[atlas_region_uniform].location);
+                    atlas_handles_program = shader_program_instanced;
+                }
+                uniforms_instanced.set(view_projection_uniform, stress_view_projection, sizeof(stress_view_projection));
+                if (texture_atlas && !texture_atlas->bindless()) {
+                    uniforms_instanced.set(atlas_uniform, static_cast<int>(ATLAS_TEXTURE_UNIT));
+                    uniforms_instanced.set(atlas_region_uniform, static_cast<int>(ATLAS_REGION_UNIT));
+                    texture_atlas->bind(ATLAS_TEXTURE_UNIT, ATLAS_REGION_UNIT);
+                }
+                uniforms_instanced.flush();
+                // one call for all of them, both triangles of the quad. after culling the gpu knows how many
+                if (culled) {
+                    gpu_culler->draw();
+                } else if (instances) {
+                    instance_buffer->draw(quad_mesh, 0, 2 * 3, STRESS_INSTANCES, base_instance);
+                }
+                instance_buffer->end_frame();
+                profiler->end();
+            }
+            profiler->begin("batches");
+            batch_renderer->flush(command_recorder.lists(), command_recorder.list_count(), [&](unsigned int program, uint32_t) {
+                if (program != shader_program_t2) {
+                    return;
+                }
+                // only uploads when the value differs from what the program already has
+                uniforms_t2.set(color_uniform_t2, color_t2);
+                uniforms_t2.flush();
+            });
+            profiler->end();
+        }).write(back_buffer, FrameGraph::kColorAttachment);
+
+        // frames are read back before the swap, the back buffer is undefined after it
+        bool output_frame = output_path && frame_count + 1 == frame_limit;
+        if (output_frame || frame_capture) {
+            frame_graph->add_pass("capture", [&](const FrameGraph&) {
+                profiler->begin("capture");
+                if (frame_capture) {
+                    frame_capture->capture(offscreen_target.framebuffer(), frame_width, frame_height);
+                }
+                if (output_frame) {
+                    output_width = frame_width;
+                    output_height = frame_height;
+                    read_framebuffer(offscreen_target.framebuffer(), output_width, output_height, output_pixels);
+                }
+                profiler->end();
+            }).read(back_buffer, FrameGraph::kTransfer).side_effect();
+        }
+        if (!frame_graph->compile()) {
+            // the passes are the same every frame, the next compile wouldn't do any better. execute() runs
+            // nothing now, it only forgets the frame
+            std::cout << "ERROR::FRAME_GRAPH::COMPILE_FAILED: frame " << frame_count << std::endl;
+            frame_graph->execute();
+            exit_code = -1;
+            break;
+        }
+        frame_graph->execute();
         /*
           // Alternative
-            glBindVertexArray(vertex_attribute_objects[0]);
+            glBindVertexArray(geometry_pool->vertex_array());
             glDrawArrays(GL_TRIANGLES, 0, 3);
         */
 
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        profiler->begin("present");
+        if (headless) {
+            headless_context.present();
+        } else {
+            // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+            // the callbacks queue them for the next frame
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+            glfw_input->poll_joysticks();
+        }
+        profiler->end();
+        profiler->end_frame();
+        ++frame_count;
+        double frame_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_begin).count();
+        if (frame_count == 1) {
+            first_frame_ms = frame_ms;
+        } else {
+            frame_ms_min = frame_count == 2 ? frame_ms : std::min(frame_ms_min, frame_ms);
+            frame_ms_max = std::max(frame_ms_max, frame_ms);
+        }
+
+        // report cold (something compiled) vs warm (everything came from the cache) startups separately
+        if (!startup_reported && shader_compiler.idle()) {
+            double shader_startup_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shader_startup_begin).count();
+            std::cout << "startup: first frame after " << shader_startup_ms << " ms ("
+                      << (program_cache.misses() == 0 ? "warm" : "cold") << " cache, "
+                      << program_cache.hits() << " hits, " << program_cache.misses() << " misses)" << std::endl;
+            startup_reported = true;
+        }
+    }
+
+    simulation.stop();
+    if (stress) {
+        std::cout << "simulation: " << simulation.steps() << " steps at " << SIMULATION_RATE << " Hz, "
+                  << simulation.step_ms_average() << " ms avg per step (" << simulation.step_ms_max() << " max), "
+                  << simulation.dropped() << " dropped" << std::endl;
+    }
+    std::cout << "gl state: " << gl_state.issued() << " calls issued, " << gl_state.skipped() << " skipped over "
+              << frame_count << " frames" << std::endl;
+    std::cout << "batches: " << batch_renderer->draw_count() << " draws in " << batch_renderer->run_count() << " runs, "
+              << batch_renderer->draw_call_count() << " draw calls per frame ("
+              << (batch_renderer->multi_draw_indirect() ? "multi draw indirect" : "fallback") << ")" << std::endl;
+    if (gpu_culler) {
+        const uint32_t visible = gpu_culler->read_visible_count();
+        std::cout << "culling: " << visible << " of " << gpu_culler->culled_count()
+                  << " instances visible in the last frame, drawn with "
+                  << (gpu_culler->draw_count() ? "multi draw indirect count" : "multi draw indirect") << std::endl;
+        if (check_cull && visible != cull_reference) {
+            std::cout << "ERROR::CULL::MISMATCH: the cpu counted " << cull_reference << " visible" << std::endl;
+        }
+    }
+    if (texture_streamer) {
+        std::cout << "textures: " << texture_streamer->texture_count() << " streamed, "
+                  << texture_streamer->resident_bytes() / (1024 * 1024) << " of " << texture_streamer->budget_bytes() / (1024 * 1024)
+                  << " MB resident, " << texture_streamer->uploaded_bytes() / (1024 * 1024) << " MB uploaded, "
+                  << texture_streamer->evictions() << " levels evicted, " << texture_streamer->pending_loads() << " loads pending"
+                  << std::endl;
+    }
+    if (headless) {
+        // present() only throttles, the last frames may still be queued
+        glFinish();
+        double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frames_begin).count();
+        double rest_ms = frame_count > 1 ? (total_ms - first_frame_ms) / (frame_count - 1) : 0.0;
+        std::cout << "headless: " << frame_count << " frames at " << SCR_WIDTH << "x" << SCR_HEIGHT << " on "
+                  << headless_context.backend_name() << " (" << glGetString(GL_RENDERER) << ") in " << total_ms << " ms, first "
+                  << first_frame_ms << " ms, then " << rest_ms << " ms avg (" << frame_ms_min << " min, " << frame_ms_max
+                  << " max)" << std::endl;
+    }
+    profiler->print_stats();
+    if (timings_path && !profiler->write(timings_path)) {
+        std::cout << "ERROR::TIMINGS::WRITE_FAILED: " << timings_path << std::endl;
+    }
+    if (frame_capture) {
+        frame_capture->finish();
+        std::cout << "capture: " << frame_capture->written() << " of " << frame_capture->captured() << " frames written to "
+                  << capture_directory << " (" << frame_capture->dropped() << " dropped, " << frame_capture->stalls()
+                  << " stalls, " << frame_capture->writer_waits() << " waits for the writer), " << frame_capture->capture_ms_average() << " ms avg per frame on the render thread ("
+                  << frame_capture->capture_ms_max() << " max)" << std::endl;
+    }
+    if (output_path) {
+        const std::string output(output_path);
+        bool png = output.size() >= 4 && output.compare(output.size() - 4, 4, ".png") == 0;
+        if (output_pixels.empty()) {
+            std::cout << "ERROR::OUTPUT::NO_FRAME: --output needs --frames" << std::endl;
+        } else if (!(png ? write_png : write_ppm)(output, output_width, output_height, output_pixels.data())) {
+            std::cout << "ERROR::OUTPUT::WRITE_FAILED: " << output_path << std::endl;
+        } else {
+            std::cout << "wrote frame " << frame_count << " to " << output_path << std::endl;
+        }
     }
 
+    // the compiler's worker contexts are glfw windows, they have to go before glfw does
+    shader_compiler.shutdown();
+    texture_streamer.reset();
+    texture_atlas.reset();
+    gpu_culler.reset();
+    // everything else that owns gl objects goes while the context is still current
+    frame_capture.reset();
+    profiler.reset();
+    frame_graph.reset();
+    instance_buffer.reset();
+    batch_renderer.reset();
+    geometry_pool.reset();
+    offscreen_target.destroy();
+    headless_context.destroy();
+    glfw_input.reset();
     // glfw: terminate, clearing all previously allocated GLFW resources.
     glfwTerminate();
-    return 0;
-}
-
-// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
-void processInput(GLFWwindow *window) {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, true);
-    if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS)
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    return exit_code;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -272,4 +776,64 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     // make sure the viewport matches the new window dimensions; note that width and 
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
+}
+
+// every .dds and .ktx2 in the directory, sorted so the order doesn't depend on the file system
+std::vector<std::string> list_textures(const char* directory) {
+    std::vector<std::string> paths;
+    std::error_code error;
+    for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory, error)) {
+        const std::string extension = entry.path().extension().string();
+        if (entry.is_regular_file() && (extension == ".dds" || extension == ".ktx2")) {
+            paths.push_back(entry.path().string());
+        }
+    }
+    if (error) {
+        std::cout << "ERROR::TEXTURE::DIRECTORY: " << directory << ": " << error.message() << std::endl;
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+// bakes an obj or gltf into <model>.mesh next to it, ready to be mapped like quad.mesh
+int import_model(const char* path) {
+    ImportedMesh model;
+    ImportStats stats;
+    std::string error;
+    if (!import_mesh(path, model, error, &stats)) {
+        std::cout << "ERROR::IMPORT::" << error << std::endl;
+        return -1;
+    }
+    std::cout << "imported " << path << ": " << model.triangle_count() << " triangles, " << stats.corners << " corners -> "
+              << model.vertex_count() << " vertices, parsed in " << stats.parse_ms << " ms on " << stats.threads
+              << " threads, built in " << stats.build_ms << " ms" << std::endl;
+
+    // positions keep full precision, a model's extent isn't known up front. the rest packs without visible loss
+    std::vector<VertexElement> elements = { { kPosition, kFloat32x3 } };
+    if (!model.normals.empty()) {
+        elements.push_back({ kNormal, kOctahedral16x2 });
+    }
+    if (!model.colors.empty()) {
+        elements.push_back({ kColor, kUnorm8x4 });
+    }
+    if (!model.texcoords.empty()) {
+        elements.push_back({ kTexCoord, kHalf16x2 });
+    }
+    VertexLayout layout(elements);
+    std::vector<unsigned char> packed_vertices(size_t(model.vertex_count()) * layout.stride());
+    layout.encode(model.streams(), model.vertex_count(), packed_vertices.data());
+
+    auto bake_start = std::chrono::steady_clock::now();
+    const std::string mesh_path = std::string(path) + ".mesh";
+    MeshOptimizeStats mesh_stats;
+    if (!write_mesh_file(mesh_path, layout, packed_vertices.data(), model.vertex_count(), model.indices.data(),
+                         static_cast<uint32_t>(model.indices.size()), model.submesh_starts,
+                         index_type_for(model.vertex_count()), error, &mesh_stats)) {
+        std::cout << "ERROR::MESH::" << error << std::endl;
+        return -1;
+    }
+    double bake_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bake_start).count();
+    std::cout << "baked " << mesh_path << " in " << bake_ms << " ms: ACMR " << mesh_stats.before.acmr() << " -> "
+              << mesh_stats.after.acmr() << ", ATVR " << mesh_stats.before.atvr() << " -> " << mesh_stats.after.atvr() << std::endl;
+    return 0;
 }
\ No newline at end of file
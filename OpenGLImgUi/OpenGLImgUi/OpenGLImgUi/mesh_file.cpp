@@ -0,0 +1,245 @@
+#include "mesh_file.h"
+#include "hash.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <system_error>
+
+namespace {
+    uint64_t align_up(uint64_t offset) {
+        return (offset + kMeshFileAlignment - 1) / kMeshFileAlignment * kMeshFileAlignment;
+    }
+
+    bool valid_index_type(uint32_t index_type) {
+        return index_type == GL_UNSIGNED_BYTE || index_type == GL_UNSIGNED_SHORT || index_type == GL_UNSIGNED_INT;
+    }
+
+    // a section of bytes at offset, aligned and inside the file
+    bool valid_section(uint64_t offset, uint64_t bytes, size_t file_size) {
+        return offset % kMeshFileAlignment == 0 && offset <= file_size && bytes <= file_size - offset;
+    }
+
+    void reset_bounds(float bounds_min[3], float bounds_max[3]) {
+        std::fill(bounds_min, bounds_min + 3, std::numeric_limits<float>::max());
+        std::fill(bounds_max, bounds_max + 3, -std::numeric_limits<float>::max());
+    }
+
+    void extend_bounds(float bounds_min[3], float bounds_max[3], const float* position) {
+        for (int i = 0; i < 3; ++i) {
+            bounds_min[i] = std::min(bounds_min[i], position[i]);
+            bounds_max[i] = std::max(bounds_max[i], position[i]);
+        }
+    }
+}
+
+uint64_t mesh_source_hash(const VertexLayout& layout, const void* vertices, uint32_t vertex_count, const uint32_t* indices,
+                          uint32_t index_count, const std::vector<uint32_t>& submesh_starts) {
+    uint64_t hash = kHashSeed;
+    for (const VertexElement& element : layout.elements()) {
+        MeshFileElement stored = { static_cast<uint32_t>(element.semantic), static_cast<uint32_t>(element.format), element.range, 0 };
+        hash = hash_bytes(&stored, sizeof(stored), hash);
+    }
+    hash = hash_bytes(&vertex_count, sizeof(vertex_count), hash);
+    hash = hash_bytes(vertices, size_t(vertex_count) * layout.stride(), hash);
+    hash = hash_bytes(&index_count, sizeof(index_count), hash);
+    hash = hash_bytes(indices, size_t(index_count) * sizeof(uint32_t), hash);
+    return hash_bytes(submesh_starts.data(), submesh_starts.size() * sizeof(uint32_t), hash);
+}
+
+bool write_mesh_file(const std::string& path, const VertexLayout& layout, const void* vertices, uint32_t vertex_count,
+                     const uint32_t* indices, uint32_t index_count, const std::vector<uint32_t>& submesh_starts,
+                     GLenum index_type, std::string& error, MeshOptimizeStats* stats) {
+    if (vertex_count == 0 || index_count == 0) {
+        error = path + ": empty mesh";
+        return false;
+    }
+    if (!valid_index_type(index_type)) {
+        error = path + ": unsupported index type";
+        return false;
+    }
+    for (uint32_t i = 0; i < index_count; ++i) {
+        if (indices[i] >= vertex_count) {
+            error = path + ": index " + std::to_string(indices[i]) + " out of range";
+            return false;
+        }
+    }
+    for (size_t s = 0; s < submesh_starts.size(); ++s) {
+        if (submesh_starts[s] > index_count || (s > 0 && submesh_starts[s] < submesh_starts[s - 1])) {
+            error = path + ": submesh starts out of order or out of range";
+            return false;
+        }
+    }
+
+    const uint32_t stride = layout.stride();
+    const unsigned char* vertex_bytes = static_cast<const unsigned char*>(vertices);
+    std::vector<unsigned char> baked_vertices(vertex_bytes, vertex_bytes + size_t(vertex_count) * stride);
+    std::vector<uint32_t> baked_indices(indices, indices + index_count);
+    std::vector<float> positions;
+    if (layout.has(kPosition)) {
+        positions.resize(size_t(vertex_count) * 3);
+        for (uint32_t v = 0; v < vertex_count; ++v) {
+            float position[4];
+            layout.decode(vertex_bytes + size_t(v) * stride, kPosition, position);
+            std::copy(position, position + 3, positions.begin() + size_t(v) * 3);
+        }
+    }
+    MeshOptimizeStats optimize_stats = optimize_mesh(baked_vertices, stride, baked_indices, submesh_starts,
+                                                     positions.empty() ? nullptr : positions.data());
+    if (stats) {
+        *stats = optimize_stats;
+    }
+    const uint32_t baked_vertex_count = static_cast<uint32_t>(baked_vertices.size() / stride);
+    const size_t index_size = index_type_size(index_type);
+    if (index_type_size(index_type_for(baked_vertex_count)) > index_size) {
+        error = path + ": " + std::to_string(baked_vertex_count) + " vertices don't fit the index type";
+        return false;
+    }
+
+    // the optimizer keeps triangles within their submesh, so the ranges are the same as before
+    std::vector<MeshFileSubmesh> submeshes;
+    std::vector<uint32_t> starts(1, 0);
+    starts.insert(starts.end(), submesh_starts.begin(), submesh_starts.end());
+    for (size_t s = 0; s < starts.size(); ++s) {
+        uint32_t end = s + 1 < starts.size() ? starts[s + 1] : index_count;
+        MeshFileSubmesh submesh = { starts[s], end - starts[s], {}, {} };
+        reset_bounds(submesh.bounds_min, submesh.bounds_max);
+        submeshes.push_back(submesh);
+    }
+
+    MeshFileHeader header = {};
+    header.magic = kMeshFileMagic;
+    header.version = kMeshFileVersion;
+    header.vertex_stride = stride;
+    header.vertex_count = baked_vertex_count;
+    header.index_type = index_type;
+    header.index_count = index_count;
+    header.element_count = static_cast<uint32_t>(layout.elements().size());
+    header.submesh_count = static_cast<uint32_t>(submeshes.size());
+    header.elements_offset = align_up(sizeof(MeshFileHeader));
+    header.submeshes_offset = align_up(header.elements_offset + sizeof(MeshFileElement) * header.element_count);
+    header.vertices_offset = align_up(header.submeshes_offset + sizeof(MeshFileSubmesh) * header.submesh_count);
+    header.indices_offset = align_up(header.vertices_offset + baked_vertices.size());
+    header.source_hash = mesh_source_hash(layout, vertices, vertex_count, indices, index_count, submesh_starts);
+    reset_bounds(header.bounds_min, header.bounds_max);
+
+    // bounds of what the gpu will see, i.e. after quantization
+    if (layout.has(kPosition)) {
+        for (MeshFileSubmesh& submesh : submeshes) {
+            for (uint32_t i = submesh.first_index; i < submesh.first_index + submesh.index_count; ++i) {
+                float position[4];
+                layout.decode(baked_vertices.data() + size_t(baked_indices[i]) * stride, kPosition, position);
+                extend_bounds(submesh.bounds_min, submesh.bounds_max, position);
+                extend_bounds(header.bounds_min, header.bounds_max, position);
+            }
+        }
+    }
+
+    std::vector<unsigned char> file_bytes(header.indices_offset + size_t(index_count) * index_size);
+    std::memcpy(file_bytes.data(), &header, sizeof(header));
+    for (uint32_t e = 0; e < header.element_count; ++e) {
+        const VertexElement& element = layout.elements()[e];
+        MeshFileElement stored = { static_cast<uint32_t>(element.semantic), static_cast<uint32_t>(element.format), element.range, 0 };
+        std::memcpy(file_bytes.data() + header.elements_offset + e * sizeof(MeshFileElement), &stored, sizeof(stored));
+    }
+    std::memcpy(file_bytes.data() + header.submeshes_offset, submeshes.data(), submeshes.size() * sizeof(MeshFileSubmesh));
+    std::memcpy(file_bytes.data() + header.vertices_offset, baked_vertices.data(), baked_vertices.size());
+    narrow_indices(file_bytes.data() + header.indices_offset, baked_indices.data(), index_count, index_type);
+
+    // write to a temporary file first so a crash mid write never leaves a truncated mesh behind
+    const std::string temp_path = path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(file_bytes.data()), file_bytes.size());
+        if (!file) {
+            error = temp_path + ": write failed";
+            return false;
+        }
+    }
+    std::error_code rename_error;
+    std::filesystem::rename(temp_path, path, rename_error);
+    if (rename_error) {
+        error = path + ": " + rename_error.message();
+        return false;
+    }
+    return true;
+}
+
+bool MeshFile::open(const std::string& path, std::string& error) {
+    close();
+    if (!file_.open(path, error)) {
+        return false;
+    }
+    const size_t size = file_.size();
+    const MeshFileHeader* header = static_cast<const MeshFileHeader*>(file_.data());
+    if (size < sizeof(MeshFileHeader) || header->magic != kMeshFileMagic) {
+        error = path + ": not a mesh file";
+        close();
+        return false;
+    }
+    if (header->version != kMeshFileVersion) {
+        error = path + ": version " + std::to_string(header->version) + ", expected " + std::to_string(kMeshFileVersion);
+        close();
+        return false;
+    }
+    const uint64_t index_bytes = valid_index_type(header->index_type) ? index_type_size(header->index_type) : 0;
+    if (index_bytes == 0 || header->element_count == 0 || header->element_count > kSemanticCount ||
+        !valid_section(header->elements_offset, uint64_t(header->element_count) * sizeof(MeshFileElement), size) ||
+        !valid_section(header->submeshes_offset, uint64_t(header->submesh_count) * sizeof(MeshFileSubmesh), size) ||
+        !valid_section(header->vertices_offset, uint64_t(header->vertex_count) * header->vertex_stride, size) ||
+        !valid_section(header->indices_offset, uint64_t(header->index_count) * index_bytes, size)) {
+        error = path + ": corrupt header";
+        close();
+        return false;
+    }
+
+    std::vector<VertexElement> elements;
+    const MeshFileElement* stored = reinterpret_cast<const MeshFileElement*>(at(header->elements_offset));
+    for (uint32_t e = 0; e < header->element_count; ++e) {
+        if (stored[e].semantic >= kSemanticCount || stored[e].format > kOctahedral16x2) {
+            error = path + ": unknown vertex element";
+            close();
+            return false;
+        }
+        elements.push_back({ static_cast<VertexSemantic>(stored[e].semantic), static_cast<VertexFormat>(stored[e].format), stored[e].range });
+    }
+    VertexLayout layout(elements);
+    if (layout.stride() != header->vertex_stride) {
+        error = path + ": vertex stride doesn't match the layout";
+        close();
+        return false;
+    }
+    const MeshFileSubmesh* submesh = reinterpret_cast<const MeshFileSubmesh*>(at(header->submeshes_offset));
+    for (uint32_t s = 0; s < header->submesh_count; ++s) {
+        if (submesh[s].first_index > header->index_count || submesh[s].index_count > header->index_count - submesh[s].first_index) {
+            error = path + ": submesh out of range";
+            close();
+            return false;
+        }
+    }
+    // the indices themselves aren't checked against vertex_count, that would mean touching every one of them
+    // and the writer already did
+
+    header_ = header;
+    layout_ = layout;
+    return true;
+}
+
+void MeshFile::close() {
+    file_.close();
+    header_ = nullptr;
+    layout_ = VertexLayout(std::vector<VertexElement>());
+}
+
+const void* MeshFile::vertices() const {
+    return at(header_->vertices_offset);
+}
+
+const void* MeshFile::indices() const {
+    return at(header_->indices_offset);
+}
+
+const MeshFileSubmesh* MeshFile::submeshes() const {
+    return reinterpret_cast<const MeshFileSubmesh*>(at(header_->submeshes_offset));
+}
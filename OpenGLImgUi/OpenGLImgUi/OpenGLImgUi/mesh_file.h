@@ -0,0 +1,88 @@
+#pragma once
+#include "asset_registry.h"
+#include "mesh_optimizer.h"
+#include "vertex_layout.h"
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// a baked mesh as one file that is mapped and used in place: the header, then the vertex layout, the submesh
+// table and the vertex and index blobs, each starting on a kMeshFileAlignment boundary
+// the blobs are already optimized and in the gpu format, so loading is a header check and two glBufferSubData
+// straight out of the mapping. native byte order, a file baked on another endianness fails the magic check
+const uint32_t kMeshFileMagic = 0x4853454d; // "MESH"
+const uint32_t kMeshFileVersion = 1;
+const uint32_t kMeshFileAlignment = 64;
+
+struct MeshFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertex_stride;
+    uint32_t vertex_count;
+    uint32_t index_type;        // GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    uint32_t index_count;
+    uint32_t element_count;
+    uint32_t submesh_count;
+    // byte offsets from the start of the file
+    uint64_t elements_offset;
+    uint64_t submeshes_offset;
+    uint64_t vertices_offset;
+    uint64_t indices_offset;
+    // of what the file was baked from, tells whether it is stale (see mesh_source_hash)
+    uint64_t source_hash;
+    float bounds_min[3];
+    float bounds_max[3];
+};
+
+struct MeshFileElement {
+    uint32_t semantic;
+    uint32_t format;
+    float range;
+    uint32_t reserved;
+};
+
+struct MeshFileSubmesh {
+    uint32_t first_index;
+    uint32_t index_count;
+    float bounds_min[3];
+    float bounds_max[3];
+};
+
+// hash of the unbaked input, vertices as encoded with the layout
+uint64_t mesh_source_hash(const VertexLayout& layout, const void* vertices, uint32_t vertex_count, const uint32_t* indices,
+                          uint32_t index_count, const std::vector<uint32_t>& submesh_starts);
+
+// optimizes the mesh (see optimize_mesh), narrows the indices to index_type and writes it to path
+// submesh_starts holds the first index of every submesh after the first one
+// returns false and fills error if the mesh is invalid or the file can't be written
+bool write_mesh_file(const std::string& path, const VertexLayout& layout, const void* vertices, uint32_t vertex_count,
+                     const uint32_t* indices, uint32_t index_count, const std::vector<uint32_t>& submesh_starts,
+                     GLenum index_type, std::string& error, MeshOptimizeStats* stats = nullptr);
+
+// a mapped mesh file, the pointers stay valid until it is closed or destroyed
+class MeshFile {
+public:
+    // only the header and tables are checked, nothing is parsed or copied
+    bool open(const std::string& path, std::string& error);
+    void close();
+
+    const MeshFileHeader& header() const { return *header_; }
+    const VertexLayout& layout() const { return layout_; }
+    const void* vertices() const;
+    uint32_t vertex_count() const { return header_->vertex_count; }
+    const void* indices() const;
+    GLenum index_type() const { return header_->index_type; }
+    uint32_t index_count() const { return header_->index_count; }
+    const MeshFileSubmesh* submeshes() const;
+    uint32_t submesh_count() const { return header_->submesh_count; }
+    size_t size() const { return file_.size(); }
+
+private:
+    const unsigned char* at(uint64_t offset) const { return static_cast<const unsigned char*>(file_.data()) + offset; }
+
+    MappedFile file_;
+    const MeshFileHeader* header_ = nullptr;
+    VertexLayout layout_{ std::vector<VertexElement>() };
+};
@@ -0,0 +1,992 @@
+#include "mesh_importer.h"
+#include "asset_registry.h"
+#include "json.h"
+#include "number_parser.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <thread>
+
+namespace {
+    double elapsed_ms(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // grows a stream to vertex_count entries, filling what is new
+    void pad_stream(std::vector<float>& stream, size_t components, size_t vertex_count, float fill) {
+        if (stream.size() < vertex_count * components) {
+            stream.resize(vertex_count * components, fill);
+        }
+    }
+
+    // ! OBJ
+
+    // set on corner indices that were negative in the file. the other 31 bits are a signed index into the chunk's
+    // attributes (negative when it reaches back into an earlier chunk), absolute once the merge knows what came before
+    const uint32_t kChunkRelative = 0x80000000;
+    // indices either way stay within +-2^30, which leaves a value for corners without texcoord or normal
+    const int64_t kMaxIndex = 0x3FFFFFFF;
+    const uint32_t kNoIndex = 0x7FFFFFFF;
+    // below this a chunk isn't worth a thread
+    const size_t kMinChunkBytes = 256 * 1024;
+
+    struct ObjCorner {
+        uint32_t position;
+        uint32_t texcoord;
+        uint32_t normal;
+    };
+
+    // one thread's share of the file and what it read from it
+    struct ObjChunk {
+        const char* begin = nullptr;
+        const char* end = nullptr;
+        std::vector<float> positions;   // 3 per v
+        std::vector<float> colors;      // 4 per v, empty until the chunk sees the first colored v
+        std::vector<float> normals;     // 3 per vn
+        std::vector<float> texcoords;   // 2 per vt
+        std::vector<ObjCorner> corners; // 3 per triangle
+        std::vector<uint32_t> group_starts; // corner counts at which a group or material started
+        const char* error_at = nullptr;
+        std::string error;
+    };
+
+    bool is_space(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    const char* skip_spaces(const char* p, const char* end) {
+        while (p < end && is_space(*p)) {
+            ++p;
+        }
+        return p;
+    }
+
+    // keyword at p followed by whitespace or the end of the line
+    bool is_keyword(const char* p, const char* line_end, const char* keyword) {
+        size_t length = std::strlen(keyword);
+        return size_t(line_end - p) >= length && std::memcmp(p, keyword, length) == 0 &&
+               (p + length == line_end || is_space(p[length]));
+    }
+
+    // up to max_count floats separated by whitespace, returns how many were read
+    int parse_floats(const char* p, const char* line_end, float* values, int max_count) {
+        int count = 0;
+        while (count < max_count) {
+            p = skip_spaces(p, line_end);
+            if (!parse_float(p, line_end, values[count])) {
+                break;
+            }
+            ++count;
+        }
+        return count;
+    }
+
+    // obj indices are 1 based from the start or negative from the last one read so far
+    bool obj_index(int64_t written, size_t count_so_far, uint32_t& index) {
+        if (written > 0 && written <= kMaxIndex) {
+            index = static_cast<uint32_t>(written - 1);
+            return true;
+        }
+        if (written < 0 && written >= -kMaxIndex && count_so_far <= size_t(kMaxIndex)) {
+            index = (static_cast<uint32_t>(int64_t(count_so_far) + written) & ~kChunkRelative) | kChunkRelative;
+            return true;
+        }
+        return false;
+    }
+
+    bool parse_face(ObjChunk& chunk, const char* p, const char* line_end, std::vector<ObjCorner>& face) {
+        face.clear();
+        while (true) {
+            p = skip_spaces(p, line_end);
+            if (p == line_end) {
+                break;
+            }
+            ObjCorner corner = { kNoIndex, kNoIndex, kNoIndex };
+            int64_t written;
+            if (!parse_int(p, line_end, written) || !obj_index(written, chunk.positions.size() / 3, corner.position)) {
+                chunk.error = "invalid face position index";
+                return false;
+            }
+            if (p < line_end && *p == '/') {
+                ++p;
+                if (p < line_end && *p != '/') {
+                    if (!parse_int(p, line_end, written) || !obj_index(written, chunk.texcoords.size() / 2, corner.texcoord)) {
+                        chunk.error = "invalid face texcoord index";
+                        return false;
+                    }
+                }
+                if (p < line_end && *p == '/') {
+                    ++p;
+                    if (!parse_int(p, line_end, written) || !obj_index(written, chunk.normals.size() / 3, corner.normal)) {
+                        chunk.error = "invalid face normal index";
+                        return false;
+                    }
+                }
+            }
+            face.push_back(corner);
+        }
+        if (face.size() < 3) {
+            chunk.error = "face with less than 3 corners";
+            return false;
+        }
+        for (size_t i = 1; i + 1 < face.size(); ++i) {
+            chunk.corners.push_back(face[0]);
+            chunk.corners.push_back(face[i]);
+            chunk.corners.push_back(face[i + 1]);
+        }
+        return true;
+    }
+
+    bool parse_obj_line(ObjChunk& chunk, const char* p, const char* line_end, std::vector<ObjCorner>& face) {
+        if (is_keyword(p, line_end, "v")) {
+            float values[6];
+            int count = parse_floats(p + 1, line_end, values, 6);
+            if (count < 3) {
+                chunk.error = "vertex with less than 3 coordinates";
+                return false;
+            }
+            size_t previous = chunk.positions.size() / 3;
+            chunk.positions.insert(chunk.positions.end(), values, values + 3);
+            if (count == 6 && chunk.colors.empty()) {
+                pad_stream(chunk.colors, 4, previous, 1.0f);
+            }
+            if (count == 6) {
+                chunk.colors.insert(chunk.colors.end(), values + 3, values + 6);
+                chunk.colors.push_back(1.0f);
+            } else if (!chunk.colors.empty()) {
+                pad_stream(chunk.colors, 4, previous + 1, 1.0f);
+            }
+        } else if (is_keyword(p, line_end, "vn")) {
+            float values[3];
+            if (parse_floats(p + 2, line_end, values, 3) < 3) {
+                chunk.error = "normal with less than 3 coordinates";
+                return false;
+            }
+            chunk.normals.insert(chunk.normals.end(), values, values + 3);
+        } else if (is_keyword(p, line_end, "vt")) {
+            float values[2] = { 0.0f, 0.0f };
+            if (parse_floats(p + 2, line_end, values, 2) < 1) {
+                chunk.error = "texcoord without coordinates";
+                return false;
+            }
+            chunk.texcoords.insert(chunk.texcoords.end(), values, values + 2);
+        } else if (is_keyword(p, line_end, "f")) {
+            return parse_face(chunk, p + 1, line_end, face);
+        } else if (is_keyword(p, line_end, "o") || is_keyword(p, line_end, "g") || is_keyword(p, line_end, "usemtl")) {
+            uint32_t start = static_cast<uint32_t>(chunk.corners.size());
+            if (chunk.group_starts.empty() || chunk.group_starts.back() != start) {
+                chunk.group_starts.push_back(start);
+            }
+        }
+        // everything else (comments, s, mtllib, lines, points, ...) has nothing for a triangle mesh
+        return true;
+    }
+
+    void parse_obj_chunk(ObjChunk& chunk) {
+        std::vector<ObjCorner> face;
+        const char* p = chunk.begin;
+        while (p < chunk.end) {
+            const char* line_end = static_cast<const char*>(std::memchr(p, '\n', chunk.end - p));
+            if (line_end == nullptr) {
+                line_end = chunk.end;
+            }
+            if (!parse_obj_line(chunk, skip_spaces(p, line_end), line_end, face)) {
+                chunk.error_at = p;
+                return;
+            }
+            p = line_end + 1;
+        }
+    }
+
+    // open addressing map from a corner's (position, texcoord, normal) to the vertex made for it
+    class CornerTable {
+    public:
+        explicit CornerTable(size_t expected) {
+            size_t capacity = 1024;
+            while (capacity < expected * 2) {
+                capacity *= 2;
+            }
+            slots_.assign(capacity, Slot{ 0, 0, 0, kEmpty });
+        }
+
+        // the vertex for corner, next_vertex if it's new (inserted is set then)
+        uint32_t find_or_insert(const ObjCorner& corner, uint32_t next_vertex, bool& inserted) {
+            if ((size_ + 1) * 2 > slots_.size()) {
+                grow();
+            }
+            size_t mask = slots_.size() - 1;
+            for (size_t i = hash(corner) & mask;; i = (i + 1) & mask) {
+                Slot& slot = slots_[i];
+                if (slot.vertex == kEmpty) {
+                    slot = { corner.position, corner.texcoord, corner.normal, next_vertex };
+                    ++size_;
+                    inserted = true;
+                    return next_vertex;
+                }
+                if (slot.position == corner.position && slot.texcoord == corner.texcoord && slot.normal == corner.normal) {
+                    inserted = false;
+                    return slot.vertex;
+                }
+            }
+        }
+
+    private:
+        static const uint32_t kEmpty = 0xFFFFFFFF;
+
+        struct Slot {
+            uint32_t position;
+            uint32_t texcoord;
+            uint32_t normal;
+            uint32_t vertex;
+        };
+
+        static size_t hash(const ObjCorner& corner) {
+            uint64_t h = corner.position * 0x9E3779B97F4A7C15ull;
+            h ^= (h >> 29) ^ corner.texcoord * 0xBF58476D1CE4E5B9ull;
+            h ^= (h >> 31) ^ corner.normal * 0x94D049BB133111EBull;
+            return static_cast<size_t>(h ^ (h >> 32));
+        }
+
+        void grow() {
+            std::vector<Slot> old(slots_.size() * 2, Slot{ 0, 0, 0, kEmpty });
+            old.swap(slots_);
+            size_t mask = slots_.size() - 1;
+            for (const Slot& slot : old) {
+                if (slot.vertex == kEmpty) {
+                    continue;
+                }
+                size_t i = hash({ slot.position, slot.texcoord, slot.normal }) & mask;
+                while (slots_[i].vertex != kEmpty) {
+                    i = (i + 1) & mask;
+                }
+                slots_[i] = slot;
+            }
+        }
+
+        std::vector<Slot> slots_;
+        size_t size_ = 0;
+    };
+
+    // a chunk relative index made absolute, false if it points past what the file has
+    bool resolve_corner_index(uint32_t& index, size_t chunk_base, size_t total) {
+        if (index == kNoIndex) {
+            return true;
+        }
+        int64_t absolute = index;
+        if (index & kChunkRelative) {
+            // sign extend the 31 bit chunk index
+            absolute = int64_t(chunk_base) + (static_cast<int32_t>(index << 1) >> 1);
+        }
+        if (absolute < 0 || uint64_t(absolute) >= total) {
+            return false;
+        }
+        index = static_cast<uint32_t>(absolute);
+        return true;
+    }
+
+    // ! GLTF
+
+    const uint32_t kGlbMagic = 0x46546C67;      // "glTF"
+    const uint32_t kGlbJsonChunk = 0x4E4F534A;  // "JSON"
+    const uint32_t kGlbBinChunk = 0x004E4942;   // "BIN\0"
+    const int kMaxNodeDepth = 1024;
+
+    enum GltfComponentType {
+        kGltfByte = 5120,
+        kGltfUnsignedByte = 5121,
+        kGltfShort = 5122,
+        kGltfUnsignedShort = 5123,
+        kGltfUnsignedInt = 5125,
+        kGltfFloat = 5126,
+    };
+    const long long kGltfTriangles = 4;
+
+    // column major like gl
+    typedef std::array<float, 16> Matrix4;
+    const Matrix4 kIdentity = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+    struct GltfBuffer {
+        const unsigned char* data;
+        size_t size;
+    };
+
+    struct GltfFile {
+        JsonValue json;
+        std::vector<GltfBuffer> buffers;
+        // what the buffers point into besides the file itself
+        std::vector<MappedFile> external;
+        std::vector<std::vector<unsigned char>> decoded;
+    };
+
+    // a typed view of an accessor's elements, data is null for accessors without a buffer view (all zeros)
+    struct GltfAccessor {
+        const unsigned char* data = nullptr;
+        size_t count = 0;
+        size_t stride = 0;
+        int components = 0;
+        long long component_type = 0;
+        bool normalized = false;
+    };
+
+    Matrix4 multiply(const Matrix4& a, const Matrix4& b) {
+        Matrix4 result;
+        for (int c = 0; c < 4; ++c) {
+            for (int r = 0; r < 4; ++r) {
+                float sum = 0.0f;
+                for (int k = 0; k < 4; ++k) {
+                    sum += a[k * 4 + r] * b[c * 4 + k];
+                }
+                result[c * 4 + r] = sum;
+            }
+        }
+        return result;
+    }
+
+    float json_float(const JsonValue& array, size_t index, float fallback) {
+        return static_cast<float>(array[index].number(fallback));
+    }
+
+    // a node's matrix, or translation * rotation * scale
+    Matrix4 node_matrix(const JsonValue& node) {
+        const JsonValue& matrix = node["matrix"];
+        Matrix4 result = kIdentity;
+        if (matrix.size() == 16) {
+            for (size_t i = 0; i < 16; ++i) {
+                result[i] = json_float(matrix, i, kIdentity[i]);
+            }
+            return result;
+        }
+        const JsonValue& t = node["translation"];
+        const JsonValue& r = node["rotation"];
+        const JsonValue& s = node["scale"];
+        float x = json_float(r, 0, 0.0f), y = json_float(r, 1, 0.0f), z = json_float(r, 2, 0.0f), w = json_float(r, 3, 1.0f);
+        const float rotation[3][3] = {
+            { 1 - 2 * (y * y + z * z), 2 * (x * y - z * w), 2 * (x * z + y * w) },
+            { 2 * (x * y + z * w), 1 - 2 * (x * x + z * z), 2 * (y * z - x * w) },
+            { 2 * (x * z - y * w), 2 * (y * z + x * w), 1 - 2 * (x * x + y * y) },
+        };
+        for (int c = 0; c < 3; ++c) {
+            float scale = json_float(s, c, 1.0f);
+            for (int row = 0; row < 3; ++row) {
+                result[c * 4 + row] = rotation[row][c] * scale;
+            }
+            result[12 + c] = json_float(t, c, 0.0f);
+        }
+        return result;
+    }
+
+    // inverse transpose of the upper 3x3 for normals, from the cofactors. determinant is returned too, a
+    // negative one mirrors the geometry and the triangle winding has to flip with it
+    void normal_matrix(const Matrix4& m, float normal[3][3], float& determinant) {
+        auto a = [&m](int row, int column) { return m[column * 4 + row]; };
+        float cofactor[3][3] = {
+            { a(1, 1) * a(2, 2) - a(1, 2) * a(2, 1), a(1, 2) * a(2, 0) - a(1, 0) * a(2, 2), a(1, 0) * a(2, 1) - a(1, 1) * a(2, 0) },
+            { a(0, 2) * a(2, 1) - a(0, 1) * a(2, 2), a(0, 0) * a(2, 2) - a(0, 2) * a(2, 0), a(0, 1) * a(2, 0) - a(0, 0) * a(2, 1) },
+            { a(0, 1) * a(1, 2) - a(0, 2) * a(1, 1), a(0, 2) * a(1, 0) - a(0, 0) * a(1, 2), a(0, 0) * a(1, 1) - a(0, 1) * a(1, 0) },
+        };
+        determinant = a(0, 0) * cofactor[0][0] + a(0, 1) * cofactor[0][1] + a(0, 2) * cofactor[0][2];
+        // only the direction matters, so dividing by the determinant comes down to its sign
+        float sign = determinant < 0.0f ? -1.0f : 1.0f;
+        for (int row = 0; row < 3; ++row) {
+            for (int column = 0; column < 3; ++column) {
+                normal[row][column] = cofactor[row][column] * sign;
+            }
+        }
+    }
+
+    bool decode_base64(std::string_view text, std::vector<unsigned char>& out) {
+        out.clear();
+        out.reserve(text.size() / 4 * 3);
+        uint32_t bits = 0;
+        int bit_count = 0;
+        for (char c : text) {
+            int value;
+            if (c >= 'A' && c <= 'Z') {
+                value = c - 'A';
+            } else if (c >= 'a' && c <= 'z') {
+                value = c - 'a' + 26;
+            } else if (c >= '0' && c <= '9') {
+                value = c - '0' + 52;
+            } else if (c == '+' || c == '-') {
+                value = 62;
+            } else if (c == '/' || c == '_') {
+                value = 63;
+            } else if (c == '=') {
+                break;
+            } else {
+                return false;
+            }
+            bits = (bits << 6) | static_cast<uint32_t>(value);
+            bit_count += 6;
+            if (bit_count >= 8) {
+                bit_count -= 8;
+                out.push_back(static_cast<unsigned char>(bits >> bit_count));
+            }
+        }
+        return true;
+    }
+
+    int hex_value(char c) {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        c = static_cast<char>(c | 0x20);
+        return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+    }
+
+    // a % that isn't followed by two hex digits stays as it is
+    std::string decode_uri(const std::string& uri) {
+        std::string out;
+        for (size_t i = 0; i < uri.size(); ++i) {
+            const int high = uri[i] == '%' && i + 2 < uri.size() ? hex_value(uri[i + 1]) : -1;
+            const int low = high >= 0 ? hex_value(uri[i + 2]) : -1;
+            if (low >= 0) {
+                out += static_cast<char>(high * 16 + low);
+                i += 2;
+            } else {
+                out += uri[i];
+            }
+        }
+        return out;
+    }
+
+    bool load_gltf_buffers(GltfFile& file, const std::filesystem::path& directory, const unsigned char* glb_bin,
+                           size_t glb_bin_size, std::string& error) {
+        const JsonValue& buffers = file.json["buffers"];
+        // reserved up front, the buffers point into these
+        file.external.reserve(buffers.size());
+        file.decoded.reserve(buffers.size());
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            const JsonValue& buffer = buffers[i];
+            long long byte_length = buffer["byteLength"].integer();
+            if (byte_length < 0) {
+                error = "buffer " + std::to_string(i) + " has no byteLength";
+                return false;
+            }
+            GltfBuffer loaded = { nullptr, 0 };
+            if (!buffer.has("uri")) {
+                // the glb's binary chunk
+                loaded = { glb_bin, glb_bin_size };
+            } else if (buffer["uri"].string().compare(0, 5, "data:") == 0) {
+                const std::string& uri = buffer["uri"].string();
+                size_t comma = uri.find(',');
+                std::vector<unsigned char> bytes;
+                if (comma == std::string::npos || comma < 7 || uri.compare(comma - 7, 7, ";base64") != 0 ||
+                    !decode_base64(std::string_view(uri).substr(comma + 1), bytes)) {
+                    error = "buffer " + std::to_string(i) + " has an unsupported data uri";
+                    return false;
+                }
+                file.decoded.push_back(std::move(bytes));
+                loaded = { file.decoded.back().data(), file.decoded.back().size() };
+            } else {
+                MappedFile mapped;
+                std::string map_error;
+                if (!mapped.open((directory / decode_uri(buffer["uri"].string())).string(), map_error)) {
+                    error = map_error;
+                    return false;
+                }
+                file.external.push_back(std::move(mapped));
+                loaded = { static_cast<const unsigned char*>(file.external.back().data()), file.external.back().size() };
+            }
+            if (loaded.size < uint64_t(byte_length)) {
+                error = "buffer " + std::to_string(i) + " is shorter than its byteLength";
+                return false;
+            }
+            file.buffers.push_back(loaded);
+        }
+        return true;
+    }
+
+    size_t component_size(long long component_type) {
+        switch (component_type) {
+            case kGltfByte:
+            case kGltfUnsignedByte: return 1;
+            case kGltfShort:
+            case kGltfUnsignedShort: return 2;
+            case kGltfUnsignedInt:
+            case kGltfFloat: return 4;
+        }
+        return 0;
+    }
+
+    int type_components(const std::string& type) {
+        if (type == "SCALAR") {
+            return 1;
+        }
+        if (type == "VEC2") {
+            return 2;
+        }
+        if (type == "VEC3") {
+            return 3;
+        }
+        return type == "VEC4" ? 4 : 0;
+    }
+
+    bool get_accessor(const GltfFile& file, long long index, GltfAccessor& accessor, std::string& error) {
+        const JsonValue& json = file.json["accessors"][static_cast<size_t>(index)];
+        accessor.count = static_cast<size_t>(std::max(0ll, json["count"].integer(0)));
+        accessor.components = type_components(json["type"].string());
+        accessor.component_type = json["componentType"].integer(0);
+        accessor.normalized = json["normalized"].boolean();
+        size_t element_size = component_size(accessor.component_type) * accessor.components;
+        if (!json.is_object() || element_size == 0) {
+            error = "accessor " + std::to_string(index) + " is missing or has an unknown type";
+            return false;
+        }
+        if (json.has("sparse")) {
+            error = "accessor " + std::to_string(index) + " is sparse, which isn't supported";
+            return false;
+        }
+        if (!json.has("bufferView") || accessor.count == 0) {
+            return true;
+        }
+        const JsonValue& view = file.json["bufferViews"][static_cast<size_t>(json["bufferView"].integer())];
+        long long buffer = view["buffer"].integer();
+        uint64_t view_offset = static_cast<uint64_t>(std::max(0ll, view["byteOffset"].integer(0)));
+        uint64_t view_length = static_cast<uint64_t>(std::max(0ll, view["byteLength"].integer(0)));
+        uint64_t offset = static_cast<uint64_t>(std::max(0ll, json["byteOffset"].integer(0)));
+        accessor.stride = static_cast<size_t>(view["byteStride"].integer(static_cast<long long>(element_size)));
+        if (!view.is_object() || buffer < 0 || size_t(buffer) >= file.buffers.size() ||
+            view_offset + view_length > file.buffers[size_t(buffer)].size ||
+            offset + accessor.stride * (accessor.count - 1) + element_size > view_length) {
+            error = "accessor " + std::to_string(index) + " reaches outside its buffer";
+            return false;
+        }
+        accessor.data = file.buffers[size_t(buffer)].data + view_offset + offset;
+        return true;
+    }
+
+    float read_component(const unsigned char* p, long long component_type, bool normalized) {
+        switch (component_type) {
+            case kGltfByte: {
+                int8_t v = static_cast<int8_t>(*p);
+                return normalized ? std::max(v / 127.0f, -1.0f) : v;
+            }
+            case kGltfUnsignedByte: return normalized ? *p / 255.0f : *p;
+            case kGltfShort: {
+                int16_t v;
+                std::memcpy(&v, p, 2);
+                return normalized ? std::max(v / 32767.0f, -1.0f) : v;
+            }
+            case kGltfUnsignedShort: {
+                uint16_t v;
+                std::memcpy(&v, p, 2);
+                return normalized ? v / 65535.0f : v;
+            }
+            case kGltfUnsignedInt: {
+                uint32_t v;
+                std::memcpy(&v, p, 4);
+                return static_cast<float>(v);
+            }
+            default: {
+                float v;
+                std::memcpy(&v, p, 4);
+                return v;
+            }
+        }
+    }
+
+    // element i into out, at most count components, what the accessor doesn't have keeps its value
+    void read_element(const GltfAccessor& accessor, size_t i, float* out, int count) {
+        if (accessor.data == nullptr) {
+            std::fill(out, out + std::min(count, accessor.components), 0.0f);
+            return;
+        }
+        const unsigned char* element = accessor.data + i * accessor.stride;
+        size_t size = component_size(accessor.component_type);
+        for (int c = 0; c < std::min(count, accessor.components); ++c) {
+            out[c] = read_component(element + c * size, accessor.component_type, accessor.normalized);
+        }
+    }
+
+    uint32_t read_index(const GltfAccessor& accessor, size_t i) {
+        if (accessor.data == nullptr) {
+            return 0;
+        }
+        const unsigned char* element = accessor.data + i * accessor.stride;
+        switch (accessor.component_type) {
+            case kGltfUnsignedByte: return *element;
+            case kGltfUnsignedShort: {
+                uint16_t index;
+                std::memcpy(&index, element, 2);
+                return index;
+            }
+            default: {
+                uint32_t index;
+                std::memcpy(&index, element, 4);
+                return index;
+            }
+        }
+    }
+
+    bool append_primitive(const GltfFile& file, const JsonValue& primitive, const Matrix4& transform, ImportedMesh& mesh,
+                          std::string& error) {
+        const JsonValue& attributes = primitive["attributes"];
+        if (primitive["mode"].integer(kGltfTriangles) != kGltfTriangles || !attributes.has("POSITION")) {
+            // points and lines have no place in a triangle mesh
+            return true;
+        }
+        GltfAccessor positions, normals, texcoords, colors, indices;
+        if (!get_accessor(file, attributes["POSITION"].integer(), positions, error) ||
+            (attributes.has("NORMAL") && !get_accessor(file, attributes["NORMAL"].integer(), normals, error)) ||
+            (attributes.has("TEXCOORD_0") && !get_accessor(file, attributes["TEXCOORD_0"].integer(), texcoords, error)) ||
+            (attributes.has("COLOR_0") && !get_accessor(file, attributes["COLOR_0"].integer(), colors, error)) ||
+            (primitive.has("indices") && !get_accessor(file, primitive["indices"].integer(), indices, error))) {
+            return false;
+        }
+        if (primitive.has("indices") && (indices.components != 1 || (indices.component_type != kGltfUnsignedByte &&
+            indices.component_type != kGltfUnsignedShort && indices.component_type != kGltfUnsignedInt))) {
+            error = "indices that aren't unsigned integers";
+            return false;
+        }
+
+        const size_t base = mesh.vertex_count();
+        const size_t vertex_count = positions.count;
+        if (base + vertex_count > 0xFFFFFFFFull) {
+            error = "more than 4G vertices";
+            return false;
+        }
+        float normal_transform[3][3];
+        float determinant;
+        normal_matrix(transform, normal_transform, determinant);
+
+        mesh.positions.reserve((base + vertex_count) * 3);
+        for (size_t v = 0; v < vertex_count; ++v) {
+            float p[3] = { 0.0f, 0.0f, 0.0f };
+            read_element(positions, v, p, 3);
+            for (int row = 0; row < 3; ++row) {
+                mesh.positions.push_back(transform[row] * p[0] + transform[4 + row] * p[1] + transform[8 + row] * p[2] +
+                                         transform[12 + row]);
+            }
+        }
+        if (normals.count) {
+            pad_stream(mesh.normals, 3, base, 0.0f);
+            for (size_t v = 0; v < vertex_count; ++v) {
+                float n[3] = { 0.0f, 0.0f, 0.0f };
+                read_element(normals, std::min(v, normals.count - 1), n, 3);
+                float out[3];
+                for (int row = 0; row < 3; ++row) {
+                    out[row] = normal_transform[row][0] * n[0] + normal_transform[row][1] * n[1] + normal_transform[row][2] * n[2];
+                }
+                float length = std::sqrt(out[0] * out[0] + out[1] * out[1] + out[2] * out[2]);
+                for (float component : out) {
+                    mesh.normals.push_back(length > 0.0f ? component / length : 0.0f);
+                }
+            }
+        }
+        if (texcoords.count) {
+            pad_stream(mesh.texcoords, 2, base, 0.0f);
+            for (size_t v = 0; v < vertex_count; ++v) {
+                float t[2] = { 0.0f, 0.0f };
+                read_element(texcoords, std::min(v, texcoords.count - 1), t, 2);
+                mesh.texcoords.insert(mesh.texcoords.end(), t, t + 2);
+            }
+        }
+        if (colors.count) {
+            pad_stream(mesh.colors, 4, base, 1.0f);
+            for (size_t v = 0; v < vertex_count; ++v) {
+                float c[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+                read_element(colors, std::min(v, colors.count - 1), c, 4);
+                mesh.colors.insert(mesh.colors.end(), c, c + 4);
+            }
+        }
+        // streams earlier primitives had and this one doesn't
+        if (!mesh.normals.empty()) {
+            pad_stream(mesh.normals, 3, base + vertex_count, 0.0f);
+        }
+        if (!mesh.texcoords.empty()) {
+            pad_stream(mesh.texcoords, 2, base + vertex_count, 0.0f);
+        }
+        if (!mesh.colors.empty()) {
+            pad_stream(mesh.colors, 4, base + vertex_count, 1.0f);
+        }
+
+        size_t index_count = primitive.has("indices") ? indices.count : vertex_count;
+        index_count -= index_count % 3;
+        if (index_count == 0) {
+            return true;
+        }
+        if (!mesh.indices.empty()) {
+            mesh.submesh_starts.push_back(static_cast<uint32_t>(mesh.indices.size()));
+        }
+        mesh.indices.reserve(mesh.indices.size() + index_count);
+        for (size_t i = 0; i < index_count; i += 3) {
+            uint32_t triangle[3];
+            for (int corner = 0; corner < 3; ++corner) {
+                triangle[corner] = primitive.has("indices") ? read_index(indices, i + corner) : static_cast<uint32_t>(i + corner);
+                if (triangle[corner] >= vertex_count) {
+                    error = "index " + std::to_string(triangle[corner]) + " out of range";
+                    return false;
+                }
+            }
+            // a mirroring transform turns the winding around
+            if (determinant < 0.0f) {
+                std::swap(triangle[1], triangle[2]);
+            }
+            for (uint32_t index : triangle) {
+                mesh.indices.push_back(static_cast<uint32_t>(base) + index);
+            }
+        }
+        return true;
+    }
+
+    bool append_node(const GltfFile& file, long long index, const Matrix4& parent, ImportedMesh& mesh, int depth,
+                     std::string& error) {
+        const JsonValue& node = file.json["nodes"][static_cast<size_t>(index)];
+        if (!node.is_object() || depth > kMaxNodeDepth) {
+            error = "node " + std::to_string(index) + " is missing or part of a cycle";
+            return false;
+        }
+        Matrix4 transform = multiply(parent, node_matrix(node));
+        if (node.has("mesh")) {
+            const JsonValue& primitives = file.json["meshes"][static_cast<size_t>(node["mesh"].integer())]["primitives"];
+            for (size_t p = 0; p < primitives.size(); ++p) {
+                if (!append_primitive(file, primitives[p], transform, mesh, error)) {
+                    return false;
+                }
+            }
+        }
+        const JsonValue& children = node["children"];
+        for (size_t c = 0; c < children.size(); ++c) {
+            if (!append_node(file, children[c].integer(), transform, mesh, depth + 1, error)) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+VertexStreams ImportedMesh::streams() const {
+    VertexStreams streams;
+    streams.positions = positions.empty() ? nullptr : positions.data();
+    streams.normals = normals.empty() ? nullptr : normals.data();
+    streams.colors = colors.empty() ? nullptr : colors.data();
+    streams.texcoords = texcoords.empty() ? nullptr : texcoords.data();
+    return streams;
+}
+
+bool import_mesh(const std::string& path, ImportedMesh& mesh, std::string& error, ImportStats* stats) {
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+    if (extension == ".obj") {
+        return import_obj(path, mesh, error, stats);
+    }
+    if (extension == ".gltf" || extension == ".glb") {
+        return import_gltf(path, mesh, error, stats);
+    }
+    error = path + ": unknown model format";
+    return false;
+}
+
+bool import_obj(const std::string& path, ImportedMesh& mesh, std::string& error, ImportStats* stats, unsigned int threads) {
+    mesh = ImportedMesh();
+    auto start = std::chrono::steady_clock::now();
+    MappedFile file;
+    if (!file.open(path, error)) {
+        return false;
+    }
+    const char* data = static_cast<const char*>(file.data());
+    const size_t size = file.size();
+
+    // chunks end behind a newline, so every line is parsed by exactly one thread
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t chunk_count = std::max<size_t>(1, std::min<size_t>(threads, size / kMinChunkBytes));
+    std::vector<ObjChunk> chunks(chunk_count);
+    const char* chunk_begin = data;
+    for (size_t c = 0; c < chunk_count; ++c) {
+        const char* chunk_end = data + size;
+        if (c + 1 < chunk_count) {
+            const char* target = std::max(chunk_begin, data + size * (c + 1) / chunk_count);
+            const char* newline = static_cast<const char*>(std::memchr(target, '\n', data + size - target));
+            chunk_end = newline ? newline + 1 : data + size;
+        }
+        chunks[c].begin = chunk_begin;
+        chunks[c].end = chunk_end;
+        chunk_begin = chunk_end;
+    }
+    std::vector<std::thread> workers;
+    for (size_t c = 1; c < chunk_count; ++c) {
+        workers.emplace_back(parse_obj_chunk, std::ref(chunks[c]));
+    }
+    parse_obj_chunk(chunks[0]);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    for (const ObjChunk& chunk : chunks) {
+        if (chunk.error_at) {
+            size_t line = std::count(data, chunk.error_at, '\n') + 1;
+            error = path + ":" + std::to_string(line) + ": " + chunk.error;
+            return false;
+        }
+    }
+    double parse_ms = elapsed_ms(start);
+    start = std::chrono::steady_clock::now();
+
+    // the attributes of all chunks, in file order
+    std::vector<float> positions, colors, normals, texcoords;
+    size_t corner_count = 0;
+    bool has_colors = false;
+    for (const ObjChunk& chunk : chunks) {
+        corner_count += chunk.corners.size();
+        has_colors = has_colors || !chunk.colors.empty();
+    }
+    for (ObjChunk& chunk : chunks) {
+        if (has_colors) {
+            pad_stream(chunk.colors, 4, chunk.positions.size() / 3, 1.0f);
+            colors.insert(colors.end(), chunk.colors.begin(), chunk.colors.end());
+        }
+        positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+        normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+        texcoords.insert(texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+    }
+    const size_t position_total = positions.size() / 3, normal_total = normals.size() / 3, texcoord_total = texcoords.size() / 2;
+    if (position_total > size_t(kMaxIndex)) {
+        error = path + ": too many vertices";
+        return false;
+    }
+
+    // one vertex per distinct corner, in the order they are first used
+    CornerTable table(position_total);
+    mesh.indices.reserve(corner_count);
+    mesh.positions.reserve(position_total * 3);
+    size_t position_base = 0, normal_base = 0, texcoord_base = 0;
+    for (const ObjChunk& chunk : chunks) {
+        for (uint32_t start_corner : chunk.group_starts) {
+            uint32_t index = static_cast<uint32_t>(mesh.indices.size()) + start_corner;
+            if (index > 0 && index < corner_count && (mesh.submesh_starts.empty() || mesh.submesh_starts.back() < index)) {
+                mesh.submesh_starts.push_back(index);
+            }
+        }
+        for (ObjCorner corner : chunk.corners) {
+            if (!resolve_corner_index(corner.position, position_base, position_total) ||
+                !resolve_corner_index(corner.texcoord, texcoord_base, texcoord_total) ||
+                !resolve_corner_index(corner.normal, normal_base, normal_total)) {
+                error = path + ": face index out of range";
+                return false;
+            }
+            bool inserted;
+            uint32_t vertex = table.find_or_insert(corner, mesh.vertex_count(), inserted);
+            mesh.indices.push_back(vertex);
+            if (!inserted) {
+                continue;
+            }
+            const float* position = &positions[size_t(corner.position) * 3];
+            mesh.positions.insert(mesh.positions.end(), position, position + 3);
+            if (has_colors) {
+                const float* color = &colors[size_t(corner.position) * 4];
+                mesh.colors.insert(mesh.colors.end(), color, color + 4);
+            }
+            if (normal_total) {
+                const float zero[3] = { 0.0f, 0.0f, 0.0f };
+                const float* normal = corner.normal == kNoIndex ? zero : &normals[size_t(corner.normal) * 3];
+                mesh.normals.insert(mesh.normals.end(), normal, normal + 3);
+            }
+            if (texcoord_total) {
+                const float zero[2] = { 0.0f, 0.0f };
+                const float* texcoord = corner.texcoord == kNoIndex ? zero : &texcoords[size_t(corner.texcoord) * 2];
+                mesh.texcoords.insert(mesh.texcoords.end(), texcoord, texcoord + 2);
+            }
+        }
+        position_base += chunk.positions.size() / 3;
+        normal_base += chunk.normals.size() / 3;
+        texcoord_base += chunk.texcoords.size() / 2;
+    }
+
+    if (stats) {
+        stats->threads = static_cast<unsigned int>(chunk_count);
+        stats->corners = corner_count;
+        stats->parse_ms = parse_ms;
+        stats->build_ms = elapsed_ms(start);
+    }
+    return true;
+}
+
+bool import_gltf(const std::string& path, ImportedMesh& mesh, std::string& error, ImportStats* stats) {
+    mesh = ImportedMesh();
+    auto start = std::chrono::steady_clock::now();
+    MappedFile mapped;
+    if (!mapped.open(path, error)) {
+        return false;
+    }
+    const unsigned char* data = static_cast<const unsigned char*>(mapped.data());
+    std::string_view json_text = mapped.view();
+    const unsigned char* bin = nullptr;
+    size_t bin_size = 0;
+
+    uint32_t header[3] = { 0, 0, 0 };
+    if (mapped.size() >= sizeof(header)) {
+        std::memcpy(header, data, sizeof(header));
+    }
+    if (header[0] == kGlbMagic) {
+        // 12 byte header, then chunks of (length, type, data): json first, the binary buffer after it
+        uint32_t chunk[2] = { 0, 0 };
+        if (mapped.size() >= 20) {
+            std::memcpy(chunk, data + 12, sizeof(chunk));
+        }
+        if (header[1] != 2 || chunk[1] != kGlbJsonChunk || 20 + uint64_t(chunk[0]) > mapped.size()) {
+            error = path + ": not a glb 2.0 file";
+            return false;
+        }
+        json_text = std::string_view(reinterpret_cast<const char*>(data + 20), chunk[0]);
+        size_t bin_chunk = (20 + size_t(chunk[0]) + 3) & ~size_t(3);
+        if (bin_chunk + 8 <= mapped.size()) {
+            std::memcpy(chunk, data + bin_chunk, sizeof(chunk));
+            if (chunk[1] == kGlbBinChunk && bin_chunk + 8 + uint64_t(chunk[0]) <= mapped.size()) {
+                bin = data + bin_chunk + 8;
+                bin_size = chunk[0];
+            }
+        }
+    }
+
+    GltfFile file;
+    if (!parse_json(json_text, file.json, error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    if (file.json["asset"]["version"].string().compare(0, 2, "2.") != 0) {
+        error = path + ": not a gltf 2.0 file";
+        return false;
+    }
+    if (!load_gltf_buffers(file, std::filesystem::path(path).parent_path(), bin, bin_size, error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    double parse_ms = elapsed_ms(start);
+    start = std::chrono::steady_clock::now();
+
+    bool appended = true;
+    const JsonValue& scenes = file.json["scenes"];
+    if (scenes.size() > 0) {
+        const JsonValue& roots = scenes[static_cast<size_t>(std::max(0ll, file.json["scene"].integer(0)))]["nodes"];
+        for (size_t r = 0; r < roots.size() && appended; ++r) {
+            appended = append_node(file, roots[r].integer(), kIdentity, mesh, 0, error);
+        }
+    } else {
+        // no scene to place them, every mesh once where it is
+        const JsonValue& meshes = file.json["meshes"];
+        for (size_t m = 0; m < meshes.size() && appended; ++m) {
+            const JsonValue& primitives = meshes[m]["primitives"];
+            for (size_t p = 0; p < primitives.size() && appended; ++p) {
+                appended = append_primitive(file, primitives[p], kIdentity, mesh, error);
+            }
+        }
+    }
+    if (!appended) {
+        error = path + ": " + error;
+        return false;
+    }
+
+    if (stats) {
+        stats->threads = 1;
+        stats->corners = mesh.indices.size();
+        stats->parse_ms = parse_ms;
+        stats->build_ms = elapsed_ms(start);
+    }
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "vertex_layout.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// an imported model as plain float streams, one entry per unique vertex, ready for VertexLayout::encode
+// streams the file has nothing for stay empty, vertices that lack an attribute others have get 0 (white colors)
+struct ImportedMesh {
+    std::vector<float> positions;   // 3 per vertex
+    std::vector<float> normals;     // 3 per vertex
+    std::vector<float> colors;      // 4 per vertex
+    std::vector<float> texcoords;   // 2 per vertex
+    std::vector<uint32_t> indices;  // triangles
+    // first index of every submesh after the first one (obj groups and materials, gltf primitives)
+    std::vector<uint32_t> submesh_starts;
+
+    uint32_t vertex_count() const { return static_cast<uint32_t>(positions.size() / 3); }
+    uint32_t triangle_count() const { return static_cast<uint32_t>(indices.size() / 3); }
+    VertexStreams streams() const;
+};
+
+struct ImportStats {
+    unsigned int threads = 1;
+    uint64_t corners = 0;       // face corners read, i.e. vertices before deduplication
+    double parse_ms = 0.0;      // reading the file into attribute lists
+    double build_ms = 0.0;      // resolving and deduplicating into the mesh
+};
+
+// picks the format by extension: .obj, .gltf or .glb
+// returns false and fills error if the file can't be read or isn't something we understand
+bool import_mesh(const std::string& path, ImportedMesh& mesh, std::string& error, ImportStats* stats = nullptr);
+
+// wavefront obj with v/vt/vn and the common "v x y z r g b" vertex colors, polygons are triangulated as fans
+// the file is split at line boundaries into a chunk per thread (threads = 0 uses every core), the chunks are
+// parsed in parallel and then merged, vertices that share all of position, texcoord and normal become one
+bool import_obj(const std::string& path, ImportedMesh& mesh, std::string& error, ImportStats* stats = nullptr,
+                unsigned int threads = 0);
+
+// gltf 2.0, .gltf with external or data: uri buffers and .glb with the binary chunk. the default scene is
+// flattened with the node transforms applied, every triangle primitive becomes a submesh
+bool import_gltf(const std::string& path, ImportedMesh& mesh, std::string& error, ImportStats* stats = nullptr);
@@ -0,0 +1,352 @@
+#include "mesh_optimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    const uint32_t kNone = 0xFFFFFFFFu;
+
+    // fifo cache where a vertex is in the cache while fewer than cache_size misses happened since it was loaded
+    class FifoCache {
+    public:
+        FifoCache(size_t vertex_count, uint32_t cache_size) : loaded_(vertex_count, 0), size_(cache_size) {}
+        // true on a miss
+        bool access(uint32_t vertex) {
+            if (loaded_[vertex] != 0 && misses_ - loaded_[vertex] < size_) {
+                return false;
+            }
+            loaded_[vertex] = ++misses_;
+            return true;
+        }
+        // everything gets evicted, without touching every vertex
+        void flush() { misses_ += size_; }
+
+    private:
+        std::vector<uint32_t> loaded_;
+        uint32_t size_;
+        uint32_t misses_ = 0;
+    };
+
+    struct Cluster {
+        size_t begin;
+        size_t end;
+        float sort_key;
+    };
+
+    void read_position(const unsigned char* vertices, uint32_t vertex, size_t stride, size_t offset, int components, float out[3]) {
+        std::memcpy(out, vertices + vertex * stride + offset, sizeof(float) * components);
+        if (components < 3) {
+            out[2] = 0.0f;
+        }
+    }
+}
+
+VertexCacheStats analyze_vertex_cache(const uint32_t* indices, size_t index_count, size_t vertex_count, uint32_t cache_size) {
+    VertexCacheStats stats;
+    FifoCache cache(vertex_count, cache_size);
+    std::vector<bool> used(vertex_count, false);
+    for (size_t i = 0; i < index_count; ++i) {
+        uint32_t vertex = indices[i];
+        stats.transforms += cache.access(vertex) ? 1 : 0;
+        if (!used[vertex]) {
+            used[vertex] = true;
+            ++stats.vertices;
+        }
+    }
+    stats.triangles = static_cast<uint32_t>(index_count / 3);
+    return stats;
+}
+
+void optimize_vertex_cache(uint32_t* destination, const uint32_t* indices, size_t index_count, size_t vertex_count, uint32_t cache_size) {
+    std::vector<uint32_t> input(indices, indices + index_count);
+    size_t triangle_count = index_count / 3;
+
+    // triangles around every vertex, and how many of them are still to be emitted
+    std::vector<uint32_t> live(vertex_count, 0);
+    for (size_t i = 0; i < triangle_count * 3; ++i) {
+        ++live[input[i]];
+    }
+    std::vector<uint32_t> first_triangle(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; ++v) {
+        first_triangle[v + 1] = first_triangle[v] + live[v];
+    }
+    std::vector<uint32_t> fill(first_triangle.begin(), first_triangle.end() - 1);
+    std::vector<uint32_t> adjacency(triangle_count * 3);
+    for (size_t i = 0; i < triangle_count * 3; ++i) {
+        adjacency[fill[input[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<uint32_t> time_stamp(vertex_count, 0);
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<uint32_t> dead_ends;
+    std::vector<uint32_t> candidates;
+    uint32_t time = cache_size + 1;
+    size_t cursor = 0;
+    size_t out = 0;
+
+    // fan around one vertex at a time, then continue with a vertex that is likely still in the cache
+    uint32_t fanning = kNone;
+    while (cursor < vertex_count && live[cursor] == 0) {
+        ++cursor;
+    }
+    if (cursor < vertex_count) {
+        fanning = static_cast<uint32_t>(cursor);
+    }
+    while (fanning != kNone) {
+        candidates.clear();
+        for (uint32_t k = first_triangle[fanning]; k < first_triangle[fanning + 1]; ++k) {
+            uint32_t triangle = adjacency[k];
+            if (emitted[triangle]) {
+                continue;
+            }
+            emitted[triangle] = true;
+            for (int corner = 0; corner < 3; ++corner) {
+                uint32_t vertex = input[triangle * 3 + corner];
+                destination[out++] = vertex;
+                dead_ends.push_back(vertex);
+                candidates.push_back(vertex);
+                --live[vertex];
+                if (time - time_stamp[vertex] > cache_size) {
+                    time_stamp[vertex] = time++;
+                }
+            }
+        }
+
+        // prefer the oldest vertex that still fits into the cache with all its remaining triangles
+        uint32_t best = kNone;
+        int64_t best_priority = -1;
+        for (uint32_t vertex : candidates) {
+            if (live[vertex] == 0) {
+                continue;
+            }
+            int64_t priority = 0;
+            if (time - time_stamp[vertex] + 2 * live[vertex] <= cache_size) {
+                priority = time - time_stamp[vertex];
+            }
+            if (priority > best_priority) {
+                best_priority = priority;
+                best = vertex;
+            }
+        }
+        // dead end, go back to recently used vertices first and only then scan for anything left
+        while (best == kNone && !dead_ends.empty()) {
+            uint32_t vertex = dead_ends.back();
+            dead_ends.pop_back();
+            if (live[vertex] > 0) {
+                best = vertex;
+            }
+        }
+        while (best == kNone && cursor < vertex_count) {
+            if (live[cursor] > 0) {
+                best = static_cast<uint32_t>(cursor);
+            }
+            ++cursor;
+        }
+        fanning = best;
+    }
+    // a trailing partial triangle isn't drawn, keep it anyway
+    for (size_t i = triangle_count * 3; i < index_count; ++i) {
+        destination[out++] = input[i];
+    }
+}
+
+void optimize_overdraw(uint32_t* destination, const uint32_t* indices, size_t index_count, const void* vertices,
+                       size_t vertex_count, size_t vertex_stride, size_t position_offset, int position_components,
+                       float threshold, uint32_t cache_size) {
+    std::vector<uint32_t> input(indices, indices + index_count);
+    size_t triangle_count = index_count / 3;
+    if (triangle_count == 0 || position_components < 2) {
+        std::copy(input.begin(), input.end(), destination);
+        return;
+    }
+    const unsigned char* vertex_bytes = static_cast<const unsigned char*>(vertices);
+
+    // hard boundaries: triangles that miss the cache with all three vertices, the cache order jumped there
+    std::vector<size_t> hard_starts;
+    FifoCache cache(vertex_count, cache_size);
+    for (size_t t = 0; t < triangle_count; ++t) {
+        int misses = 0;
+        for (int corner = 0; corner < 3; ++corner) {
+            misses += cache.access(input[t * 3 + corner]) ? 1 : 0;
+        }
+        if (t == 0 || misses == 3) {
+            hard_starts.push_back(t);
+        }
+    }
+    hard_starts.push_back(triangle_count);
+
+    // soft boundaries: inside a hard cluster cut as soon as the part so far is about as cache friendly as the whole
+    std::vector<Cluster> clusters;
+    for (size_t h = 0; h + 1 < hard_starts.size(); ++h) {
+        size_t begin = hard_starts[h];
+        size_t end = hard_starts[h + 1];
+        cache.flush();
+        uint32_t cluster_misses = 0;
+        for (size_t t = begin; t < end; ++t) {
+            for (int corner = 0; corner < 3; ++corner) {
+                cluster_misses += cache.access(input[t * 3 + corner]) ? 1 : 0;
+            }
+        }
+        float limit = float(cluster_misses) / float(end - begin) * threshold;
+
+        cache.flush();
+        size_t start = begin;
+        uint32_t misses = 0;
+        for (size_t t = begin; t < end; ++t) {
+            for (int corner = 0; corner < 3; ++corner) {
+                misses += cache.access(input[t * 3 + corner]) ? 1 : 0;
+            }
+            if (t + 1 < end && float(misses) / float(t + 1 - start) <= limit) {
+                clusters.push_back({ start, t + 1, 0.0f });
+                start = t + 1;
+                misses = 0;
+                cache.flush();
+            }
+        }
+        clusters.push_back({ start, end, 0.0f });
+    }
+
+    // sort key: how far the cluster sits out from the mesh center along its own normal
+    float mesh_center[3] = { 0.0f, 0.0f, 0.0f };
+    for (size_t i = 0; i < triangle_count * 3; ++i) {
+        float p[3];
+        read_position(vertex_bytes, input[i], vertex_stride, position_offset, position_components, p);
+        for (int c = 0; c < 3; ++c) {
+            mesh_center[c] += p[c];
+        }
+    }
+    for (int c = 0; c < 3; ++c) {
+        mesh_center[c] /= float(triangle_count * 3);
+    }
+    for (Cluster& cluster : clusters) {
+        float center[3] = { 0.0f, 0.0f, 0.0f };
+        float normal[3] = { 0.0f, 0.0f, 0.0f };
+        float area = 0.0f;
+        for (size_t t = cluster.begin; t < cluster.end; ++t) {
+            float a[3], b[3], c[3];
+            read_position(vertex_bytes, input[t * 3], vertex_stride, position_offset, position_components, a);
+            read_position(vertex_bytes, input[t * 3 + 1], vertex_stride, position_offset, position_components, b);
+            read_position(vertex_bytes, input[t * 3 + 2], vertex_stride, position_offset, position_components, c);
+            float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+            float cross[3] = { ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0] };
+            float triangle_area = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+            for (int k = 0; k < 3; ++k) {
+                center[k] += (a[k] + b[k] + c[k]) / 3.0f * triangle_area;
+                normal[k] += cross[k];
+            }
+            area += triangle_area;
+        }
+        float normal_length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (area <= 0.0f || normal_length <= 0.0f) {
+            continue;
+        }
+        float key = 0.0f;
+        for (int k = 0; k < 3; ++k) {
+            key += (center[k] / area - mesh_center[k]) * (normal[k] / normal_length);
+        }
+        cluster.sort_key = key;
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+        return a.sort_key > b.sort_key;
+    });
+
+    size_t out = 0;
+    for (const Cluster& cluster : clusters) {
+        for (size_t i = cluster.begin * 3; i < cluster.end * 3; ++i) {
+            destination[out++] = input[i];
+        }
+    }
+    for (size_t i = triangle_count * 3; i < index_count; ++i) {
+        destination[out++] = input[i];
+    }
+}
+
+size_t optimize_vertex_fetch(void* destination, uint32_t* indices, size_t index_count, const void* vertices,
+                             size_t vertex_count, size_t vertex_size) {
+    std::vector<uint32_t> remap(vertex_count, kNone);
+    unsigned char* out = static_cast<unsigned char*>(destination);
+    const unsigned char* in = static_cast<const unsigned char*>(vertices);
+    uint32_t next = 0;
+    for (size_t i = 0; i < index_count; ++i) {
+        uint32_t& mapped = remap[indices[i]];
+        if (mapped == kNone) {
+            std::memcpy(out + size_t(next) * vertex_size, in + size_t(indices[i]) * vertex_size, vertex_size);
+            mapped = next++;
+        }
+        indices[i] = mapped;
+    }
+    return next;
+}
+
+GLenum index_type_for(size_t vertex_count) {
+    if (vertex_count <= 0x100) {
+        return GL_UNSIGNED_BYTE;
+    }
+    if (vertex_count <= 0x10000) {
+        return GL_UNSIGNED_SHORT;
+    }
+    return GL_UNSIGNED_INT;
+}
+
+size_t index_type_size(GLenum index_type) {
+    switch (index_type) {
+        case GL_UNSIGNED_BYTE: return 1;
+        case GL_UNSIGNED_SHORT: return 2;
+        default: return 4;
+    }
+}
+
+void narrow_indices(void* destination, const uint32_t* indices, size_t index_count, GLenum index_type) {
+    switch (index_type) {
+        case GL_UNSIGNED_BYTE: {
+            uint8_t* out = static_cast<uint8_t*>(destination);
+            for (size_t i = 0; i < index_count; ++i) {
+                out[i] = static_cast<uint8_t>(indices[i]);
+            }
+            break;
+        }
+        case GL_UNSIGNED_SHORT: {
+            uint16_t* out = static_cast<uint16_t*>(destination);
+            for (size_t i = 0; i < index_count; ++i) {
+                out[i] = static_cast<uint16_t>(indices[i]);
+            }
+            break;
+        }
+        default:
+            std::memcpy(destination, indices, index_count * sizeof(uint32_t));
+            break;
+    }
+}
+
+MeshOptimizeStats optimize_mesh(std::vector<unsigned char>& vertices, size_t vertex_size, std::vector<uint32_t>& indices,
+                                const std::vector<uint32_t>& submesh_starts, const float* positions) {
+    MeshOptimizeStats stats;
+    size_t vertex_count = vertices.size() / vertex_size;
+    stats.before = analyze_vertex_cache(indices.data(), indices.size(), vertex_count);
+
+    std::vector<size_t> bounds(1, 0);
+    for (uint32_t start : submesh_starts) {
+        bounds.push_back(std::min<size_t>(start, indices.size()));
+    }
+    bounds.push_back(indices.size());
+    for (size_t s = 0; s + 1 < bounds.size(); ++s) {
+        if (bounds[s + 1] <= bounds[s]) {
+            continue;
+        }
+        uint32_t* submesh = indices.data() + bounds[s];
+        size_t count = bounds[s + 1] - bounds[s];
+        optimize_vertex_cache(submesh, submesh, count, vertex_count);
+        if (positions) {
+            optimize_overdraw(submesh, submesh, count, positions, vertex_count, 3 * sizeof(float), 0, 3);
+        }
+    }
+
+    std::vector<unsigned char> fetch_ordered(vertices.size());
+    size_t used = optimize_vertex_fetch(fetch_ordered.data(), indices.data(), indices.size(), vertices.data(), vertex_count, vertex_size);
+    fetch_ordered.resize(used * vertex_size);
+    vertices.swap(fetch_ordered);
+
+    stats.after = analyze_vertex_cache(indices.data(), indices.size(), used);
+    return stats;
+}
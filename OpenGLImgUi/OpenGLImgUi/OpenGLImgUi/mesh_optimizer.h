@@ -0,0 +1,58 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// post transform cache size the reordering and the stats assume, a common fifo size on current gpus
+const uint32_t kVertexCacheSize = 16;
+
+// how often a fifo vertex cache of the given size has to run the vertex shader for an index order
+struct VertexCacheStats {
+    uint32_t triangles = 0;
+    uint32_t vertices = 0;      // distinct vertices the indices reference
+    uint32_t transforms = 0;    // cache misses
+    // average cache miss ratio, transforms per triangle: 3 is no reuse at all, ~0.5 is the best a mesh can do
+    float acmr() const { return triangles ? float(transforms) / triangles : 0.0f; }
+    // average transform to vertex ratio, 1 means every vertex is shaded exactly once
+    float atvr() const { return vertices ? float(transforms) / vertices : 0.0f; }
+};
+
+VertexCacheStats analyze_vertex_cache(const uint32_t* indices, size_t index_count, size_t vertex_count,
+                                      uint32_t cache_size = kVertexCacheSize);
+
+// triangle order for the vertex cache (tipsify, Sander et al. 2007), destination may be indices
+void optimize_vertex_cache(uint32_t* destination, const uint32_t* indices, size_t index_count, size_t vertex_count,
+                           uint32_t cache_size = kVertexCacheSize);
+
+// reorders clusters of an already cache optimized index list so outward facing parts get drawn first and hide
+// what is behind them. clusters are cut where the cache order allows it, threshold is how much worse than the
+// cache order's acmr we accept (1.05 = 5%). positions are read as 2 or 3 floats at position_offset in every
+// vertex_stride bytes. destination may be indices
+void optimize_overdraw(uint32_t* destination, const uint32_t* indices, size_t index_count, const void* vertices,
+                       size_t vertex_count, size_t vertex_stride, size_t position_offset, int position_components,
+                       float threshold = 1.05f, uint32_t cache_size = kVertexCacheSize);
+
+// vertices in the order the indices first use them, which makes fetching them linear. the indices are
+// rewritten to match, vertices nothing references are dropped. returns the new vertex count
+// destination has room for vertex_count vertices and doesn't overlap vertices
+size_t optimize_vertex_fetch(void* destination, uint32_t* indices, size_t index_count, const void* vertices,
+                             size_t vertex_count, size_t vertex_size);
+
+// GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, the smallest that indexes vertex_count vertices
+GLenum index_type_for(size_t vertex_count);
+size_t index_type_size(GLenum index_type);
+// copy indices into destination as index_type, they have to fit
+void narrow_indices(void* destination, const uint32_t* indices, size_t index_count, GLenum index_type);
+
+struct MeshOptimizeStats {
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+// everything above in order: vertex cache, overdraw, vertex fetch
+// submesh_starts holds the first index of every submesh after the first one, triangles never move from one
+// submesh to another so ranges into the index list stay valid. vertices shrinks to the ones in use
+// positions are 3 floats per (original) vertex for the overdraw pass, without them it is skipped
+MeshOptimizeStats optimize_mesh(std::vector<unsigned char>& vertices, size_t vertex_size, std::vector<uint32_t>& indices,
+                                const std::vector<uint32_t>& submesh_starts, const float* positions);
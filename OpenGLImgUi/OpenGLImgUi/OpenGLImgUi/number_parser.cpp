@@ -0,0 +1,164 @@
+#include "number_parser.h"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace {
+    // every power of ten a float holds exactly
+    const float kExactPowersOfTen[] = {
+        1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f,
+    };
+    const int kMaxExactExponent = 10;
+    const uint64_t kMaxExactMantissa = uint64_t(1) << 24;
+
+    // the next 8 bytes as one little endian word, every platform we build for is little endian
+    uint64_t load_eight(const char* p) {
+        uint64_t chunk;
+        std::memcpy(&chunk, p, sizeof(chunk));
+        return chunk;
+    }
+
+    bool is_eight_digits(uint64_t chunk) {
+        // '0'..'9' is 0x30..0x39: the high nibble of every byte is 3, and stays 3 after adding 6 to the byte
+        return ((chunk & 0xF0F0F0F0F0F0F0F0ull) | (((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) ==
+               0x3333333333333333ull;
+    }
+
+    // the value of 8 ascii digits, combining neighbours in pairs: 8 digits -> 4 two digit -> 2 four digit -> 1
+    uint32_t parse_eight_digits(uint64_t chunk) {
+        chunk = (chunk & 0x0F0F0F0F0F0F0F0Full) * 2561 >> 8;
+        chunk = (chunk & 0x00FF00FF00FF00FFull) * 6553601 >> 16;
+        return static_cast<uint32_t>((chunk & 0x0000FFFF0000FFFFull) * 42949672960001ull >> 32);
+    }
+
+    bool is_digit(char c) {
+        return static_cast<unsigned char>(c - '0') < 10;
+    }
+
+    // accumulates a run of digits into value, digits counts them (value wraps past 19, callers check digits)
+    const char* parse_digits(const char* p, const char* end, uint64_t& value, int& digits) {
+        while (end - p >= 8) {
+            uint64_t chunk = load_eight(p);
+            if (!is_eight_digits(chunk)) {
+                break;
+            }
+            value = value * 100000000 + parse_eight_digits(chunk);
+            p += 8;
+            digits += 8;
+        }
+        while (p < end && is_digit(*p)) {
+            value = value * 10 + static_cast<uint64_t>(*p - '0');
+            ++p;
+            ++digits;
+        }
+        return p;
+    }
+
+    // strtof on a null terminated copy, returns how much of it was a number
+    size_t parse_float_slow(const char* begin, const char* end, float& value) {
+        std::string token(begin, end);
+        char* token_end = nullptr;
+        value = std::strtof(token.c_str(), &token_end);
+        return static_cast<size_t>(token_end - token.c_str());
+    }
+}
+
+bool parse_float(const char*& cursor, const char* end, float& value) {
+    const char* p = cursor;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    // leading zeros don't count, so 0.000123 still takes the fast path
+    while (p < end && *p == '0') {
+        ++p;
+        ++digits;
+    }
+    int significant = -digits;
+    p = parse_digits(p, end, mantissa, digits);
+    int exponent = 0;
+    if (p < end && *p == '.') {
+        ++p;
+        const char* fraction = p;
+        if (mantissa == 0) {
+            while (p < end && *p == '0') {
+                ++p;
+            }
+            significant -= static_cast<int>(p - fraction);
+            digits += static_cast<int>(p - fraction);
+        }
+        p = parse_digits(p, end, mantissa, digits);
+        exponent -= static_cast<int>(p - fraction);
+    }
+    significant += digits;
+
+    if (digits == 0) {
+        // inf, infinity, nan
+        const char* word = p;
+        while (p < end && p - word < 8 && ((*p | 0x20) >= 'a' && (*p | 0x20) <= 'z')) {
+            ++p;
+        }
+        size_t consumed = p == word ? 0 : parse_float_slow(cursor, p, value);
+        if (consumed <= size_t(word - cursor)) {
+            return false;
+        }
+        cursor += consumed;
+        return true;
+    }
+
+    if (p < end && (*p | 0x20) == 'e') {
+        const char* e = p + 1;
+        bool exponent_negative = false;
+        if (e < end && (*e == '-' || *e == '+')) {
+            exponent_negative = *e == '-';
+            ++e;
+        }
+        if (e < end && is_digit(*e)) {
+            int written = 0;
+            while (e < end && is_digit(*e)) {
+                // clamped, anything that large is 0 or inf anyway
+                if (written < 100000) {
+                    written = written * 10 + (*e - '0');
+                }
+                ++e;
+            }
+            exponent += exponent_negative ? -written : written;
+            p = e;
+        }
+    }
+
+    if (significant > 19 || mantissa > kMaxExactMantissa || exponent < -kMaxExactExponent || exponent > kMaxExactExponent) {
+        parse_float_slow(cursor, p, value);
+        cursor = p;
+        return true;
+    }
+    // mantissa and power of ten are both exact floats, so the one multiply or divide rounds correctly (clinger's
+    // fast path). going through double would round twice
+    float result = static_cast<float>(mantissa);
+    result = exponent < 0 ? result / kExactPowersOfTen[-exponent] : result * kExactPowersOfTen[exponent];
+    value = negative ? -result : result;
+    cursor = p;
+    return true;
+}
+
+bool parse_int(const char*& cursor, const char* end, int64_t& value) {
+    const char* p = cursor;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+    uint64_t magnitude = 0;
+    int digits = 0;
+    p = parse_digits(p, end, magnitude, digits);
+    if (digits == 0 || digits > 18) {
+        return false;
+    }
+    value = negative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude);
+    cursor = p;
+    return true;
+}
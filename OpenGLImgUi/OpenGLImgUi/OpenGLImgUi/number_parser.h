@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+
+// number parsing straight out of a mapped file: no null terminator needed, no locale, no allocation
+// both read from cursor up to end and leave cursor behind the number. they don't skip whitespace and return
+// false without moving the cursor if there is no number at cursor
+
+// decimal floats as text formats write them ([+-]digits[.digits][(e|E)[+-]digits], also inf and nan).
+// eight digits at a time. digits that fit a float exactly (up to 2^24, so 7 significant digits and some 8)
+// with an exponent within +-10 take the exact fast path, anything else goes through strtof
+bool parse_float(const char*& cursor, const char* end, float& value);
+
+bool parse_int(const char*& cursor, const char* end, int64_t& value);
@@ -0,0 +1,73 @@
+#include "offscreen_target.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+OffscreenTarget::~OffscreenTarget() {
+    destroy();
+}
+
+bool OffscreenTarget::create(int width, int height) {
+    destroy();
+    width_ = width;
+    height_ = height;
+    glGenRenderbuffers(1, &color_);
+    glBindRenderbuffer(GL_RENDERBUFFER, color_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenFramebuffers(1, &framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "ERROR::FRAMEBUFFER::INCOMPLETE: 0x" << std::hex << status << std::dec << std::endl;
+        destroy();
+        return false;
+    }
+    glViewport(0, 0, width, height);
+    return true;
+}
+
+void OffscreenTarget::destroy() {
+    if (framebuffer_) {
+        glDeleteFramebuffers(1, &framebuffer_);
+        framebuffer_ = 0;
+    }
+    if (color_) {
+        glDeleteRenderbuffers(1, &color_);
+        color_ = 0;
+    }
+}
+
+void OffscreenTarget::bind() {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glViewport(0, 0, width_, height_);
+}
+
+void read_framebuffer(unsigned int framebuffer, int width, int height, std::vector<unsigned char>& rgba) {
+    const size_t row = size_t(width) * 4;
+    rgba.resize(row * height);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadBuffer(framebuffer ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+    // gl's first row is the bottom one
+    for (int y = 0; y < height / 2; ++y) {
+        std::swap_ranges(rgba.begin() + y * row, rgba.begin() + (y + 1) * row, rgba.begin() + (height - 1 - y) * row);
+    }
+}
+
+bool write_ppm(const std::string& path, int width, int height, const unsigned char* rgba) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << "P6\n" << width << " " << height << "\n255\n";
+    std::vector<unsigned char> rgb(size_t(width) * 3);
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* row = rgba + size_t(y) * width * 4;
+        for (int x = 0; x < width; ++x) {
+            rgb[x * 3] = row[x * 4];
+            rgb[x * 3 + 1] = row[x * 4 + 1];
+            rgb[x * 3 + 2] = row[x * 4 + 2];
+        }
+        file.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+    }
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// reads back a framebuffer's color (0 is the window's back buffer), blocks until the frame is done, top row first
+void read_framebuffer(unsigned int framebuffer, int width, int height, std::vector<unsigned char>& rgba);
+
+// a framebuffer with an rgba8 color renderbuffer, what the headless mode renders into instead of a window's
+// default framebuffer. same format and size as the window's, so both modes produce the same pixels
+class OffscreenTarget {
+public:
+    OffscreenTarget() = default;
+    ~OffscreenTarget();
+    OffscreenTarget(const OffscreenTarget&) = delete;
+    OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+    // returns false if the framebuffer isn't complete
+    bool create(int width, int height);
+    void destroy();
+
+    // bound for drawing and reading, with a viewport covering it
+    void bind();
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    unsigned int framebuffer() const { return framebuffer_; }
+
+    void read_pixels(std::vector<unsigned char>& rgba) { read_framebuffer(framebuffer_, width_, height_, rgba); }
+
+private:
+    unsigned int framebuffer_ = 0;
+    unsigned int color_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+};
+
+// binary ppm, rgba in with the top row first, alpha is dropped
+bool write_ppm(const std::string& path, int width, int height, const unsigned char* rgba);
@@ -0,0 +1,272 @@
+#include "png_writer.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace {
+    // deflate's limits, the window is how far back a match may start
+    const int kMinMatch = 4;
+    const int kMaxMatch = 258;
+    const size_t kWindow = 32768;
+    const int kHashBits = 15;
+
+    const uint16_t kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                       35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const uint8_t kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const uint16_t kDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+                                         513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    const uint8_t kDistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    uint32_t reverse_bits(uint32_t code, int length) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; ++i) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        return reversed;
+    }
+
+    // the fixed huffman codes (rfc 1951 3.2.6), already bit reversed since the stream is written lsb first
+    // plus lookups from match length and distance to their symbols
+    struct FixedCodes {
+        uint16_t literal[288];
+        uint8_t literal_length[288];
+        uint16_t distance[30];
+        uint8_t length_symbol[kMaxMatch + 1];
+        // distances up to 256 directly, larger ones by (distance - 1) >> 7, like zlib does
+        uint8_t distance_symbol[512];
+
+        FixedCodes() {
+            for (int symbol = 0; symbol < 288; ++symbol) {
+                uint32_t code;
+                int length;
+                if (symbol < 144) {
+                    code = 0x30 + symbol;
+                    length = 8;
+                } else if (symbol < 256) {
+                    code = 0x190 + symbol - 144;
+                    length = 9;
+                } else if (symbol < 280) {
+                    code = symbol - 256;
+                    length = 7;
+                } else {
+                    code = 0xC0 + symbol - 280;
+                    length = 8;
+                }
+                literal[symbol] = static_cast<uint16_t>(reverse_bits(code, length));
+                literal_length[symbol] = static_cast<uint8_t>(length);
+            }
+            for (int symbol = 0; symbol < 30; ++symbol) {
+                distance[symbol] = static_cast<uint16_t>(reverse_bits(symbol, 5));
+            }
+            for (int length = kMinMatch; length <= kMaxMatch; ++length) {
+                int symbol = 28;
+                while (kLengthBase[symbol] > length) {
+                    --symbol;
+                }
+                length_symbol[length] = static_cast<uint8_t>(symbol);
+            }
+            for (int d = 1; d <= 32768; ++d) {
+                int symbol = 29;
+                while (kDistanceBase[symbol] > d) {
+                    --symbol;
+                }
+                distance_symbol[d <= 256 ? d - 1 : 256 + ((d - 1) >> 7)] = static_cast<uint8_t>(symbol);
+            }
+        }
+    };
+
+    class BitWriter {
+    public:
+        explicit BitWriter(std::vector<unsigned char>& out) : out_(out) {}
+
+        void put(uint32_t bits, int count) {
+            buffer_ |= static_cast<uint64_t>(bits) << count_;
+            count_ += count;
+            while (count_ >= 8) {
+                out_.push_back(static_cast<unsigned char>(buffer_));
+                buffer_ >>= 8;
+                count_ -= 8;
+            }
+        }
+
+        void align() {
+            if (count_ > 0) {
+                put(0, 8 - count_);
+            }
+        }
+
+    private:
+        std::vector<unsigned char>& out_;
+        uint64_t buffer_ = 0;
+        int count_ = 0;
+    };
+
+    // one final block with the fixed codes, greedy matching against the last position with the same 4 bytes
+    void deflate_fixed(const unsigned char* data, size_t size, std::vector<unsigned char>& out) {
+        static const FixedCodes codes;
+        BitWriter bits(out);
+        // bfinal, btype 01
+        bits.put(1, 1);
+        bits.put(1, 2);
+        // positions + 1, 0 is empty
+        std::vector<uint32_t> head(size_t(1) << kHashBits, 0);
+        auto hash = [&](size_t pos) {
+            uint32_t word;
+            std::memcpy(&word, data + pos, 4);
+            return (word * 2654435761u) >> (32 - kHashBits);
+        };
+        size_t pos = 0;
+        while (pos < size) {
+            int best = 0;
+            size_t distance = 0;
+            if (pos + kMinMatch <= size) {
+                uint32_t& slot = head[hash(pos)];
+                size_t candidate = slot;
+                slot = static_cast<uint32_t>(pos + 1);
+                if (candidate && pos - (candidate - 1) <= kWindow) {
+                    const unsigned char* a = data + candidate - 1;
+                    const unsigned char* b = data + pos;
+                    int limit = static_cast<int>(std::min<size_t>(kMaxMatch, size - pos));
+                    int length = 0;
+                    while (length < limit && a[length] == b[length]) {
+                        ++length;
+                    }
+                    if (length >= kMinMatch) {
+                        best = length;
+                        distance = pos - (candidate - 1);
+                    }
+                }
+            }
+            if (best == 0) {
+                bits.put(codes.literal[data[pos]], codes.literal_length[data[pos]]);
+                ++pos;
+                continue;
+            }
+            int length_symbol = codes.length_symbol[best];
+            bits.put(codes.literal[257 + length_symbol], codes.literal_length[257 + length_symbol]);
+            bits.put(best - kLengthBase[length_symbol], kLengthExtra[length_symbol]);
+            int distance_symbol = codes.distance_symbol[distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7)];
+            bits.put(codes.distance[distance_symbol], 5);
+            bits.put(static_cast<uint32_t>(distance - kDistanceBase[distance_symbol]), kDistanceExtra[distance_symbol]);
+            // later matches may start anywhere inside this one
+            for (size_t end = std::min(pos + best, size - kMinMatch + 1), at = pos + 1; at < end; ++at) {
+                head[hash(at)] = static_cast<uint32_t>(at + 1);
+            }
+            pos += best;
+        }
+        // end of block
+        bits.put(codes.literal[256], codes.literal_length[256]);
+        bits.align();
+    }
+
+    uint32_t adler32(const unsigned char* data, size_t size) {
+        uint32_t a = 1;
+        uint32_t b = 0;
+        while (size > 0) {
+            // the largest run before b could overflow
+            size_t run = std::min<size_t>(size, 5552);
+            size -= run;
+            while (run--) {
+                a += *data++;
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        return (b << 16) | a;
+    }
+
+    uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0) {
+        static const struct Table {
+            uint32_t entries[256];
+            Table() {
+                for (uint32_t i = 0; i < 256; ++i) {
+                    uint32_t c = i;
+                    for (int k = 0; k < 8; ++k) {
+                        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    }
+                    entries[i] = c;
+                }
+            }
+        } table;
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i) {
+            crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    void put_u32(std::vector<unsigned char>& out, uint32_t value) {
+        out.push_back(static_cast<unsigned char>(value >> 24));
+        out.push_back(static_cast<unsigned char>(value >> 16));
+        out.push_back(static_cast<unsigned char>(value >> 8));
+        out.push_back(static_cast<unsigned char>(value));
+    }
+
+    void put_chunk(std::vector<unsigned char>& out, const char* type, const unsigned char* data, size_t size) {
+        put_u32(out, static_cast<uint32_t>(size));
+        size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data, data + size);
+        put_u32(out, crc32(out.data() + start, size + 4));
+    }
+}
+
+void encode_png(int width, int height, const unsigned char* rgba, std::vector<unsigned char>& png) {
+    const size_t row = size_t(width) * 3;
+    // every row is its filter type followed by the filtered rgb bytes
+    std::vector<unsigned char> filtered((row + 1) * height);
+    std::vector<unsigned char> rows[2] = { std::vector<unsigned char>(row, 0), std::vector<unsigned char>(row) };
+    std::vector<unsigned char> sub(row);
+    std::vector<unsigned char> up(row);
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* source = rgba + size_t(y) * width * 4;
+        std::vector<unsigned char>& current = rows[(y + 1) & 1];
+        const std::vector<unsigned char>& previous = rows[y & 1];
+        for (int x = 0; x < width; ++x) {
+            std::memcpy(&current[x * 3], source + x * 4, 3);
+        }
+        // pick the filter with the smallest sum of bytes taken as signed, the usual heuristic
+        unsigned int sub_cost = 0;
+        unsigned int up_cost = 0;
+        for (size_t i = 0; i < row; ++i) {
+            sub[i] = static_cast<unsigned char>(current[i] - (i >= 3 ? current[i - 3] : 0));
+            up[i] = static_cast<unsigned char>(current[i] - previous[i]);
+            sub_cost += std::abs(static_cast<signed char>(sub[i]));
+            up_cost += std::abs(static_cast<signed char>(up[i]));
+        }
+        unsigned char* out = &filtered[(row + 1) * y];
+        bool use_up = up_cost < sub_cost;
+        out[0] = use_up ? 2 : 1;
+        std::memcpy(out + 1, use_up ? up.data() : sub.data(), row);
+    }
+
+    png.clear();
+    const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    png.insert(png.end(), signature, signature + 8);
+    std::vector<unsigned char> header;
+    put_u32(header, static_cast<uint32_t>(width));
+    put_u32(header, static_cast<uint32_t>(height));
+    // 8 bits, rgb, deflate, adaptive filtering, not interlaced
+    const unsigned char format[5] = { 8, 2, 0, 0, 0 };
+    header.insert(header.end(), format, format + 5);
+    put_chunk(png, "IHDR", header.data(), header.size());
+
+    // zlib stream: 32k window deflate, no dictionary, the check bits make the header a multiple of 31
+    std::vector<unsigned char> zlib = { 0x78, 0x01 };
+    zlib.reserve(filtered.size() / 4);
+    deflate_fixed(filtered.data(), filtered.size(), zlib);
+    put_u32(zlib, adler32(filtered.data(), filtered.size()));
+    put_chunk(png, "IDAT", zlib.data(), zlib.size());
+    put_chunk(png, "IEND", nullptr, 0);
+}
+
+bool write_png(const std::string& path, int width, int height, const unsigned char* rgba) {
+    std::vector<unsigned char> png;
+    encode_png(width, height, rgba, png);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(png.data()), png.size());
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// rgb png from rgba with the top row first, alpha is dropped
+// meant for rendered frames: each row gets the sub or up filter, whichever leaves smaller values, and deflate
+// uses the fixed huffman codes with one match candidate per position. flat areas and repeated rows, most of
+// what we render, shrink to almost nothing, and it's fast enough to keep up with a capture thread
+void encode_png(int width, int height, const unsigned char* rgba, std::vector<unsigned char>& png);
+bool write_png(const std::string& path, int width, int height, const unsigned char* rgba);
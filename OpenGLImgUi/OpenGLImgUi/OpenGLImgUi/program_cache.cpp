@@ -0,0 +1,132 @@
+#include "program_cache.h"
+#include "hash.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace {
+    // every cache file starts with this header, followed by blob_size bytes of program binary
+    struct CacheEntryHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t binary_format;
+        uint32_t blob_size;
+    };
+    const uint32_t kCacheMagic = 0x43424750; // "PGBC"
+    const uint32_t kCacheVersion = 1;
+
+    std::string gl_string(GLenum name) {
+        const char* str = reinterpret_cast<const char*>(glGetString(name));
+        return str ? str : "";
+    }
+}
+
+ProgramCache::ProgramCache(const std::string& directory) : directory_(directory) {
+    // program binaries are core since 4.1, older contexts just run without the cache
+    int binary_formats = 0;
+    if (GLAD_GL_VERSION_4_1) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binary_formats);
+    }
+    if (binary_formats == 0) {
+        std::cout << "program cache: driver exposes no program binary formats, cache disabled" << std::endl;
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory_, error);
+    if (error) {
+        std::cout << "program cache: can't create " << directory_ << ": " << error.message() << std::endl;
+        return;
+    }
+
+    // binaries are only valid for the exact driver that produced them
+    driver_hash_ = hash_string(gl_string(GL_VENDOR));
+    driver_hash_ = hash_string(gl_string(GL_RENDERER), driver_hash_);
+    driver_hash_ = hash_string(gl_string(GL_VERSION), driver_hash_);
+    driver_hash_ = hash_string(gl_string(GL_SHADING_LANGUAGE_VERSION), driver_hash_);
+    enabled_ = true;
+}
+
+uint64_t ProgramCache::program_key(std::initializer_list<std::string_view> sources) const {
+    uint64_t key = driver_hash_;
+    for (std::string_view source : sources) {
+        key = hash_string(source, key);
+    }
+    return key;
+}
+
+std::string ProgramCache::entry_path(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return directory_ + "/" + name;
+}
+
+bool ProgramCache::load(uint64_t key, unsigned int program) {
+    if (!enabled_) {
+        ++misses_;
+        return false;
+    }
+
+    std::ifstream file(entry_path(key), std::ios::binary);
+    CacheEntryHeader header = {};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != kCacheMagic || header.version != kCacheVersion || header.blob_size == 0) {
+        ++misses_;
+        return false;
+    }
+    std::vector<char> blob(header.blob_size);
+    if (!file.read(blob.data(), blob.size())) {
+        ++misses_;
+        return false;
+    }
+
+    glProgramBinary(program, header.binary_format, blob.data(), static_cast<GLsizei>(blob.size()));
+    // the driver is allowed to reject a binary at any time (e.g. after an update that kept the version string)
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        std::cout << "program cache: driver rejected " << entry_path(key) << ", recompiling" << std::endl;
+        ++misses_;
+        return false;
+    }
+    ++hits_;
+    return true;
+}
+
+void ProgramCache::store(uint64_t key, unsigned int program) {
+    if (!enabled_) {
+        return;
+    }
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (!success || length <= 0) {
+        return;
+    }
+
+    std::vector<char> blob(length);
+    GLenum binary_format = 0;
+    glGetProgramBinary(program, length, nullptr, &binary_format, blob.data());
+
+    CacheEntryHeader header = { kCacheMagic, kCacheVersion, binary_format, static_cast<uint32_t>(length) };
+    // write to a temporary file first so a crash mid write never leaves a truncated entry behind
+    const std::string path = entry_path(key);
+    const std::string temp_path = path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(blob.data(), blob.size());
+        if (!file) {
+            std::cout << "program cache: failed writing " << temp_path << std::endl;
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+    if (error) {
+        std::cout << "program cache: failed writing " << path << ": " << error.message() << std::endl;
+    }
+}
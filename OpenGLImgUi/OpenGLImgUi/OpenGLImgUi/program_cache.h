@@ -0,0 +1,40 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+
+// on disk cache of linked program binaries (glGetProgramBinary / glProgramBinary)
+// entries are keyed by the shader sources together with the vendor/renderer/version strings,
+// so a driver update or a shader edit simply misses the cache instead of loading a stale binary
+class ProgramCache {
+public:
+    explicit ProgramCache(const std::string& directory);
+
+    // false when the context can't hand out program binaries, every load then misses
+    bool enabled() const { return enabled_; }
+
+    // key for a program built from the given sources, order matters (vertex first, then fragment)
+    uint64_t program_key(std::initializer_list<std::string_view> sources) const;
+
+    // try to fill program from the cache, returns false on a miss or when the driver rejects the binary,
+    // in that case the caller should compile and link as usual and call store afterwards
+    bool load(uint64_t key, unsigned int program);
+
+    // write the binary of a successfully linked program, the program should have been linked
+    // with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+    void store(uint64_t key, unsigned int program);
+
+    unsigned int hits() const { return hits_; }
+    unsigned int misses() const { return misses_; }
+
+private:
+    std::string entry_path(uint64_t key) const;
+
+    std::string directory_;
+    uint64_t driver_hash_ = 0;
+    bool enabled_ = false;
+    unsigned int hits_ = 0;
+    unsigned int misses_ = 0;
+};
@@ -0,0 +1,109 @@
+#include "range_allocator.h"
+#include <iterator>
+
+RangeAllocator::RangeAllocator(uint32_t capacity) {
+    reset(capacity);
+}
+
+void RangeAllocator::reset(uint32_t capacity) {
+    capacity_ = capacity;
+    used_ = 0;
+    by_offset_.clear();
+    by_size_.clear();
+    allocations_.clear();
+    if (capacity > 0) {
+        insert_free(0, capacity);
+    }
+}
+
+void RangeAllocator::insert_free(uint32_t offset, uint32_t size) {
+    by_offset_[offset] = size;
+    by_size_.emplace(size, offset);
+}
+
+void RangeAllocator::erase_free(std::map<uint32_t, uint32_t>::iterator range) {
+    auto sizes = by_size_.equal_range(range->second);
+    for (auto it = sizes.first; it != sizes.second; ++it) {
+        if (it->second == range->first) {
+            by_size_.erase(it);
+            break;
+        }
+    }
+    by_offset_.erase(range);
+}
+
+uint32_t RangeAllocator::allocate(uint32_t size) {
+    if (size == 0) {
+        return kInvalid;
+    }
+    auto best = by_size_.lower_bound(size);
+    if (best == by_size_.end()) {
+        return kInvalid;
+    }
+    uint32_t offset = best->second;
+    uint32_t free_size = best->first;
+    by_size_.erase(best);
+    by_offset_.erase(offset);
+    // whatever is left of the range stays free
+    if (free_size > size) {
+        insert_free(offset + size, free_size - size);
+    }
+    allocations_[offset] = size;
+    used_ += size;
+    return offset;
+}
+
+void RangeAllocator::free(uint32_t offset) {
+    auto allocation = allocations_.find(offset);
+    if (allocation == allocations_.end()) {
+        return;
+    }
+    uint32_t size = allocation->second;
+    allocations_.erase(allocation);
+    used_ -= size;
+
+    // merge with the free ranges right after and right before
+    auto next = by_offset_.lower_bound(offset);
+    if (next != by_offset_.end() && next->first == offset + size) {
+        size += next->second;
+        erase_free(next);
+        next = by_offset_.lower_bound(offset);
+    }
+    if (next != by_offset_.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            erase_free(previous);
+        }
+    }
+    insert_free(offset, size);
+}
+
+uint32_t RangeAllocator::allocation_size(uint32_t offset) const {
+    auto allocation = allocations_.find(offset);
+    return allocation != allocations_.end() ? allocation->second : 0;
+}
+
+void RangeAllocator::grow(uint32_t capacity) {
+    if (capacity <= capacity_) {
+        return;
+    }
+    uint32_t extra = capacity - capacity_;
+    uint32_t offset = capacity_;
+    capacity_ = capacity;
+    // extend a free range touching the old end instead of starting a new one
+    if (!by_offset_.empty()) {
+        auto last = std::prev(by_offset_.end());
+        if (last->first + last->second == offset) {
+            offset = last->first;
+            extra += last->second;
+            erase_free(last);
+        }
+    }
+    insert_free(offset, extra);
+}
+
+uint32_t RangeAllocator::largest_free() const {
+    return by_size_.empty() ? 0 : std::prev(by_size_.end())->first;
+}
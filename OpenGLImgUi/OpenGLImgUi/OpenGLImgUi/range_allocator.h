@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+// hands out [offset, offset + size) ranges of a fixed capacity, used to carve meshes out of one big buffer
+// free ranges are kept sorted by offset (so freeing merges with the neighbours right away) and by size
+// (so allocating picks the smallest range that fits), both in O(log n)
+class RangeAllocator {
+public:
+    static const uint32_t kInvalid = 0xFFFFFFFFu;
+
+    explicit RangeAllocator(uint32_t capacity = 0);
+
+    // kInvalid if no free range is big enough, defragmenting or growing may help
+    uint32_t allocate(uint32_t size);
+    void free(uint32_t offset);
+    // size of an allocation, 0 if offset isn't one
+    uint32_t allocation_size(uint32_t offset) const;
+
+    // more room at the end, everything allocated stays where it is
+    void grow(uint32_t capacity);
+    // forget everything, used after the owner compacted the buffer itself
+    void reset(uint32_t capacity);
+
+    uint32_t capacity() const { return capacity_; }
+    uint32_t used() const { return used_; }
+    uint32_t largest_free() const;
+    size_t free_range_count() const { return by_offset_.size(); }
+    const std::map<uint32_t, uint32_t>& allocations() const { return allocations_; }
+
+private:
+    void insert_free(uint32_t offset, uint32_t size);
+    void erase_free(std::map<uint32_t, uint32_t>::iterator range);
+
+    uint32_t capacity_ = 0;
+    uint32_t used_ = 0;
+    // offset -> size of every free range
+    std::map<uint32_t, uint32_t> by_offset_;
+    // size -> offset, the same ranges for best fit lookups
+    std::multimap<uint32_t, uint32_t> by_size_;
+    // offset -> size of every allocation
+    std::map<uint32_t, uint32_t> allocations_;
+};
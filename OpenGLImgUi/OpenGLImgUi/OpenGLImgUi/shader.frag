@@ -0,0 +1,30 @@
+#version 330 core
+#ifdef USE_BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
+out vec4 FragColor;
+#ifdef USE_VERTEX_COLOR
+in vec4 vertexColor;
+#else
+uniform vec4 uColor;
+#endif
+#ifdef USE_ATLAS
+#ifdef USE_BINDLESS
+layout (bindless_sampler) uniform sampler2DArray uAtlas;
+#else
+uniform sampler2DArray uAtlas;
+#endif
+in vec3 atlasCoord;
+#endif
+
+void main()
+{
+#ifdef USE_VERTEX_COLOR
+    FragColor = vertexColor;
+#else
+    FragColor = uColor;
+#endif
+#ifdef USE_ATLAS
+    FragColor *= texture(uAtlas, atlasCoord);
+#endif
+} 
\ No newline at end of file
@@ -1,10 +1,49 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
+#ifdef USE_BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
+// attribute declarations and decoding for the mesh's vertex layout
+#include "vertex_layout.glsl"
+#ifdef USE_INSTANCING
+// per instance, see InstanceData
+layout (location = 4) in vec4 aTranslationScale;
+layout (location = 5) in vec4 aInstanceColor;
+layout (location = 6) in float aRotation;
+layout (location = 7) in uint aUserData;
+// the stress test's camera, GpuCuller culls with the same one
+uniform mat4 uViewProjection;
+#endif
+#ifdef USE_ATLAS
+// two texels per region, uv offset and scale, then the layer, see TextureAtlas. the instance's user data picks it
+#ifdef USE_BINDLESS
+layout (bindless_sampler) uniform samplerBuffer uAtlasRegions;
+#else
+uniform samplerBuffer uAtlasRegions;
+#endif
+out vec3 atlasCoord;
+#endif
 
 out vec4 vertexColor;
 
 void main()
 {
+    vec3 aPos = vertex_position();
+#ifdef USE_INSTANCING
+    float s = sin(aRotation);
+    float c = cos(aRotation);
+    vec2 rotated = vec2(c * aPos.x - s * aPos.y, s * aPos.x + c * aPos.y);
+    vec3 position = vec3(rotated * aTranslationScale.w, aPos.z) + aTranslationScale.xyz;
+    gl_Position = uViewProjection * vec4(position, 1.0f);
+    vertexColor = aInstanceColor;
+#ifdef USE_ATLAS
+    // the quad's corners are at +-0.5, the image's first row is its top
+    vec2 uv = vec2(aPos.x + 0.5, 0.5 - aPos.y);
+    vec4 region = texelFetch(uAtlasRegions, int(aUserData) * 2);
+    float layer = texelFetch(uAtlasRegions, int(aUserData) * 2 + 1).x;
+    atlasCoord = vec3(region.xy + uv * region.zw, layer);
+#endif
+#else
     gl_Position = vec4(aPos.x, aPos.y, aPos.z, 2.0f);
 	vertexColor = vec4(0.3f, 0.3f, 0.3f, 1.0f);
+#endif
 }
\ No newline at end of file
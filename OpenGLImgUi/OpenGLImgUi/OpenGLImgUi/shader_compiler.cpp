@@ -0,0 +1,372 @@
+#include "shader_compiler.h"
+#include "gl_extensions.h"
+#include "hash.h"
+#include "program_cache.h"
+#include "uniform_table.h"
+#include <algorithm>
+#include <iostream>
+
+// GL_KHR_parallel_shader_compile and GL_ARB_parallel_shader_compile share the enum values
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+bool check_errors(unsigned int obj_int, IntType type) {
+    // check if the shader loading failed
+    int  success = 1;
+    char infoLog[512];
+    switch (type) {
+        case IntType::kShader:
+            glGetShaderiv(obj_int, GL_COMPILE_STATUS, &success);
+            if (!success) {
+                glGetShaderInfoLog(obj_int, 512, NULL, infoLog);
+                std::cout << "ERROR::SHADER:COMPILATION_FAILED\n" << infoLog << std::endl;
+            }
+            break;
+
+        case IntType::kProgram:
+            glGetProgramiv(obj_int, GL_LINK_STATUS, &success);
+            if (!success) {
+                glGetProgramInfoLog(obj_int, 512, NULL, infoLog);
+                std::cout << "ERROR::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+            }
+            break;
+        default:
+            break;
+    }
+    return success != 0;
+}
+
+ShaderCompiler::ShaderCompiler(GLFWwindow* main_window, ProgramCache& cache) : cache_(cache) {
+    // best case, the driver does the threading for us
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC max_compiler_threads = nullptr;
+    if (has_gl_extension("GL_KHR_parallel_shader_compile")) {
+        max_compiler_threads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(get_gl_proc("glMaxShaderCompilerThreadsKHR"));
+    } else if (has_gl_extension("GL_ARB_parallel_shader_compile")) {
+        max_compiler_threads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(get_gl_proc("glMaxShaderCompilerThreadsARB"));
+    }
+    if (max_compiler_threads) {
+        // 0xFFFFFFFF lets the implementation pick the thread count
+        max_compiler_threads(0xFFFFFFFF);
+        mode_ = kParallelExtension;
+        return;
+    }
+
+    // otherwise compile on our own threads, every one of them needs a context that shares objects with ours
+    // glfw only creates windows on the main thread, so the contexts are made here and handed to the workers
+    if (main_window != nullptr) {
+        unsigned int worker_count = std::max(1u, std::min(4u, std::thread::hardware_concurrency() - 1));
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        for (unsigned int i = 0; i < worker_count; ++i) {
+            GLFWwindow* context = glfwCreateWindow(1, 1, "shader compiler", nullptr, main_window);
+            if (context == nullptr) {
+                break;
+            }
+            worker_contexts_.push_back(context);
+        }
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    }
+    if (worker_contexts_.empty()) {
+        mode_ = kSerial;
+        return;
+    }
+    mode_ = kWorkerThreads;
+    for (GLFWwindow* context : worker_contexts_) {
+        workers_.emplace_back(&ShaderCompiler::worker_main, this, context);
+    }
+}
+
+ShaderCompiler::~ShaderCompiler() {
+    shutdown();
+}
+
+void ShaderCompiler::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        stopping_ = true;
+    }
+    queue_cv_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+    for (GLFWwindow* context : worker_contexts_) {
+        glfwDestroyWindow(context);
+    }
+    worker_contexts_.clear();
+}
+
+uint64_t ShaderCompiler::stage_key(GLenum type, std::string_view source) {
+    return hash_string(source, hash_bytes(&type, sizeof(type)));
+}
+
+ShaderCompiler::ShaderJob* ShaderCompiler::submit_shader(GLenum type, std::string_view source) {
+    uint64_t key = stage_key(type, source);
+    auto found = shaders_.find(key);
+    if (found != shaders_.end()) {
+        return found->second.get();
+    }
+    std::unique_ptr<ShaderJob> job(new ShaderJob());
+    job->key = key;
+    job->type = type;
+    job->source = source;
+    ShaderJob* result = job.get();
+    shaders_[key] = std::move(job);
+
+    switch (mode_) {
+        case kWorkerThreads:
+            enqueue({ result, nullptr });
+            break;
+        default:
+            // the extension makes glCompileShader return right away, serial mode just blocks here
+            compile(*result);
+            result->done = true;
+            break;
+    }
+    return result;
+}
+
+unsigned int ShaderCompiler::submit_program(std::string_view vertex_source, std::string_view fragment_source) {
+    return submit(cache_.program_key({ vertex_source, fragment_source }), GL_VERTEX_SHADER, vertex_source, GL_FRAGMENT_SHADER,
+                  fragment_source);
+}
+
+unsigned int ShaderCompiler::submit_compute_program(std::string_view compute_source) {
+    return submit(cache_.program_key({ compute_source }), GL_COMPUTE_SHADER, compute_source, 0, std::string_view());
+}
+
+unsigned int ShaderCompiler::submit(uint64_t cache_key, GLenum first_type, std::string_view first_source, GLenum second_type,
+                                    std::string_view second_source) {
+    std::unique_ptr<ProgramJob> job(new ProgramJob());
+    job->program = glCreateProgram();
+    job->cache_key = cache_key;
+    unsigned int program = job->program;
+
+    // a cache hit is linked already, nothing left to schedule
+    if (cache_.load(job->cache_key, program)) {
+        job->linked = true;
+        job->finalized = true;
+        job->done = true;
+        programs_[program] = std::move(job);
+        return program;
+    }
+
+    job->stages[0] = submit_shader(first_type, first_source);
+    job->stages[0]->users++;
+    if (!second_source.empty()) {
+        job->stages[1] = submit_shader(second_type, second_source);
+        job->stages[1]->users++;
+    }
+    ProgramJob* result = job.get();
+    programs_[program] = std::move(job);
+    ++pending_;
+
+    switch (mode_) {
+        case kWorkerThreads:
+            // stages were queued before this, so a worker picking up the link never waits on a job nobody took
+            enqueue({ nullptr, result });
+            break;
+        default:
+            link(*result);
+            result->done = true;
+            break;
+    }
+    return program;
+}
+
+void ShaderCompiler::compile(ShaderJob& job) {
+    job.shader = glCreateShader(job.type);
+    const char* source_data = job.source.data();
+    GLint source_length = static_cast<GLint>(job.source.size());
+    glShaderSource(job.shader, 1, &source_data, &source_length);
+    glCompileShader(job.shader);
+    // the driver copied the source, the caller is free to drop it from here on
+    job.source = std::string_view();
+}
+
+void ShaderCompiler::link(ProgramJob& job) {
+    // ask the driver to keep the binary around so we can cache it
+    glProgramParameteri(job.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    for (ShaderJob* stage : job.stages) {
+        if (stage) {
+            glAttachShader(job.program, stage->shader);
+        }
+    }
+    glLinkProgram(job.program);
+}
+
+void ShaderCompiler::finalize(ProgramJob& job) {
+    if (job.finalized) {
+        return;
+    }
+    // the status queries below block until the driver is done, by now it should be
+    for (ShaderJob*& stage : job.stages) {
+        if (stage && !stage->checked) {
+            check_errors(stage->shader, IntType::kShader);
+            stage->checked = true;
+        }
+    }
+    job.linked = check_errors(job.program, IntType::kProgram);
+    if (job.linked) {
+        cache_.store(job.cache_key, job.program);
+        if (job.uniforms) {
+            job.uniforms->reflect(job.program);
+        }
+    }
+
+    // delete the shaders once every program using them is linked
+    for (ShaderJob*& stage : job.stages) {
+        if (!stage) {
+            continue;
+        }
+        glDetachShader(job.program, stage->shader);
+        if (--stage->users == 0 && (!keep_stages_ || stage->discarded)) {
+            glDeleteShader(stage->shader);
+            shaders_.erase(stage->key);
+        }
+        stage = nullptr;
+    }
+    job.finalized = true;
+    --pending_;
+}
+
+void ShaderCompiler::release(unsigned int program) {
+    auto found = programs_.find(program);
+    if (found == programs_.end() || !found->second->finalized) {
+        return;
+    }
+    glDeleteProgram(program);
+    programs_.erase(found);
+}
+
+void ShaderCompiler::reflect_uniforms(unsigned int program, UniformTable* table) {
+    auto found = programs_.find(program);
+    if (found == programs_.end()) {
+        return;
+    }
+    ProgramJob& job = *found->second;
+    job.uniforms = table;
+    if (job.finalized && job.linked && table) {
+        table->reflect(program);
+    }
+}
+
+UniformTable* ShaderCompiler::uniform_table(unsigned int program) const {
+    auto found = programs_.find(program);
+    return found == programs_.end() ? nullptr : found->second->uniforms;
+}
+
+void ShaderCompiler::discard_stage(GLenum type, std::string_view source) {
+    auto found = shaders_.find(stage_key(type, source));
+    if (found == shaders_.end()) {
+        return;
+    }
+    ShaderJob& stage = *found->second;
+    if (stage.users == 0) {
+        glDeleteShader(stage.shader);
+        shaders_.erase(found);
+    } else {
+        // still compiling or waiting to be linked, finalize deletes it
+        stage.discarded = true;
+    }
+}
+
+void ShaderCompiler::poll() {
+    if (pending_ == 0) {
+        return;
+    }
+    for (auto& entry : programs_) {
+        if (!entry.second->finalized && ready(entry.first)) {
+            finalize(*entry.second);
+        }
+    }
+}
+
+bool ShaderCompiler::ready(unsigned int program) {
+    auto found = programs_.find(program);
+    if (found == programs_.end()) {
+        return false;
+    }
+    ProgramJob& job = *found->second;
+    if (job.finalized) {
+        return true;
+    }
+    switch (mode_) {
+        case kParallelExtension: {
+            int completed = 0;
+            glGetProgramiv(job.program, GL_COMPLETION_STATUS_KHR, &completed);
+            return completed != 0;
+        }
+        default:
+            return job.done.load(std::memory_order_acquire);
+    }
+}
+
+bool ShaderCompiler::wait(unsigned int program) {
+    auto found = programs_.find(program);
+    if (found == programs_.end()) {
+        return false;
+    }
+    ProgramJob& job = *found->second;
+    if (!job.finalized) {
+        if (mode_ == kWorkerThreads) {
+            wait_done(job.done);
+        }
+        // with the extension the status query in finalize is what blocks
+        finalize(job);
+    }
+    return job.linked;
+}
+
+void ShaderCompiler::enqueue(WorkItem item) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        queue_.push_back(item);
+    }
+    queue_cv_.notify_one();
+}
+
+void ShaderCompiler::wait_done(const std::atomic<bool>& done) {
+    std::unique_lock<std::mutex> lock(done_mutex_);
+    done_cv_.wait(lock, [&done] { return done.load(std::memory_order_acquire); });
+}
+
+void ShaderCompiler::worker_main(GLFWwindow* context) {
+    glfwMakeContextCurrent(context);
+    for (;;) {
+        WorkItem item;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            queue_cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                break;
+            }
+            item = queue_.front();
+            queue_.pop_front();
+        }
+
+        std::atomic<bool>* done;
+        if (item.shader) {
+            compile(*item.shader);
+            done = &item.shader->done;
+        } else {
+            // the stages may still be compiling on another worker
+            for (ShaderJob* stage : item.program->stages) {
+                if (stage) {
+                    wait_done(stage->done);
+                }
+            }
+            link(*item.program);
+            done = &item.program->done;
+        }
+        // objects changed in one context are only guaranteed to be visible in another once the commands finished
+        glFinish();
+        {
+            std::lock_guard<std::mutex> lock(done_mutex_);
+            done->store(true, std::memory_order_release);
+        }
+        done_cv_.notify_all();
+    }
+    glfwMakeContextCurrent(nullptr);
+}
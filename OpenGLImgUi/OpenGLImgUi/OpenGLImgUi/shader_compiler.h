@@ -0,0 +1,144 @@
+#pragma once
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class ProgramCache;
+class UniformTable;
+
+enum IntType {
+    kShader,
+    kProgram
+};
+// print the info log if a shader failed to compile or a program failed to link, returns false on failure
+// note: this blocks until the driver is done with the object, so only call it once compilation completed
+bool check_errors(unsigned int item, IntType type);
+
+// compiles and links programs without blocking the caller
+// everything is submitted up front, compiles overlap with each other (and with whatever the caller
+// does meanwhile) and we only block when a program is needed for a draw
+//  - kParallelExtension: GL_KHR/ARB_parallel_shader_compile, the driver compiles on its own threads
+//    and we poll GL_COMPLETION_STATUS
+//  - kWorkerThreads: our own threads, each with a hidden window whose context shares objects with the main one
+//  - kSerial: neither is available, compile right away like we used to
+class ShaderCompiler {
+public:
+    enum Mode {
+        kParallelExtension,
+        kWorkerThreads,
+        kSerial
+    };
+
+    // main_window is the window whose context is current on this thread, worker contexts share with it
+    // the cache is consulted before compiling anything, freshly linked programs are written back to it
+    ShaderCompiler(GLFWwindow* main_window, ProgramCache& cache);
+    ~ShaderCompiler();
+
+    // joins the workers and destroys their contexts, has to run before glfwTerminate
+    void shutdown();
+
+    Mode mode() const { return mode_; }
+
+    // returns the program object right away, it is usable once ready() is true or after wait()
+    // identical stage sources are only compiled once, no matter how many programs use them
+    // the sources are not copied, they have to stay alive until the program is ready
+    unsigned int submit_program(std::string_view vertex_source, std::string_view fragment_source);
+    // the same for a compute program (4.3 or ARB_compute_shader)
+    unsigned int submit_compute_program(std::string_view compute_source);
+
+    // non-blocking, finishes (error checks, cache writes) every program that completed since the last call
+    void poll();
+
+    bool ready(unsigned int program);
+
+    // block until the program is linked, call right before its first draw
+    // returns false if compilation or linking failed
+    bool wait(unsigned int program);
+
+    // true once every submitted program completed
+    bool idle() const { return pending_ == 0; }
+
+    // deletes the program object and forgets about it, it must not be pending anymore
+    void release(unsigned int program);
+
+    // the program's uniforms are reflected into table when it links (right away if it already did), so the
+    // frame loop never queries them. the hot reload hands the table on to the relinked program
+    void reflect_uniforms(unsigned int program, UniformTable* table);
+    // nullptr if nothing was registered for the program
+    UniformTable* uniform_table(unsigned int program) const;
+
+    // keep compiled stages around after linking, so relinking a program where only one stage changed
+    // doesn't compile the other one again. used by the hot reload, stages stay alive until discard_stage
+    void set_keep_stages(bool keep) { keep_stages_ = keep; }
+    void discard_stage(GLenum type, std::string_view source);
+
+private:
+    struct ShaderJob {
+        uint64_t key = 0;
+        GLenum type = 0;
+        std::string_view source;
+        unsigned int shader = 0;
+        // programs that still need this stage, the shader is deleted once it drops to 0
+        unsigned int users = 0;
+        bool checked = false;
+        // delete as soon as no program needs it, even with keep_stages_
+        bool discarded = false;
+        std::atomic<bool> done{ false };
+    };
+
+    struct ProgramJob {
+        unsigned int program = 0;
+        uint64_t cache_key = 0;
+        // the second one is null for compute programs
+        ShaderJob* stages[2] = { nullptr, nullptr };
+        bool finalized = false;
+        bool linked = false;
+        UniformTable* uniforms = nullptr;
+        std::atomic<bool> done{ false };
+    };
+
+    // a job is either a stage compile or a program link, whichever pointer is set
+    struct WorkItem {
+        ShaderJob* shader;
+        ProgramJob* program;
+    };
+
+    static uint64_t stage_key(GLenum type, std::string_view source);
+    ShaderJob* submit_shader(GLenum type, std::string_view source);
+    // second_source is empty for programs with one stage
+    unsigned int submit(uint64_t cache_key, GLenum first_type, std::string_view first_source, GLenum second_type,
+                        std::string_view second_source);
+    void compile(ShaderJob& job);
+    void link(ProgramJob& job);
+    void finalize(ProgramJob& job);
+    void enqueue(WorkItem item);
+    void worker_main(GLFWwindow* context);
+    void wait_done(const std::atomic<bool>& done);
+
+    ProgramCache& cache_;
+    Mode mode_ = kSerial;
+    unsigned int pending_ = 0;
+    bool keep_stages_ = false;
+    std::unordered_map<uint64_t, std::unique_ptr<ShaderJob>> shaders_;
+    std::unordered_map<unsigned int, std::unique_ptr<ProgramJob>> programs_;
+
+    // worker thread state, unused in the other modes
+    std::vector<GLFWwindow*> worker_contexts_;
+    std::vector<std::thread> workers_;
+    std::deque<WorkItem> queue_;
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::mutex done_mutex_;
+    std::condition_variable done_cv_;
+    bool stopping_ = false;
+};
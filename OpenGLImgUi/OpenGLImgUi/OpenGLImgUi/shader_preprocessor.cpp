@@ -0,0 +1,186 @@
+#include "shader_preprocessor.h"
+#include "asset_registry.h"
+#include "hash.h"
+#include <iostream>
+
+namespace {
+    const int kMaxIncludeDepth = 16;
+
+    std::string_view trim(std::string_view line) {
+        size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string_view::npos) {
+            return std::string_view();
+        }
+        size_t end = line.find_last_not_of(" \t\r");
+        return line.substr(begin, end - begin + 1);
+    }
+
+    bool starts_with(std::string_view str, std::string_view prefix) {
+        return str.substr(0, prefix.size()) == prefix;
+    }
+
+    // #line <line> <source string>, so compile errors point at the right file, the source string number
+    // is the index into the files list expand hands out
+    void append_line_directive(std::string& out, size_t line, size_t file_index) {
+        out += "#line " + std::to_string(line) + " " + std::to_string(file_index) + "\n";
+    }
+}
+
+ShaderPreprocessor::ShaderPreprocessor(AssetRegistry& sources) : sources_(sources) {
+}
+
+bool ShaderPreprocessor::file_source(const std::string& name, std::string_view& source) {
+    auto reloaded = reloaded_.find(name);
+    if (reloaded != reloaded_.end()) {
+        source = reloaded->second;
+        return true;
+    }
+    return sources_.require(name, source);
+}
+
+const ShaderVariant* ShaderPreprocessor::expand(const ShaderStage& stage, std::vector<std::string>* files) {
+    uint64_t request_key = hash_string(stage.file);
+    for (const std::string& define : stage.defines) {
+        request_key = hash_string(define, request_key);
+    }
+    auto found = requests_.find(request_key);
+    if (found != requests_.end()) {
+        if (files) {
+            *files = found->second.files;
+        }
+        return found->second.variant;
+    }
+
+    std::string source;
+    std::vector<std::string> used_files;
+    std::unordered_set<std::string> included;
+    if (!append_file(stage.file, &stage.defines, source, used_files, included, 0)) {
+        return nullptr;
+    }
+
+    uint64_t source_hash = hash_string(source);
+    std::unique_ptr<ShaderVariant>& variant = variants_[source_hash];
+    if (!variant) {
+        variant.reset(new ShaderVariant());
+        variant->source = std::move(source);
+        variant->hash = source_hash;
+    }
+    if (files) {
+        *files = used_files;
+    }
+    requests_[request_key] = { variant.get(), std::move(used_files) };
+    return variant.get();
+}
+
+bool ShaderPreprocessor::append_file(const std::string& name, const std::vector<std::string>* defines, std::string& out,
+                                     std::vector<std::string>& files, std::unordered_set<std::string>& included, int depth) {
+    // every file is pulled in once per expansion, which also breaks include cycles
+    if (!included.insert(name).second) {
+        return true;
+    }
+    if (depth > kMaxIncludeDepth) {
+        std::cout << "ERROR::SHADER::PREPROCESS " << name << ": includes nested too deep" << std::endl;
+        return false;
+    }
+    std::string_view source;
+    if (!file_source(name, source)) {
+        return false;
+    }
+    size_t file_index = files.size();
+    files.push_back(name);
+
+    // the defines go right after #version, which has to stay the first thing in the shader
+    std::string define_lines;
+    if (defines) {
+        for (const std::string& define : *defines) {
+            define_lines += "#define " + define + "\n";
+        }
+    }
+    bool has_version = source.find("#version") != std::string_view::npos;
+    if (!define_lines.empty() && !has_version) {
+        out += define_lines;
+        append_line_directive(out, 1, file_index);
+    }
+
+    size_t line_number = 1;
+    for (size_t begin = 0; begin < source.size(); ++line_number) {
+        size_t end = source.find('\n', begin);
+        if (end == std::string_view::npos) {
+            end = source.size();
+        }
+        std::string_view line = source.substr(begin, end - begin);
+        begin = end + 1;
+
+        std::string_view directive = trim(line);
+        if (starts_with(directive, "#include")) {
+            std::string_view target = trim(directive.substr(8));
+            if (target.size() < 2 || !((target.front() == '"' && target.back() == '"') || (target.front() == '<' && target.back() == '>'))) {
+                std::cout << "ERROR::SHADER::PREPROCESS " << name << "(" << line_number << "): malformed #include" << std::endl;
+                return false;
+            }
+            std::string include_name(target.substr(1, target.size() - 2));
+            if (included.count(include_name) != 0) {
+                // already pulled in, keep the line so the numbering below stays right
+                out += '\n';
+                continue;
+            }
+            size_t include_index = files.size();
+            append_line_directive(out, 1, include_index);
+            if (!append_file(include_name, nullptr, out, files, included, depth + 1)) {
+                std::cout << "  included from " << name << "(" << line_number << ")" << std::endl;
+                return false;
+            }
+            append_line_directive(out, line_number + 1, file_index);
+            continue;
+        }
+
+        out.append(line.data(), line.size());
+        out += '\n';
+        if (has_version && !define_lines.empty() && starts_with(directive, "#version")) {
+            out += define_lines;
+            append_line_directive(out, line_number + 1, file_index);
+            has_version = false;
+        }
+    }
+    return true;
+}
+
+bool ShaderPreprocessor::reload(const std::string& name, const std::string& path) {
+    MappedFile file;
+    std::string error;
+    if (!file.open(path, error)) {
+        std::cout << "ERROR::ASSET::" << error << std::endl;
+        return false;
+    }
+    // files that didn't exist at startup (a new include) aren't in the registry
+    std::string_view current;
+    bool known = reloaded_.count(name) != 0 || sources_.contains(name);
+    if (known && file_source(name, current) && current == file.view()) {
+        return false;
+    }
+    reloaded_[name] = std::string(file.view());
+    invalidate(name);
+    return true;
+}
+
+void ShaderPreprocessor::add_generated(const std::string& name, std::string source) {
+    reloaded_[name] = std::move(source);
+    invalidate(name);
+}
+
+void ShaderPreprocessor::invalidate(const std::string& name) {
+    // expansions that pulled in the file are stale now, the variants themselves stay alive since
+    // programs in flight may still be compiling them
+    for (auto request = requests_.begin(); request != requests_.end(); ) {
+        bool uses_file = false;
+        for (const std::string& used : request->second.files) {
+            uses_file = uses_file || used == name;
+        }
+        request = uses_file ? requests_.erase(request) : std::next(request);
+    }
+}
+
+void ShaderPreprocessor::print_stats() const {
+    std::cout << "shader variants: " << requests_.size() << " stage permutations requested, "
+              << variants_.size() << " unique sources to compile" << std::endl;
+}
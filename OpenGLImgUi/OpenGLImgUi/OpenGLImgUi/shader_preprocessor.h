@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class AssetRegistry;
+
+// a stage as we ask for it: the file plus the permutation defines, each "NAME" or "NAME VALUE"
+struct ShaderStage {
+    std::string file;
+    std::vector<std::string> defines;
+};
+
+// a fully expanded source, shared by every stage request that expands to the same text
+struct ShaderVariant {
+    std::string source;
+    uint64_t hash = 0;
+};
+
+// resolves #include "file" and injects the permutation defines right after #version
+// every expanded source is hashed, requests that end up with the same text get the same ShaderVariant,
+// and since the compiler keys stages by source those only compile once. variants live as long as the
+// preprocessor does, so their sources can go to the compiler without copying
+class ShaderPreprocessor {
+public:
+    explicit ShaderPreprocessor(AssetRegistry& sources);
+
+    // nullptr if the file or one of its includes is missing (the error is printed)
+    // files, if given, receives every file the variant was built from, the root first
+    const ShaderVariant* expand(const ShaderStage& stage, std::vector<std::string>* files = nullptr);
+
+    // replace the contents of a file with what is on disk now, returns false if it didn't change
+    // (or can't be read). expansions using the file are redone on their next expand
+    bool reload(const std::string& name, const std::string& path);
+    // a file that only exists in memory (e.g. glsl generated from a VertexLayout), it can be #included like
+    // any other and replaces an earlier one of the same name
+    void add_generated(const std::string& name, std::string source);
+
+    // how many stages were asked for vs how many distinct sources that needs compiled
+    size_t request_count() const { return requests_.size(); }
+    size_t variant_count() const { return variants_.size(); }
+    void print_stats() const;
+
+private:
+    struct Request {
+        const ShaderVariant* variant;
+        std::vector<std::string> files;
+    };
+
+    bool file_source(const std::string& name, std::string_view& source);
+    // drop the expansions that pulled in the file
+    void invalidate(const std::string& name);
+    // defines is only set for the root file
+    bool append_file(const std::string& name, const std::vector<std::string>* defines, std::string& out,
+                     std::vector<std::string>& files, std::unordered_set<std::string>& included, int depth);
+
+    AssetRegistry& sources_;
+    // files changed since startup and generated ones, they shadow the mapped originals in the registry
+    std::unordered_map<std::string, std::string> reloaded_;
+    // keyed by file + defines
+    std::unordered_map<uint64_t, Request> requests_;
+    // keyed by the hash of the expanded source
+    std::unordered_map<uint64_t, std::unique_ptr<ShaderVariant>> variants_;
+};
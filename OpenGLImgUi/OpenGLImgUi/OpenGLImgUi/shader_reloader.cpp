@@ -0,0 +1,116 @@
+#include "shader_reloader.h"
+#include "shader_compiler.h"
+#include <algorithm>
+#include <iostream>
+
+ShaderReloader::ShaderReloader(ShaderCompiler& compiler, ShaderPreprocessor& preprocessor, const std::string& directory)
+    : compiler_(compiler), preprocessor_(preprocessor), directory_(directory), watcher_(directory) {
+    compiler_.set_keep_stages(true);
+}
+
+bool ShaderReloader::expand(TrackedProgram& tracked, const ShaderVariant*& vertex_variant, const ShaderVariant*& fragment_variant) {
+    std::vector<std::string> vertex_files;
+    std::vector<std::string> fragment_files;
+    vertex_variant = preprocessor_.expand(tracked.vertex, &vertex_files);
+    fragment_variant = preprocessor_.expand(tracked.fragment, &fragment_files);
+    if (!vertex_variant || !fragment_variant) {
+        return false;
+    }
+    // an edit can add includes, those need watching too
+    tracked.files = vertex_files;
+    tracked.files.insert(tracked.files.end(), fragment_files.begin(), fragment_files.end());
+    for (const std::string& file : tracked.files) {
+        watcher_.watch(file);
+    }
+    return true;
+}
+
+void ShaderReloader::track(unsigned int* program, const ShaderStage& vertex, const ShaderStage& fragment) {
+    TrackedProgram tracked = { program, vertex, fragment, nullptr, nullptr, {}, 0 };
+    expand(tracked, tracked.vertex_variant, tracked.fragment_variant);
+    programs_.push_back(tracked);
+}
+
+bool ShaderReloader::update() {
+    bool swapped = false;
+    for (const std::string& file : watcher_.poll()) {
+        // editors sometimes save twice or touch the file without changing it, nothing to do then
+        if (!preprocessor_.reload(file, directory_ + "/" + file)) {
+            continue;
+        }
+        std::cout << "hot reload: " << file << " changed" << std::endl;
+
+        for (TrackedProgram& tracked : programs_) {
+            if (std::find(tracked.files.begin(), tracked.files.end(), file) == tracked.files.end()) {
+                continue;
+            }
+            const ShaderVariant* vertex_variant;
+            const ShaderVariant* fragment_variant;
+            if (!expand(tracked, vertex_variant, fragment_variant)) {
+                std::cout << "hot reload: keeping the previous " << tracked.vertex.file << " + " << tracked.fragment.file << std::endl;
+                continue;
+            }
+            // e.g. the edit was inside an #ifdef this permutation doesn't take
+            if (vertex_variant == tracked.vertex_variant && fragment_variant == tracked.fragment_variant) {
+                continue;
+            }
+            // the old stage is only needed to link programs built from the old source
+            if (vertex_variant != tracked.vertex_variant) {
+                compiler_.discard_stage(GL_VERTEX_SHADER, tracked.vertex_variant->source);
+            }
+            if (fragment_variant != tracked.fragment_variant) {
+                compiler_.discard_stage(GL_FRAGMENT_SHADER, tracked.fragment_variant->source);
+            }
+            tracked.vertex_variant = vertex_variant;
+            tracked.fragment_variant = fragment_variant;
+
+            // an older reload still in flight is superseded, drop it once the compiler is done with it
+            if (tracked.pending != 0) {
+                superseded_.push_back(tracked.pending);
+            }
+            // the preprocessor keeps every variant alive, so the views stay valid while this compiles
+            tracked.pending = compiler_.submit_program(vertex_variant->source, fragment_variant->source);
+        }
+    }
+
+    for (size_t i = 0; i < superseded_.size(); ) {
+        if (compiler_.ready(superseded_[i])) {
+            compiler_.wait(superseded_[i]);
+            compiler_.release(superseded_[i]);
+            superseded_[i] = superseded_.back();
+            superseded_.pop_back();
+        } else {
+            ++i;
+        }
+    }
+
+    // swap in whatever finished, between frames so no draw ever sees half a reload
+    for (TrackedProgram& tracked : programs_) {
+        if (tracked.pending == 0 || !compiler_.ready(tracked.pending)) {
+            continue;
+        }
+        // ready, so this doesn't block anymore
+        if (compiler_.wait(tracked.pending)) {
+            // the same table for the new program, it keeps its indices and pushes the values into it
+            if (UniformTable* uniforms = compiler_.uniform_table(*tracked.program)) {
+                compiler_.reflect_uniforms(tracked.pending, uniforms);
+            }
+            // release() skips programs that were never finalized, e.g. one nobody waited on yet, so those are
+            // dropped like a superseded reload
+            if (compiler_.ready(*tracked.program)) {
+                compiler_.wait(*tracked.program);
+                compiler_.release(*tracked.program);
+            } else {
+                superseded_.push_back(*tracked.program);
+            }
+            *tracked.program = tracked.pending;
+            swapped = true;
+            std::cout << "hot reload: relinked " << tracked.vertex.file << " + " << tracked.fragment.file << std::endl;
+        } else {
+            compiler_.release(tracked.pending);
+            std::cout << "hot reload: keeping the previous " << tracked.vertex.file << " + " << tracked.fragment.file << std::endl;
+        }
+        tracked.pending = 0;
+    }
+    return swapped;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "file_watcher.h"
+#include "shader_preprocessor.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ShaderCompiler;
+
+// recompiles shaders while the app runs
+// changed files (including anything pulled in with #include) are picked up by a FileWatcher, only the stage
+// variants that changed are compiled again (the compiler keeps the other stages around), only the programs
+// using them are relinked and the new program replaces the old one once it linked. update() never waits for
+// the compiler, and a broken edit leaves the old program in place
+class ShaderReloader {
+public:
+    // construct before submitting the programs you want to track, so the compiler keeps their stages
+    // directory is where the preprocessor's files live on disk
+    ShaderReloader(ShaderCompiler& compiler, ShaderPreprocessor& preprocessor, const std::string& directory);
+
+    // program points to the handle the render loop draws with, it is overwritten when a reload succeeded
+    // the program has to be built from these two stages
+    void track(unsigned int* program, const ShaderStage& vertex, const ShaderStage& fragment);
+
+    // call once per frame before drawing, swaps in every reloaded program that finished linking
+    // returns true if a program was swapped (the old one is deleted by then)
+    bool update();
+
+private:
+    struct TrackedProgram {
+        unsigned int* program;
+        ShaderStage vertex;
+        ShaderStage fragment;
+        const ShaderVariant* vertex_variant;
+        const ShaderVariant* fragment_variant;
+        // every file either stage was expanded from
+        std::vector<std::string> files;
+        // relinked program waiting for the compiler, 0 if none
+        unsigned int pending = 0;
+    };
+
+    // expands both stages, false if one of them failed to preprocess
+    bool expand(TrackedProgram& tracked, const ShaderVariant*& vertex_variant, const ShaderVariant*& fragment_variant);
+
+    ShaderCompiler& compiler_;
+    ShaderPreprocessor& preprocessor_;
+    std::string directory_;
+    FileWatcher watcher_;
+    std::vector<TrackedProgram> programs_;
+    // reloads replaced by a newer edit before they finished, and replaced programs that were still compiling,
+    // released once the compiler is done with them
+    std::vector<unsigned int> superseded_;
+};
@@ -1,7 +0,0 @@
-#version 330 core
-out vec4 FragColor;
-int vec4 vertexColor;
-void main()
-{
-    FragColor = vertexColor;
-} 
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+#include <mutex>
+
+// hands complete copies of some state from one writer thread to one reader thread without either waiting on
+// the other for longer than it takes to swap a few indices
+// the reader keeps the last two snapshots it got, to interpolate between them, and the writer may be filling
+// a fourth while the newest one is published, so there are four slots. both sides only ever copy into or read
+// from slots the other isn't using
+template <typename T>
+class SnapshotBuffer {
+public:
+    // writer: the slot to fill next, anything it held before is stale
+    T& write_slot() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int i = 0; i < kSlots; ++i) {
+            if (i != latest_ && i != current_ && i != previous_) {
+                writing_ = i;
+                break;
+            }
+        }
+        return slots_[writing_];
+    }
+
+    // writer: the write slot becomes the newest snapshot
+    void publish() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        latest_ = writing_;
+    }
+
+    // writer: the last published snapshot, to step from. nullptr before the first publish
+    // only the writer changes which one it is, so it can look without the lock
+    const T* latest() const { return latest_ >= 0 ? &slots_[latest_] : nullptr; }
+
+    // reader: moves on to the newest snapshot if there is one, the one it had becomes the previous
+    // both stay valid until the next acquire. false before the first publish, previous is current until the second
+    bool acquire(const T*& previous, const T*& current) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (latest_ < 0) {
+            return false;
+        }
+        if (latest_ != current_) {
+            previous_ = current_ >= 0 ? current_ : latest_;
+            current_ = latest_;
+        }
+        previous = &slots_[previous_];
+        current = &slots_[current_];
+        return true;
+    }
+
+private:
+    static const int kSlots = 4;
+
+    std::mutex mutex_;
+    T slots_[kSlots];
+    int writing_ = 0;
+    int latest_ = -1;
+    // the reader's two
+    int current_ = -1;
+    int previous_ = -1;
+};
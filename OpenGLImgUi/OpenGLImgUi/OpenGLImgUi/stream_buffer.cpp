@@ -0,0 +1,123 @@
+#include "stream_buffer.h"
+#include "gl_extensions.h"
+#include "gl_state.h"
+#include <algorithm>
+#include <cstring>
+
+StreamBuffer::StreamBuffer(GLStateCache& gl_state, GLenum target, size_t frame_bytes, int frames_in_flight)
+    : gl_state_(gl_state), target_(target), frame_bytes_(frame_bytes), frames_in_flight_(std::max(1, frames_in_flight)) {
+    if (GLAD_GL_VERSION_4_4) {
+        buffer_storage_ = glad_glBufferStorage;
+    } else if (has_gl_extension("GL_ARB_buffer_storage")) {
+        buffer_storage_ = reinterpret_cast<PFNGLBUFFERSTORAGEPROC>(get_gl_proc("glBufferStorage"));
+    }
+    create();
+}
+
+StreamBuffer::~StreamBuffer() {
+    destroy();
+}
+
+void StreamBuffer::create() {
+    glGenBuffers(1, &buffer_);
+    gl_state_.bind_buffer(target_, buffer_);
+    head_ = 0;
+    region_ = 0;
+    if (buffer_storage_) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        size_t bytes = frame_bytes_ * frames_in_flight_;
+        buffer_storage_(target_, bytes, nullptr, flags);
+        mapped_ = static_cast<unsigned char*>(glMapBufferRange(target_, 0, bytes, flags));
+        fences_.assign(frames_in_flight_, nullptr);
+    }
+    if (!mapped_) {
+        if (buffer_storage_) {
+            // storage made with glBufferStorage can't be respecified, start over with a plain buffer
+            glDeleteBuffers(1, &buffer_);
+            gl_state_.invalidate();
+            glGenBuffers(1, &buffer_);
+            gl_state_.bind_buffer(target_, buffer_);
+            buffer_storage_ = nullptr;
+            fences_.clear();
+        }
+        glBufferData(target_, frame_bytes_, nullptr, GL_STREAM_DRAW);
+        staging_.resize(frame_bytes_);
+        committed_ = 0;
+    }
+}
+
+void StreamBuffer::destroy() {
+    for (int region = 0; region < static_cast<int>(fences_.size()); ++region) {
+        wait_region(region);
+    }
+    fences_.clear();
+    if (mapped_) {
+        gl_state_.bind_buffer(target_, buffer_);
+        glUnmapBuffer(target_);
+        mapped_ = nullptr;
+    }
+    glDeleteBuffers(1, &buffer_);
+    buffer_ = 0;
+    // the deleted name was bound and may come back for another buffer
+    gl_state_.invalidate();
+}
+
+void StreamBuffer::resize(size_t frame_bytes) {
+    destroy();
+    frame_bytes_ = frame_bytes;
+    create();
+}
+
+void* StreamBuffer::allocate(size_t bytes, size_t alignment, size_t& offset) {
+    size_t begin = (head_ + alignment - 1) / alignment * alignment;
+    if (begin + bytes > frame_bytes_) {
+        return nullptr;
+    }
+    head_ = begin + bytes;
+    if (mapped_) {
+        offset = size_t(region_) * frame_bytes_ + begin;
+        return mapped_ + offset;
+    }
+    offset = begin;
+    return staging_.data() + begin;
+}
+
+void StreamBuffer::commit() {
+    if (mapped_ || head_ <= committed_) {
+        return;
+    }
+    gl_state_.bind_buffer(target_, buffer_);
+    glBufferSubData(target_, committed_, head_ - committed_, staging_.data() + committed_);
+    committed_ = head_;
+}
+
+void StreamBuffer::end_frame() {
+    head_ = 0;
+    if (!mapped_) {
+        // orphan, the driver hands us fresh storage and keeps the old one alive for the draws in flight
+        gl_state_.bind_buffer(target_, buffer_);
+        glBufferData(target_, frame_bytes_, nullptr, GL_STREAM_DRAW);
+        committed_ = 0;
+        return;
+    }
+    fences_[region_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region_ = (region_ + 1) % frames_in_flight_;
+    wait_region(region_);
+}
+
+void StreamBuffer::wait_region(int region) {
+    GLsync fence = fences_[region];
+    if (!fence) {
+        return;
+    }
+    // usually the fence passed long ago and this returns right away
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        ++stalls_;
+        do {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fence);
+    fences_[region] = nullptr;
+}
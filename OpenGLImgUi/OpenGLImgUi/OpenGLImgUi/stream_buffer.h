@@ -0,0 +1,64 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class GLStateCache;
+
+// ring buffer for data that is rewritten every frame (indirect commands, dynamic vertices, uniforms)
+// with GL 4.4 / ARB_buffer_storage the whole buffer is mapped once, persistent and coherent, and split into
+// one region per frame in flight. a fence after each frame's draws guards its region, so writing is a
+// pointer bump into mapped memory and we only ever wait if the gpu is frames_in_flight frames behind
+// older contexts get one region that is orphaned every frame, writes go to a cpu copy that commit() uploads
+class StreamBuffer {
+public:
+    StreamBuffer(GLStateCache& gl_state, GLenum target, size_t frame_bytes, int frames_in_flight = 3);
+    ~StreamBuffer();
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // room for bytes in this frame's region, offset is where they end up in buffer()
+    // nullptr if the region is full, resize() makes it bigger
+    void* allocate(size_t bytes, size_t alignment, size_t& offset);
+    // make everything allocated so far visible to the gpu, needed before drawing with it
+    // (nothing to do for the persistent mapping, it is coherent)
+    void commit();
+    // all draws reading this frame's data are issued, fence the region and move on to the next one
+    void end_frame();
+    // waits for the gpu to be done with every region, then recreates the buffer. whatever was allocated in
+    // the current frame is gone, so this is meant to happen before allocating
+    void resize(size_t frame_bytes);
+
+    unsigned int buffer() const { return buffer_; }
+    GLenum target() const { return target_; }
+    bool persistent() const { return mapped_ != nullptr; }
+    size_t frame_bytes() const { return frame_bytes_; }
+    // frames where the region we wanted to write was still in use by the gpu
+    uint64_t stalls() const { return stalls_; }
+
+private:
+    void create();
+    void destroy();
+    // blocks until the gpu is done with the region, counts a stall if it wasn't already
+    void wait_region(int region);
+
+    GLStateCache& gl_state_;
+    GLenum target_;
+    size_t frame_bytes_;
+    int frames_in_flight_;
+    PFNGLBUFFERSTORAGEPROC buffer_storage_ = nullptr;
+    unsigned int buffer_ = 0;
+
+    // persistent path, the whole ring mapped once plus a fence per region
+    unsigned char* mapped_ = nullptr;
+    std::vector<GLsync> fences_;
+    int region_ = 0;
+    // fallback path, this frame's writes until commit
+    std::vector<unsigned char> staging_;
+    size_t committed_ = 0;
+
+    // bump pointer inside the current region
+    size_t head_ = 0;
+    uint64_t stalls_ = 0;
+};
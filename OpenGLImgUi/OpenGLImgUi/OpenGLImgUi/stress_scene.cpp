@@ -0,0 +1,93 @@
+#include "stress_scene.h"
+#include <cmath>
+
+namespace {
+    const float kTwoPi = 6.28318530718f;
+
+    float wrap_angle(float angle) {
+        if (angle >= kTwoPi) {
+            return angle - kTwoPi;
+        }
+        if (angle < 0.0f) {
+            return angle + kTwoPi;
+        }
+        return angle;
+    }
+}
+
+StressScene::StressScene(uint32_t grid, double step_seconds, uint32_t materials)
+    : grid_(grid), radius_(0.5f / grid) {
+    const uint32_t count = grid * grid;
+    orbit_cos_.resize(count);
+    orbit_sin_.resize(count);
+    spin_.resize(count);
+    user_data_.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        float x = static_cast<float>(i % grid) / grid;
+        float y = static_cast<float>(i / grid) / grid;
+        // between a quarter and one and a quarter turns per second, varying across the grid
+        double orbit = (0.25 + x * (1.0 - y)) * kTwoPi * step_seconds;
+        orbit_cos_[i] = static_cast<float>(std::cos(orbit));
+        orbit_sin_[i] = static_cast<float>(std::sin(orbit));
+        spin_[i] = static_cast<float>((1.0 + 2.0 * y) * step_seconds);
+        user_data_[i] = materials ? i % materials : i;
+    }
+}
+
+void StressScene::initial_state(StressState& state) const {
+    const uint32_t count = instance_count();
+    state.step = 0;
+    state.offset_x.assign(count, radius_);
+    state.offset_y.assign(count, 0.0f);
+    state.rotation.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        state.rotation[i] = static_cast<float>(i % grid_) / grid_ * kTwoPi;
+    }
+}
+
+void StressScene::simulate(const StressState& in, StressState& out) const {
+    const uint32_t count = instance_count();
+    out.step = in.step + 1;
+    out.offset_x.resize(count);
+    out.offset_y.resize(count);
+    out.rotation.resize(count);
+    const float inverse_radius_squared = 1.0f / (radius_ * radius_);
+    for (uint32_t i = 0; i < count; ++i) {
+        float x = orbit_cos_[i] * in.offset_x[i] - orbit_sin_[i] * in.offset_y[i];
+        float y = orbit_sin_[i] * in.offset_x[i] + orbit_cos_[i] * in.offset_y[i];
+        // one newton step back onto the circle, rounding would make the orbit drift over millions of steps
+        float correction = 1.5f - 0.5f * (x * x + y * y) * inverse_radius_squared;
+        out.offset_x[i] = x * correction;
+        out.offset_y[i] = y * correction;
+        out.rotation[i] = wrap_angle(in.rotation[i] + spin_[i]);
+    }
+}
+
+void StressScene::interpolate(const StressState& previous, const StressState& current, float alpha, InstanceData* instances) const {
+    const uint32_t count = instance_count();
+    for (uint32_t i = 0; i < count; ++i) {
+        float cell_x = static_cast<float>(i % grid_) / grid_;
+        float cell_y = static_cast<float>(i / grid_) / grid_;
+        // rotations are wrapped, go the short way around
+        float turn = current.rotation[i] - previous.rotation[i];
+        if (turn > kTwoPi * 0.5f) {
+            turn -= kTwoPi;
+        } else if (turn < -kTwoPi * 0.5f) {
+            turn += kTwoPi;
+        }
+        InstanceData& instance = instances[i];
+        // w is 2 in shader.vert, so -2..2 covers the screen
+        float x = cell_x + previous.offset_x[i] + (current.offset_x[i] - previous.offset_x[i]) * alpha;
+        float y = cell_y + previous.offset_y[i] + (current.offset_y[i] - previous.offset_y[i]) * alpha;
+        instance.translation[0] = x * 4.0f - 2.0f;
+        instance.translation[1] = y * 4.0f - 2.0f;
+        instance.translation[2] = 0.0f;
+        instance.scale = 3.0f / grid_;
+        instance.color[0] = cell_x;
+        instance.color[1] = cell_y;
+        instance.color[2] = 0.5f;
+        instance.color[3] = 1.0f;
+        instance.rotation = previous.rotation[i] + turn * alpha;
+        instance.user_data = user_data_[i];
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "instance_buffer.h"
+
+// one snapshot of the stress scene, what the simulation thread hands to the renderer
+struct StressState {
+    uint64_t step = 0;
+    // per instance, the offset from its place in the grid (0..1 across the grid) and its rotation in radians
+    std::vector<float> offset_x;
+    std::vector<float> offset_y;
+    std::vector<float> rotation;
+};
+
+// the --stress test: a grid of quads, each circling its cell at its own speed while spinning
+// simulate() advances a snapshot by one fixed step on the simulation thread, interpolate() turns two snapshots
+// into instance data on the render thread. the fixed step lets every orbit advance by a precomputed rotation,
+// so a step is a few multiplies per instance
+class StressScene {
+public:
+    // with materials the quads cycle through that many in their user data (atlas regions), else it's their index
+    StressScene(uint32_t grid, double step_seconds, uint32_t materials = 0);
+
+    uint32_t instance_count() const { return grid_ * grid_; }
+    void initial_state(StressState& state) const;
+    void simulate(const StressState& in, StressState& out) const;
+    // alpha 0 is previous, 1 is current
+    void interpolate(const StressState& previous, const StressState& current, float alpha, InstanceData* instances) const;
+
+private:
+    uint32_t grid_;
+    float radius_;
+    // per instance, what one step turns the orbit by and how far the quad spins
+    std::vector<float> orbit_cos_;
+    std::vector<float> orbit_sin_;
+    std::vector<float> spin_;
+    std::vector<uint32_t> user_data_;
+};
@@ -0,0 +1,196 @@
+#include "texture_atlas.h"
+#include "gl_extensions.h"
+#include "gl_state.h"
+#include "texture_file.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    int max_layers(int layers) {
+        GLint limit = 0;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &limit);
+        return std::max(1, std::min(layers, static_cast<int>(limit)));
+    }
+
+    // the coarsest level still has a texel of each image's border
+    int mip_levels(uint32_t size, uint32_t padding) {
+        int levels = 0;
+        while ((padding >> levels) != 0 && (size >> levels) != 0) {
+            ++levels;
+        }
+        return std::max(levels, 1);
+    }
+}
+
+bool TextureAtlas::bindless_supported() {
+    return has_gl_extension("GL_ARB_bindless_texture") && get_gl_proc("glGetTextureHandleARB") &&
+           get_gl_proc("glMakeTextureHandleResidentARB") && get_gl_proc("glMakeTextureHandleNonResidentARB") &&
+           get_gl_proc("glUniformHandleui64ARB");
+}
+
+TextureAtlas::TextureAtlas(GLStateCache& gl_state, uint32_t size, int layers, uint32_t max_regions, bool bindless)
+    : gl_state_(gl_state), size_(size), layers_(max_layers(layers)), levels_(mip_levels(size, kPadding)),
+      max_regions_(max_regions), packer_(size, size, kPadding, layers_, 1u << (levels_ - 1)) {
+    // core under the same name the extension exports
+    if (GLAD_GL_VERSION_4_2) {
+        tex_storage_ = glad_glTexStorage3D;
+    } else if (has_gl_extension("GL_ARB_texture_storage")) {
+        tex_storage_ = reinterpret_cast<PFNGLTEXSTORAGE3DPROC>(get_gl_proc("glTexStorage3D"));
+    }
+    glGenTextures(1, &texture_);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_);
+    if (tex_storage_) {
+        tex_storage_(GL_TEXTURE_2D_ARRAY, levels_, GL_RGBA8, size_, size_, layers_);
+    } else {
+        for (int level = 0; level < levels_; ++level) {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, std::max(1u, size_ >> level), std::max(1u, size_ >> level),
+                         layers_, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels_ - 1);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // the region table is sized once, a bindless handle fixes the buffer it points at
+    glGenBuffers(1, &region_buffer_);
+    gl_state_.bind_buffer(GL_TEXTURE_BUFFER, region_buffer_);
+    glBufferData(GL_TEXTURE_BUFFER, size_t(max_regions_) * sizeof(AtlasRegion), nullptr, GL_STATIC_DRAW);
+    glGenTextures(1, &region_texture_);
+    glBindTexture(GL_TEXTURE_BUFFER, region_texture_);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, region_buffer_);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    // the texture's parameters can't change once it has a handle, so this comes last
+    if (bindless && bindless_supported()) {
+        auto get_handle = reinterpret_cast<PFNGLGETTEXTUREHANDLEARBPROC>(get_gl_proc("glGetTextureHandleARB"));
+        auto make_resident = reinterpret_cast<PFNGLMAKETEXTUREHANDLERESIDENTARBPROC>(get_gl_proc("glMakeTextureHandleResidentARB"));
+        make_non_resident_ = reinterpret_cast<PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC>(get_gl_proc("glMakeTextureHandleNonResidentARB"));
+        uniform_handle_ = reinterpret_cast<PFNGLUNIFORMHANDLEUI64ARBPROC>(get_gl_proc("glUniformHandleui64ARB"));
+        atlas_handle_ = get_handle(texture_);
+        region_handle_ = get_handle(region_texture_);
+        make_resident(atlas_handle_);
+        make_resident(region_handle_);
+    }
+}
+
+TextureAtlas::~TextureAtlas() {
+    if (atlas_handle_) {
+        make_non_resident_(atlas_handle_);
+        make_non_resident_(region_handle_);
+    }
+    glDeleteTextures(1, &region_texture_);
+    glDeleteTextures(1, &texture_);
+    glDeleteBuffers(1, &region_buffer_);
+    gl_state_.invalidate();
+}
+
+bool TextureAtlas::image_from_file(const TextureFile& file, AtlasImage& image, std::string& error) {
+    const TextureFormatInfo& format = file.format();
+    if (format.compressed || format.block_bytes != 4 || format.type != GL_UNSIGNED_BYTE ||
+        (format.format != GL_RGBA && format.format != GL_BGRA)) {
+        error = "only 8 bit rgba or bgra textures go into an atlas";
+        return false;
+    }
+    image = { file.level_data(0), file.width(), file.height(), format.format };
+    return true;
+}
+
+int TextureAtlas::add_region(const AtlasRect& rect) {
+    const float scale = 1.0f / size_;
+    AtlasRegion region = {};
+    region.uv_offset[0] = rect.x * scale;
+    region.uv_offset[1] = rect.y * scale;
+    region.uv_scale[0] = rect.width * scale;
+    region.uv_scale[1] = rect.height * scale;
+    region.layer = static_cast<float>(rect.page);
+    regions_.push_back(region);
+    return static_cast<int>(regions_.size()) - 1;
+}
+
+int TextureAtlas::add(const AtlasImage& image) {
+    AtlasRect rect;
+    if (regions_.size() >= max_regions_ || !packer_.insert(image.width, image.height, rect)) {
+        return -1;
+    }
+    upload(image, rect);
+    return add_region(rect);
+}
+
+bool TextureAtlas::add_all(const std::vector<AtlasImage>& images, std::vector<int>& regions) {
+    std::vector<AtlasSize> sizes;
+    sizes.reserve(images.size());
+    for (const AtlasImage& image : images) {
+        sizes.push_back({ image.width, image.height });
+    }
+    std::vector<AtlasRect> rects;
+    if (regions_.size() + images.size() > max_regions_ || !packer_.pack(sizes, rects)) {
+        return false;
+    }
+    regions.resize(images.size());
+    for (size_t i = 0; i < images.size(); ++i) {
+        upload(images[i], rects[i]);
+        regions[i] = add_region(rects[i]);
+    }
+    return true;
+}
+
+void TextureAtlas::upload(const AtlasImage& image, const AtlasRect& rect) {
+    // the edge texels repeated kPadding times on every side, and on to the end of the aligned rectangle
+    const uint32_t padded_width = packer_.padded_size(image.width);
+    const uint32_t padded_height = packer_.padded_size(image.height);
+    padded_.resize(size_t(padded_width) * padded_height * 4);
+    for (uint32_t y = 0; y < padded_height; ++y) {
+        uint32_t source_y = std::min(std::max(y, kPadding) - kPadding, image.height - 1);
+        const unsigned char* source = image.pixels + size_t(source_y) * image.width * 4;
+        unsigned char* row = padded_.data() + size_t(y) * padded_width * 4;
+        for (uint32_t x = 0; x < kPadding; ++x) {
+            std::memcpy(row + x * 4, source, 4);
+        }
+        for (uint32_t x = kPadding + image.width; x < padded_width; ++x) {
+            std::memcpy(row + x * 4, source + (image.width - 1) * 4, 4);
+        }
+        std::memcpy(row + kPadding * 4, source, size_t(image.width) * 4);
+    }
+    // straight from client memory, the texture streamer's unpack buffer may still be bound
+    gl_state_.bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, rect.x - kPadding, rect.y - kPadding, rect.page, padded_width, padded_height, 1,
+                    image.format, GL_UNSIGNED_BYTE, padded_.data());
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    mips_dirty_ = true;
+}
+
+void TextureAtlas::update() {
+    if (uploaded_regions_ < regions_.size()) {
+        gl_state_.bind_buffer(GL_TEXTURE_BUFFER, region_buffer_);
+        glBufferSubData(GL_TEXTURE_BUFFER, uploaded_regions_ * sizeof(AtlasRegion),
+                        (regions_.size() - uploaded_regions_) * sizeof(AtlasRegion), regions_.data() + uploaded_regions_);
+        uploaded_regions_ = regions_.size();
+    }
+    if (mips_dirty_ && levels_ > 1) {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture_);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+    mips_dirty_ = false;
+}
+
+void TextureAtlas::bind(unsigned int atlas_unit, unsigned int regions_unit) const {
+    glActiveTexture(GL_TEXTURE0 + atlas_unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_);
+    glActiveTexture(GL_TEXTURE0 + regions_unit);
+    glBindTexture(GL_TEXTURE_BUFFER, region_texture_);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void TextureAtlas::set_handles(int atlas_location, int regions_location) const {
+    if (atlas_location >= 0) {
+        uniform_handle_(atlas_location, atlas_handle_);
+    }
+    if (regions_location >= 0) {
+        uniform_handle_(regions_location, region_handle_);
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "atlas_packer.h"
+
+class GLStateCache;
+class TextureFile;
+
+// ARB_bindless_texture, glad only has core
+typedef GLuint64 (APIENTRYP PFNGLGETTEXTUREHANDLEARBPROC)(GLuint texture);
+typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)(GLuint64 handle);
+typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)(GLuint64 handle);
+typedef void (APIENTRYP PFNGLUNIFORMHANDLEUI64ARBPROC)(GLint location, GLuint64 value);
+
+// 8 bit rgba texels, tightly packed rows, the first row is the top of the image
+struct AtlasImage {
+    const unsigned char* pixels;
+    uint32_t width;
+    uint32_t height;
+    // GL_RGBA or GL_BGRA
+    GLenum format;
+};
+
+// where an image went, in the layout the shaders read from the region table
+struct AtlasRegion {
+    float uv_offset[2];
+    float uv_scale[2];
+    float layer;
+    float unused[3];
+};
+
+// many small images in the layers of one 2d array texture, so draws with different images can share a program,
+// a texture binding and therefore a batch. a draw only needs the index of its region (InstanceData::user_data
+// for the instanced quads), the shader looks up the region's uv rectangle and layer in the region table, a
+// texture buffer of two texels per region, and maps its uvs into it
+// - add() packs images one at a time as they come in, add_all() packs a whole set tallest first. both upload
+//   right away, update() uploads the region table and rebuilds the mip levels of what changed since
+// - every image gets kPadding texels of its edge repeated around it, the atlas only has the mip levels that still
+//   have some of that border. the padded images start on the coarsest level's texel grid, so no texel of any
+//   level covers two images and linear filtering and mipmapping stay inside each image
+// - with ARB_bindless_texture the atlas and the region table are resident handles the programs get through
+//   set_handles(), nothing has to be bound to a texture unit. otherwise bind() puts them on two units
+// the layers are allocated up front, an atlas that's full stays full
+class TextureAtlas {
+public:
+    static constexpr uint32_t kPadding = 4;
+
+    // true if the driver has ARB_bindless_texture, the shaders have to be built for it (USE_BINDLESS)
+    static bool bindless_supported();
+
+    // layers are clamped to what the driver allows, bindless is only used when supported
+    TextureAtlas(GLStateCache& gl_state, uint32_t size, int layers, uint32_t max_regions, bool bindless);
+    ~TextureAtlas();
+    TextureAtlas(const TextureAtlas&) = delete;
+    TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+    // the region, -1 if the image doesn't fit or the region table is full
+    int add(const AtlasImage& image);
+    // regions[i] for images[i], false and nothing added if they don't all fit
+    bool add_all(const std::vector<AtlasImage>& images, std::vector<int>& regions);
+    // level 0 of an uncompressed 8 bit rgba or bgra file, srgb ones are sampled as they are
+    static bool image_from_file(const TextureFile& file, AtlasImage& image, std::string& error);
+
+    // on the gl thread before the frame's draws
+    void update();
+    // the atlas (sampler2DArray) and the region table (samplerBuffer) on these units, the active unit is left at 0
+    void bind(unsigned int atlas_unit, unsigned int regions_unit) const;
+    // bindless: the handles into the samplers at these locations of the program in use
+    void set_handles(int atlas_location, int regions_location) const;
+
+    bool bindless() const { return atlas_handle_ != 0; }
+    const AtlasRegion& region(int region) const { return regions_[region]; }
+    uint32_t region_count() const { return static_cast<uint32_t>(regions_.size()); }
+    int layer_count() const { return layers_; }
+    int layers_used() const { return packer_.page_count(); }
+    double occupancy() const { return packer_.occupancy(); }
+
+private:
+    // the image with its padding into the layer, rect is inside the padding
+    void upload(const AtlasImage& image, const AtlasRect& rect);
+    int add_region(const AtlasRect& rect);
+
+    GLStateCache& gl_state_;
+    uint32_t size_;
+    int layers_;
+    int levels_ = 1;
+    uint32_t max_regions_;
+    AtlasPacker packer_;
+    unsigned int texture_ = 0;
+    unsigned int region_buffer_ = 0;
+    unsigned int region_texture_ = 0;
+    std::vector<AtlasRegion> regions_;
+    // regions from here on aren't in the region buffer yet
+    size_t uploaded_regions_ = 0;
+    bool mips_dirty_ = false;
+    // scratch for the padded copy of an image
+    std::vector<unsigned char> padded_;
+
+    // 4.2 / ARB_texture_storage, null without it
+    PFNGLTEXSTORAGE3DPROC tex_storage_ = nullptr;
+    // ARB_bindless_texture, null and 0 without it
+    PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC make_non_resident_ = nullptr;
+    PFNGLUNIFORMHANDLEUI64ARBPROC uniform_handle_ = nullptr;
+    uint64_t atlas_handle_ = 0;
+    uint64_t region_handle_ = 0;
+};
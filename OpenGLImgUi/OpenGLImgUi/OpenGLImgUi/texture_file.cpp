@@ -0,0 +1,278 @@
+#include "texture_file.h"
+#include <algorithm>
+#include <cstring>
+
+// s3tc is an extension, glad only has the core formats
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT 0x8C4E
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+namespace {
+
+// the formats both containers can hold, by their dxgi (dds) and vulkan (ktx2) numbers, 0 where one has none
+struct ContainerFormat {
+    uint32_t dxgi;
+    uint32_t vulkan;
+    TextureFormatInfo info;
+};
+
+const ContainerFormat kContainerFormats[] = {
+    { 28, 37, { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, false, 4 } },
+    { 29, 43, { GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE, false, 4 } },
+    { 87, 44, { GL_RGBA8, GL_BGRA, GL_UNSIGNED_BYTE, false, 4 } },
+    { 91, 50, { GL_SRGB8_ALPHA8, GL_BGRA, GL_UNSIGNED_BYTE, false, 4 } },
+    { 10, 97, { GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, false, 8 } },
+    { 2, 109, { GL_RGBA32F, GL_RGBA, GL_FLOAT, false, 16 } },
+    { 0, 131, { GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 0, 0, true, 8 } },
+    { 0, 132, { GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, 0, 0, true, 8 } },
+    { 71, 133, { GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 0, 0, true, 8 } },
+    { 72, 134, { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 0, 0, true, 8 } },
+    { 74, 135, { GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 0, 0, true, 16 } },
+    { 75, 136, { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, 0, 0, true, 16 } },
+    { 77, 137, { GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0, 0, true, 16 } },
+    { 78, 138, { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 0, 0, true, 16 } },
+    { 80, 139, { GL_COMPRESSED_RED_RGTC1, 0, 0, true, 8 } },
+    { 81, 140, { GL_COMPRESSED_SIGNED_RED_RGTC1, 0, 0, true, 8 } },
+    { 83, 141, { GL_COMPRESSED_RG_RGTC2, 0, 0, true, 16 } },
+    { 84, 142, { GL_COMPRESSED_SIGNED_RG_RGTC2, 0, 0, true, 16 } },
+    { 95, 143, { GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, 0, 0, true, 16 } },
+    { 96, 144, { GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT, 0, 0, true, 16 } },
+    { 98, 145, { GL_COMPRESSED_RGBA_BPTC_UNORM, 0, 0, true, 16 } },
+    { 99, 146, { GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 0, 0, true, 16 } }
+};
+
+const TextureFormatInfo* find_dxgi_format(uint32_t dxgi) {
+    for (const ContainerFormat& format : kContainerFormats) {
+        if (dxgi != 0 && format.dxgi == dxgi) {
+            return &format.info;
+        }
+    }
+    return nullptr;
+}
+
+const TextureFormatInfo* find_vulkan_format(uint32_t vulkan) {
+    for (const ContainerFormat& format : kContainerFormats) {
+        if (vulkan != 0 && format.vulkan == vulkan) {
+            return &format.info;
+        }
+    }
+    return nullptr;
+}
+
+uint32_t read_u32(const unsigned char* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+uint64_t read_u64(const unsigned char* data) {
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+uint32_t four_cc(const char* code) {
+    return uint32_t(uint8_t(code[0])) | (uint32_t(uint8_t(code[1])) << 8) | (uint32_t(uint8_t(code[2])) << 16) |
+           (uint32_t(uint8_t(code[3])) << 24);
+}
+
+// dds: "DDS ", then a 124 byte header, then with a "DX10" four cc a 20 byte extension
+const size_t kDdsHeaderSize = 4 + 124;
+const size_t kDdsDx10HeaderSize = 20;
+const uint32_t kDdsMipMapCount = 0x20000;
+const uint32_t kDdsFourCC = 0x4;
+const uint32_t kDdsRgb = 0x40;
+const uint32_t kDdsCubeMap = 0x200;
+const uint32_t kDdsVolume = 0x200000;
+
+// ktx2: the identifier, 9 header fields, the index and then a level table of 3 uint64 per level
+const unsigned char kKtx2Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+const size_t kKtx2LevelTableOffset = 80;
+
+}
+
+size_t texture_row_bytes(const TextureFormatInfo& format, uint32_t width) {
+    if (format.compressed) {
+        return size_t((width + 3) / 4) * format.block_bytes;
+    }
+    return size_t(width) * format.block_bytes;
+}
+
+size_t texture_level_bytes(const TextureFormatInfo& format, uint32_t width, uint32_t height) {
+    return texture_row_bytes(format, width) * (format.compressed ? (height + 3) / 4 : height);
+}
+
+bool TextureFile::open(const std::string& path, std::string& error) {
+    close();
+    if (!file_.open(path, error)) {
+        return false;
+    }
+    const unsigned char* data = static_cast<const unsigned char*>(file_.data());
+    bool parsed = false;
+    if (file_.size() >= 4 && std::memcmp(data, "DDS ", 4) == 0) {
+        parsed = parse_dds(path, error);
+    } else if (file_.size() >= sizeof(kKtx2Identifier) && std::memcmp(data, kKtx2Identifier, sizeof(kKtx2Identifier)) == 0) {
+        parsed = parse_ktx2(path, error);
+    } else {
+        error = path + ": not a dds or ktx2 file";
+    }
+    if (!parsed || !finish_levels(path, error)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void TextureFile::close() {
+    file_.close();
+    levels_.clear();
+    format_ = {};
+}
+
+bool TextureFile::parse_dds(const std::string& path, std::string& error) {
+    const unsigned char* data = static_cast<const unsigned char*>(file_.data());
+    if (file_.size() < kDdsHeaderSize || read_u32(data + 4) != 124) {
+        error = path + ": corrupt dds header";
+        return false;
+    }
+    const unsigned char* header = data + 4;
+    const uint32_t flags = read_u32(header + 4);
+    const uint32_t height = read_u32(header + 8);
+    const uint32_t width = read_u32(header + 12);
+    const uint32_t mip_count = (flags & kDdsMipMapCount) ? std::max(1u, read_u32(header + 24)) : 1;
+    const unsigned char* pixel_format = header + 72;
+    const uint32_t pixel_flags = read_u32(pixel_format + 4);
+    const uint32_t code = read_u32(pixel_format + 8);
+    const uint32_t caps2 = read_u32(header + 108);
+    if (width == 0 || height == 0) {
+        error = path + ": corrupt dds header";
+        return false;
+    }
+    if (caps2 & (kDdsCubeMap | kDdsVolume)) {
+        error = path + ": cube maps and volumes aren't supported";
+        return false;
+    }
+
+    uint64_t offset = kDdsHeaderSize;
+    const TextureFormatInfo* format = nullptr;
+    if ((pixel_flags & kDdsFourCC) && code == four_cc("DX10")) {
+        if (file_.size() < kDdsHeaderSize + kDdsDx10HeaderSize) {
+            error = path + ": corrupt dds header";
+            return false;
+        }
+        const unsigned char* dx10 = data + kDdsHeaderSize;
+        // resource dimension 3 is a 2d texture, misc flag 4 a cube map
+        if (read_u32(dx10 + 4) != 3 || (read_u32(dx10 + 8) & 0x4) || read_u32(dx10 + 12) > 1) {
+            error = path + ": only plain 2d textures are supported";
+            return false;
+        }
+        format = find_dxgi_format(read_u32(dx10));
+        offset += kDdsDx10HeaderSize;
+    } else if (pixel_flags & kDdsFourCC) {
+        if (code == four_cc("DXT1")) {
+            format = find_dxgi_format(71);
+        } else if (code == four_cc("DXT3")) {
+            format = find_dxgi_format(74);
+        } else if (code == four_cc("DXT5")) {
+            format = find_dxgi_format(77);
+        } else if (code == four_cc("ATI1") || code == four_cc("BC4U")) {
+            format = find_dxgi_format(80);
+        } else if (code == four_cc("ATI2") || code == four_cc("BC5U")) {
+            format = find_dxgi_format(83);
+        }
+    } else if ((pixel_flags & kDdsRgb) && read_u32(pixel_format + 12) == 32) {
+        // the red mask tells rgba from bgra
+        const uint32_t red_mask = read_u32(pixel_format + 16);
+        if (red_mask == 0x000000FFu) {
+            format = find_dxgi_format(28);
+        } else if (red_mask == 0x00FF0000u) {
+            format = find_dxgi_format(87);
+        }
+    }
+    if (!format) {
+        error = path + ": unsupported dds format";
+        return false;
+    }
+    format_ = *format;
+
+    // the levels follow each other right after the headers
+    for (uint32_t level = 0; level < mip_count && level < 32; ++level) {
+        TextureFileLevel entry;
+        entry.width = std::max(1u, width >> level);
+        entry.height = std::max(1u, height >> level);
+        entry.offset = offset;
+        entry.size = texture_level_bytes(format_, entry.width, entry.height);
+        offset += entry.size;
+        levels_.push_back(entry);
+    }
+    return true;
+}
+
+bool TextureFile::parse_ktx2(const std::string& path, std::string& error) {
+    const unsigned char* data = static_cast<const unsigned char*>(file_.data());
+    if (file_.size() < kKtx2LevelTableOffset) {
+        error = path + ": corrupt ktx2 header";
+        return false;
+    }
+    const uint32_t vulkan_format = read_u32(data + 12);
+    const uint32_t width = read_u32(data + 20);
+    const uint32_t height = read_u32(data + 24);
+    const uint32_t depth = read_u32(data + 28);
+    const uint32_t layers = read_u32(data + 32);
+    const uint32_t faces = read_u32(data + 36);
+    // 0 asks the loader to generate the mips, we only use what's there
+    const uint32_t level_count = std::max(1u, read_u32(data + 40));
+    const uint32_t supercompression = read_u32(data + 44);
+    if (width == 0 || height == 0 || depth != 0 || layers > 1 || faces != 1) {
+        error = path + ": only plain 2d textures are supported";
+        return false;
+    }
+    if (supercompression != 0) {
+        error = path + ": supercompressed ktx2 isn't supported";
+        return false;
+    }
+    const TextureFormatInfo* format = find_vulkan_format(vulkan_format);
+    if (!format) {
+        error = path + ": unsupported ktx2 format " + std::to_string(vulkan_format);
+        return false;
+    }
+    format_ = *format;
+    if (level_count > 32 || file_.size() < kKtx2LevelTableOffset + size_t(level_count) * 24) {
+        error = path + ": corrupt ktx2 level table";
+        return false;
+    }
+    for (uint32_t level = 0; level < level_count; ++level) {
+        const unsigned char* entry_data = data + kKtx2LevelTableOffset + size_t(level) * 24;
+        TextureFileLevel entry;
+        entry.width = std::max(1u, width >> level);
+        entry.height = std::max(1u, height >> level);
+        entry.offset = read_u64(entry_data);
+        entry.size = texture_level_bytes(format_, entry.width, entry.height);
+        if (read_u64(entry_data + 8) < entry.size) {
+            error = path + ": ktx2 level " + std::to_string(level) + " is too small";
+            return false;
+        }
+        levels_.push_back(entry);
+    }
+    return true;
+}
+
+bool TextureFile::finish_levels(const std::string& path, std::string& error) {
+    for (size_t level = 0; level < levels_.size(); ++level) {
+        const TextureFileLevel& entry = levels_[level];
+        if (entry.offset > file_.size() || entry.size > file_.size() - entry.offset) {
+            error = path + ": level " + std::to_string(level) + " is cut off";
+            return false;
+        }
+    }
+    return !levels_.empty();
+}
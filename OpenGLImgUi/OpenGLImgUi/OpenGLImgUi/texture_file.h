@@ -0,0 +1,59 @@
+#pragma once
+#include "asset_registry.h"
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// how the texels of a file go to gl
+struct TextureFormatInfo {
+    GLenum internal_format;
+    // what glTexSubImage2D takes along with uncompressed data, unused for compressed formats
+    GLenum format;
+    GLenum type;
+    bool compressed;
+    // per 4x4 block for compressed formats, per texel otherwise
+    uint32_t block_bytes;
+};
+
+// bytes of one level, and of one row of it: a row of blocks (4 texels high) for compressed formats
+size_t texture_level_bytes(const TextureFormatInfo& format, uint32_t width, uint32_t height);
+size_t texture_row_bytes(const TextureFormatInfo& format, uint32_t width);
+
+struct TextureFileLevel {
+    uint32_t width;
+    uint32_t height;
+    // into the file
+    uint64_t offset;
+    uint64_t size;
+};
+
+// a mapped .dds or .ktx2, only plain 2d textures: no arrays, cube maps, volumes or ktx2 supercompression
+// formats are rgba8 (also bgra8 and srgb), rgba16f, rgba32f and bc1 to bc7. level 0 is the largest
+// like MeshFile the levels are used in place, open() only checks the header and the level table
+class TextureFile {
+public:
+    bool open(const std::string& path, std::string& error);
+    void close();
+
+    const TextureFormatInfo& format() const { return format_; }
+    uint32_t width() const { return levels_.empty() ? 0 : levels_[0].width; }
+    uint32_t height() const { return levels_.empty() ? 0 : levels_[0].height; }
+    int level_count() const { return static_cast<int>(levels_.size()); }
+    const TextureFileLevel& level(int level) const { return levels_[level]; }
+    const unsigned char* level_data(int level) const {
+        return static_cast<const unsigned char*>(file_.data()) + levels_[level].offset;
+    }
+    size_t size() const { return file_.size(); }
+
+private:
+    bool parse_dds(const std::string& path, std::string& error);
+    bool parse_ktx2(const std::string& path, std::string& error);
+    // checks every level is inside the file
+    bool finish_levels(const std::string& path, std::string& error);
+
+    MappedFile file_;
+    TextureFormatInfo format_ = {};
+    std::vector<TextureFileLevel> levels_;
+};
@@ -0,0 +1,378 @@
+#include "texture_streamer.h"
+#include "gl_extensions.h"
+#include "gl_state.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+TextureStreamer::TextureStreamer(GLStateCache& gl_state, size_t budget_bytes, size_t upload_bytes, unsigned int threads)
+    : gl_state_(gl_state), budget_bytes_(budget_bytes), upload_bytes_(std::max(upload_bytes, size_t(kMinUploadBytes))),
+      upload_stream_(gl_state, GL_PIXEL_UNPACK_BUFFER, upload_bytes_) {
+    // both are core under the same names the extensions export
+    if (GLAD_GL_VERSION_4_2) {
+        tex_storage_ = glad_glTexStorage2D;
+    } else if (has_gl_extension("GL_ARB_texture_storage")) {
+        tex_storage_ = reinterpret_cast<PFNGLTEXSTORAGE2DPROC>(get_gl_proc("glTexStorage2D"));
+    }
+    if (GLAD_GL_VERSION_4_3) {
+        copy_image_ = glad_glCopyImageSubData;
+    } else if (has_gl_extension("GL_ARB_copy_image")) {
+        copy_image_ = reinterpret_cast<PFNGLCOPYIMAGESUBDATAPROC>(get_gl_proc("glCopyImageSubData"));
+    }
+    // the stream buffer leaves itself bound, anything else uploading textures would read from it
+    gl_state_.bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (threads == 0) {
+        threads = 2;
+    }
+    for (unsigned int i = 0; i < threads; ++i) {
+        workers_.emplace_back(&TextureStreamer::worker_main, this);
+    }
+}
+
+TextureStreamer::~TextureStreamer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_cv_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+    for (const Upload& upload : uploads_) {
+        if (upload.texture) {
+            glDeleteTextures(1, &upload.texture);
+        }
+    }
+    for (const std::unique_ptr<Entry>& entry : entries_) {
+        if (entry->texture) {
+            glDeleteTextures(1, &entry->texture);
+        }
+    }
+}
+
+int TextureStreamer::request(const std::string& path) {
+    entries_.emplace_back(new Entry());
+    Entry& entry = *entries_.back();
+    entry.path = path;
+    entry.last_used_frame = frame_;
+    queue_load(entry, -1, -1, -1);
+    return static_cast<int>(entries_.size() - 1);
+}
+
+void TextureStreamer::use(int texture, int level) {
+    Entry& entry = *entries_[texture];
+    entry.last_used_frame = frame_;
+    entry.wanted = std::max(level, 0);
+}
+
+void TextureStreamer::queue_load(Entry& entry, int first_level, int last_level, int new_resident, size_t reserved,
+                                  size_t freeing) {
+    std::unique_ptr<Load> load(new Load());
+    load->entry = &entry;
+    load->first_level = first_level;
+    load->last_level = last_level;
+    load->new_resident = new_resident;
+    load->reserved = reserved;
+    load->freeing = freeing;
+    entry.busy = true;
+    reserved_bytes_ += reserved;
+    freeing_bytes_ += freeing;
+    ++pending_loads_;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        requests_.push_back(std::move(load));
+    }
+    work_cv_.notify_one();
+}
+
+void TextureStreamer::worker_main() {
+    while (true) {
+        std::unique_ptr<Load> load;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_cv_.wait(lock, [&] { return stopping_ || !requests_.empty(); });
+            if (stopping_) {
+                return;
+            }
+            load = std::move(requests_.front());
+            requests_.pop_front();
+        }
+
+        Entry& entry = *load->entry;
+        if (load->first_level < 0) {
+            if (entry.file.open(entry.path, load->error)) {
+                // the finest level that still counts as coarse, or the last one if none is that small
+                const TextureFile& file = entry.file;
+                int coarse = file.level_count() - 1;
+                while (coarse > 0 && std::max(file.level(coarse - 1).width, file.level(coarse - 1).height) <= kCoarseSize) {
+                    --coarse;
+                }
+                load->first_level = coarse;
+                load->last_level = file.level_count() - 1;
+                load->new_resident = coarse;
+            }
+        }
+        if (load->error.empty()) {
+            // copying is what pulls the pages in, better here than in the middle of a frame
+            size_t bytes = 0;
+            for (int level = load->first_level; level <= load->last_level; ++level) {
+                bytes += entry.file.level(level).size;
+            }
+            load->data.resize(bytes);
+            unsigned char* target = load->data.data();
+            for (int level = load->first_level; level <= load->last_level; ++level) {
+                std::memcpy(target, entry.file.level_data(level), entry.file.level(level).size);
+                target += entry.file.level(level).size;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished_.push_back(std::move(load));
+    }
+}
+
+void TextureStreamer::update() {
+    std::vector<std::unique_ptr<Load>> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished.swap(finished_);
+    }
+    for (std::unique_ptr<Load>& load : finished) {
+        Entry& entry = *load->entry;
+        if (!load->error.empty()) {
+            std::cout << "ERROR::TEXTURE::LOAD_FAILED\n" << load->error << std::endl;
+            entry.failed = true;
+            entry.busy = false;
+            reserved_bytes_ -= load->reserved;
+            freeing_bytes_ -= load->freeing;
+            --pending_loads_;
+            continue;
+        }
+        if (entry.coarse < 0) {
+            entry.coarse = load->first_level;
+        }
+        Upload upload;
+        upload.load = std::move(load);
+        uploads_.push_back(std::move(upload));
+    }
+
+    // oldest first, a big level takes a few frames and everything behind it waits
+    size_t frame_bytes = 0;
+    while (!uploads_.empty() && frame_bytes < upload_bytes_) {
+        Upload& upload = uploads_.front();
+        if (!upload.texture) {
+            start_upload(upload);
+        }
+        if (!continue_upload(upload, frame_bytes)) {
+            break;
+        }
+        finish_upload(upload);
+        uploads_.pop_front();
+    }
+    if (frame_bytes > 0) {
+        upload_stream_.end_frame();
+        gl_state_.bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // the coarse levels come in without asking, get back under the budget if they pushed us over
+    if (resident_bytes_ + reserved_bytes_ > budget_bytes_) {
+        make_room(0);
+    }
+
+    // the next finer level of everything drawn this frame that wants one, coarsest first
+    std::vector<Entry*> wanting;
+    for (const std::unique_ptr<Entry>& entry : entries_) {
+        if (!entry->busy && !entry->failed && entry->resident > entry->wanted && entry->last_used_frame == frame_) {
+            wanting.push_back(entry.get());
+        }
+    }
+    std::stable_sort(wanting.begin(), wanting.end(), [](const Entry* a, const Entry* b) { return a->resident > b->resident; });
+    for (Entry* entry : wanting) {
+        if (pending_loads_ >= kMaxPendingLoads) {
+            break;
+        }
+        const int level = entry->resident - 1;
+        const size_t bytes = entry->file.level(level).size;
+        if (!make_room(bytes)) {
+            break;
+        }
+        // without copies the whole chain comes from the file again
+        queue_load(*entry, level, copy_image_ ? level : entry->file.level_count() - 1, level, bytes);
+    }
+    ++frame_;
+}
+
+bool TextureStreamer::make_room(size_t bytes) {
+    while (resident_bytes_ + reserved_bytes_ + bytes > budget_bytes_) {
+        // the reloads already queued get us there, evicting more on top of them would throw away too much
+        if (resident_bytes_ + reserved_bytes_ + bytes <= budget_bytes_ + freeing_bytes_) {
+            return false;
+        }
+        if (!evict_one()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TextureStreamer::evict_one() {
+    // only levels nobody drew with this frame, or finer than asked for. the others would come right back
+    Entry* victim = nullptr;
+    for (const std::unique_ptr<Entry>& entry : entries_) {
+        if (entry->busy || entry->resident < 0 || entry->resident >= entry->coarse) {
+            continue;
+        }
+        const bool over_refined = entry->resident < entry->wanted;
+        if (!over_refined && entry->last_used_frame == frame_) {
+            continue;
+        }
+        if (!victim) {
+            victim = entry.get();
+            continue;
+        }
+        const bool victim_over_refined = victim->resident < victim->wanted;
+        if (over_refined != victim_over_refined ? over_refined : entry->last_used_frame < victim->last_used_frame) {
+            victim = entry.get();
+        }
+    }
+    if (!victim) {
+        return false;
+    }
+    ++evictions_;
+    const int new_resident = victim->resident + 1;
+    if (!copy_image_) {
+        // the memory only frees up once the reload is uploaded, make_room counts it as on its way until then
+        queue_load(*victim, new_resident, victim->file.level_count() - 1, new_resident, 0,
+                   victim->bytes - levels_bytes(*victim, new_resident));
+        return true;
+    }
+    unsigned int texture = allocate(victim->file, new_resident);
+    copy_levels(*victim, texture, new_resident, new_resident);
+    replace_texture(*victim, texture, new_resident);
+    return true;
+}
+
+unsigned int TextureStreamer::allocate(const TextureFile& file, int first_level) {
+    const TextureFormatInfo& format = file.format();
+    const int levels = file.level_count() - first_level;
+    // with an unpack buffer bound the null data below would be an offset into it
+    gl_state_.bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    unsigned int texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if (tex_storage_) {
+        tex_storage_(GL_TEXTURE_2D, levels, format.internal_format, file.level(first_level).width, file.level(first_level).height);
+    } else {
+        for (int level = 0; level < levels; ++level) {
+            const TextureFileLevel& source = file.level(first_level + level);
+            if (format.compressed) {
+                glCompressedTexImage2D(GL_TEXTURE_2D, level, format.internal_format, source.width, source.height, 0,
+                                       static_cast<GLsizei>(source.size), nullptr);
+            } else {
+                glTexImage2D(GL_TEXTURE_2D, level, format.internal_format, source.width, source.height, 0, format.format,
+                             format.type, nullptr);
+            }
+        }
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return texture;
+}
+
+void TextureStreamer::copy_levels(const Entry& entry, unsigned int texture, int first_level, int new_resident) {
+    for (int level = first_level; level < entry.file.level_count(); ++level) {
+        const TextureFileLevel& source = entry.file.level(level);
+        copy_image_(entry.texture, GL_TEXTURE_2D, level - entry.resident, 0, 0, 0, texture, GL_TEXTURE_2D, level - new_resident,
+                    0, 0, 0, source.width, source.height, 1);
+    }
+}
+
+void TextureStreamer::replace_texture(Entry& entry, unsigned int texture, int new_resident) {
+    if (entry.texture) {
+        glDeleteTextures(1, &entry.texture);
+    }
+    entry.texture = texture;
+    entry.resident = new_resident;
+    const size_t bytes = levels_bytes(entry, new_resident);
+    resident_bytes_ = resident_bytes_ - entry.bytes + bytes;
+    entry.bytes = bytes;
+}
+
+size_t TextureStreamer::levels_bytes(const Entry& entry, int first_level) const {
+    size_t bytes = 0;
+    for (int level = first_level; level < entry.file.level_count(); ++level) {
+        bytes += entry.file.level(level).size;
+    }
+    return bytes;
+}
+
+void TextureStreamer::start_upload(Upload& upload) {
+    const Load& load = *upload.load;
+    const Entry& entry = *load.entry;
+    upload.texture = allocate(entry.file, load.new_resident);
+    upload.level = load.first_level;
+    upload.row = 0;
+    upload.data_offset = 0;
+    if (entry.resident >= 0 && load.last_level + 1 < entry.file.level_count()) {
+        copy_levels(entry, upload.texture, load.last_level + 1, load.new_resident);
+    }
+}
+
+bool TextureStreamer::continue_upload(Upload& upload, size_t& frame_bytes) {
+    const Load& load = *upload.load;
+    const TextureFile& file = load.entry->file;
+    const TextureFormatInfo& format = file.format();
+    const uint32_t row_height = format.compressed ? 4 : 1;
+    while (upload.level <= load.last_level) {
+        const TextureFileLevel& level = file.level(upload.level);
+        const size_t row_bytes = texture_row_bytes(format, level.width);
+        const uint32_t rows = (level.height + row_height - 1) / row_height;
+        uint32_t chunk_rows = static_cast<uint32_t>(std::min<size_t>(rows - upload.row, (upload_bytes_ - frame_bytes) / row_bytes));
+        if (chunk_rows == 0) {
+            return false;
+        }
+        const size_t bytes = chunk_rows * row_bytes;
+        size_t offset = 0;
+        void* target = upload_stream_.allocate(bytes, 16, offset);
+        if (!target) {
+            return false;
+        }
+        std::memcpy(target, load.data.data() + upload.data_offset, bytes);
+        upload_stream_.commit();
+        gl_state_.bind_buffer(GL_PIXEL_UNPACK_BUFFER, upload_stream_.buffer());
+        glBindTexture(GL_TEXTURE_2D, upload.texture);
+        const uint32_t y = upload.row * row_height;
+        const uint32_t height = std::min(chunk_rows * row_height, level.height - y);
+        const void* pixels = reinterpret_cast<const void*>(offset);
+        if (format.compressed) {
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, upload.level - load.new_resident, 0, y, level.width, height,
+                                      format.internal_format, static_cast<GLsizei>(bytes), pixels);
+        } else {
+            glTexSubImage2D(GL_TEXTURE_2D, upload.level - load.new_resident, 0, y, level.width, height, format.format,
+                            format.type, pixels);
+        }
+        upload.row += chunk_rows;
+        upload.data_offset += bytes;
+        frame_bytes += bytes;
+        uploaded_bytes_ += bytes;
+        if (upload.row == rows) {
+            ++upload.level;
+            upload.row = 0;
+        }
+    }
+    return true;
+}
+
+void TextureStreamer::finish_upload(Upload& upload) {
+    Load& load = *upload.load;
+    Entry& entry = *load.entry;
+    replace_texture(entry, upload.texture, load.new_resident);
+    upload.texture = 0;
+    entry.busy = false;
+    reserved_bytes_ -= load.reserved;
+    freeing_bytes_ -= load.freeing;
+    --pending_loads_;
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include <glad/glad.h>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "stream_buffer.h"
+#include "texture_file.h"
+
+class GLStateCache;
+
+// streams .dds and .ktx2 textures in the background and keeps what is resident inside a memory budget
+// - worker threads open the files and copy the levels out of the mapping, so the page faults and disk reads
+//   never happen on the gl thread
+// - a texture first gets its coarse levels (kCoarseSize and smaller), which are never evicted. finer levels
+//   come in one at a time, coarse to fine, while use() asks for them and the budget has room
+// - uploads go through a pixel unpack stream buffer, at most upload_bytes a frame. a level bigger than that is
+//   uploaded a few rows per frame into the texture's next storage, which only replaces the current one once
+//   it is complete, so a texture never shows half a level
+// - over the budget, the finest level of the least recently used texture is dropped, textures holding finer
+//   levels than they asked for go first
+// gl has no way to add or drop levels of an existing texture, so both make new storage and copy the levels
+// that stay with glCopyImageSubData (4.3 or ARB_copy_image). without it the levels that stay are loaded from
+// the file again. either way the gl name changes, look it up with texture() every frame
+class TextureStreamer {
+public:
+    static const uint32_t kCoarseSize = 64;
+    // loads queued on the workers or waiting for upload, more would only pile up copies in memory
+    static const size_t kMaxPendingLoads = 16;
+    // one row of a 16k wide rgba32f level
+    static const size_t kMinUploadBytes = 256 * 1024;
+
+    // 0 threads picks 2
+    TextureStreamer(GLStateCache& gl_state, size_t budget_bytes, size_t upload_bytes, unsigned int threads = 0);
+    ~TextureStreamer();
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // starts loading the coarse levels, the handle is valid right away
+    int request(const std::string& path);
+    // the texture is drawn this frame and wants its levels down to level (0 is the finest)
+    void use(int texture, int level = 0);
+    // on the gl thread once a frame: uploads what the workers loaded, evicts, queues finer levels
+    void update();
+
+    // 0 until the coarse levels are in
+    unsigned int texture(int texture) const { return entries_[texture]->texture; }
+    // finest level resident, -1 while nothing is
+    int resident_level(int texture) const { return entries_[texture]->resident; }
+    bool failed(int texture) const { return entries_[texture]->failed; }
+    size_t texture_count() const { return entries_.size(); }
+
+    size_t budget_bytes() const { return budget_bytes_; }
+    size_t resident_bytes() const { return resident_bytes_; }
+    uint64_t uploaded_bytes() const { return uploaded_bytes_; }
+    uint64_t evictions() const { return evictions_; }
+    size_t pending_loads() const { return pending_loads_; }
+
+private:
+    struct Entry {
+        std::string path;
+        // opened by the first load on a worker, only read after that
+        TextureFile file;
+        unsigned int texture = 0;
+        int resident = -1;
+        // the finest level that is never evicted
+        int coarse = -1;
+        int wanted = 0;
+        uint64_t last_used_frame = 0;
+        // a load or upload is in flight, nothing else may change the texture until it's done
+        bool busy = false;
+        bool failed = false;
+        // of the resident levels
+        size_t bytes = 0;
+    };
+
+    struct Load {
+        Entry* entry;
+        // the levels to read, -1 first for the coarse ones
+        int first_level;
+        int last_level;
+        // what the next storage starts at, the levels after last_level are copied from the current one
+        int new_resident;
+        // budget held for it until the upload is done
+        size_t reserved = 0;
+        // what a reload that evicts a level frees once it's uploaded
+        size_t freeing = 0;
+        std::vector<unsigned char> data;
+        std::string error;
+    };
+
+    // a load being uploaded, possibly over several frames
+    struct Upload {
+        std::unique_ptr<Load> load;
+        // the next storage, 0 until the upload started
+        unsigned int texture = 0;
+        int level = 0;
+        uint32_t row = 0;
+        size_t data_offset = 0;
+    };
+
+    void worker_main();
+    void queue_load(Entry& entry, int first_level, int last_level, int new_resident, size_t reserved = 0, size_t freeing = 0);
+    // makes room for bytes, false if even evicting everything evictable isn't enough or the room only comes once
+    // the reloads in flight are done
+    bool make_room(size_t bytes);
+    bool evict_one();
+    unsigned int allocate(const TextureFile& file, int first_level);
+    // moves the levels of entry's current texture from first_level on into texture, whose level 0 is new_resident
+    void copy_levels(const Entry& entry, unsigned int texture, int first_level, int new_resident);
+    void replace_texture(Entry& entry, unsigned int texture, int new_resident);
+    void start_upload(Upload& upload);
+    // uploads rows until the load is done (true) or the frame's upload bytes are used up
+    bool continue_upload(Upload& upload, size_t& frame_bytes);
+    void finish_upload(Upload& upload);
+    size_t levels_bytes(const Entry& entry, int first_level) const;
+
+    GLStateCache& gl_state_;
+    size_t budget_bytes_;
+    size_t upload_bytes_;
+    // 4.2 / ARB_texture_storage and 4.3 / ARB_copy_image, null without them
+    PFNGLTEXSTORAGE2DPROC tex_storage_ = nullptr;
+    PFNGLCOPYIMAGESUBDATAPROC copy_image_ = nullptr;
+    StreamBuffer upload_stream_;
+    std::vector<std::unique_ptr<Entry>> entries_;
+    uint64_t frame_ = 0;
+    size_t resident_bytes_ = 0;
+    // reserved for levels that are loading
+    size_t reserved_bytes_ = 0;
+    // what the evicting reloads in flight will free
+    size_t freeing_bytes_ = 0;
+    size_t pending_loads_ = 0;
+    uint64_t uploaded_bytes_ = 0;
+    uint64_t evictions_ = 0;
+
+    // loads waiting for their upload or in the middle of it, gl thread only
+    std::deque<Upload> uploads_;
+
+    // shared with the workers
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::deque<std::unique_ptr<Load>> requests_;
+    std::vector<std::unique_ptr<Load>> finished_;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+};
@@ -0,0 +1,244 @@
+#include "uniform_table.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    // size of one element in the shadow storage, 0 for types we don't upload (doubles)
+    uint32_t type_bytes(GLenum type) {
+        switch (type) {
+            case GL_FLOAT: case GL_INT: case GL_UNSIGNED_INT: case GL_BOOL: return 4;
+            case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2: case GL_BOOL_VEC2: return 8;
+            case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3: case GL_BOOL_VEC3: return 12;
+            case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_UNSIGNED_INT_VEC4: case GL_BOOL_VEC4: return 16;
+            case GL_FLOAT_MAT2: return 16;
+            case GL_FLOAT_MAT3: return 36;
+            case GL_FLOAT_MAT4: return 64;
+            case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT3x2: return 24;
+            case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT4x2: return 32;
+            case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x3: return 48;
+            case GL_DOUBLE: case GL_DOUBLE_VEC2: case GL_DOUBLE_VEC3: case GL_DOUBLE_VEC4:
+            case GL_DOUBLE_MAT2: case GL_DOUBLE_MAT3: case GL_DOUBLE_MAT4:
+            case GL_DOUBLE_MAT2x3: case GL_DOUBLE_MAT2x4: case GL_DOUBLE_MAT3x2:
+            case GL_DOUBLE_MAT3x4: case GL_DOUBLE_MAT4x2: case GL_DOUBLE_MAT4x3:
+                return 0;
+            default:
+                // samplers and images, set through their texture unit
+                return 4;
+        }
+    }
+
+    std::string strip_array_suffix(const char* name) {
+        std::string result(name);
+        if (result.size() > 3 && result.compare(result.size() - 3, 3, "[0]") == 0) {
+            result.resize(result.size() - 3);
+        }
+        return result;
+    }
+}
+
+void UniformTable::reflect(unsigned int program) {
+    program_ = program;
+    for (UniformInfo& uniform : uniforms_) {
+        uniform.location = -1;
+    }
+    for (UniformBlockInfo& block : blocks_) {
+        block.index = GL_INVALID_INDEX;
+    }
+
+    char name[256];
+    int uniform_count = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniform_count);
+    std::vector<GLuint> member_indices;
+    for (int i = 0; i < uniform_count; ++i) {
+        GLuint active_index = static_cast<GLuint>(i);
+        int block_index = -1;
+        glGetActiveUniformsiv(program, 1, &active_index, GL_UNIFORM_BLOCK_INDEX, &block_index);
+        if (block_index != -1) {
+            member_indices.push_back(active_index);
+            continue;
+        }
+        int array_size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, active_index, sizeof(name), nullptr, &array_size, &type, name);
+        if (std::strncmp(name, "gl_", 3) == 0) {
+            continue;
+        }
+        int location = glGetUniformLocation(program, name);
+        std::string base_name = strip_array_suffix(name);
+        uint32_t bytes = type_bytes(type) * array_size;
+
+        // a uniform we already know keeps its index, and its value as long as the type didn't change
+        int index = find(base_name);
+        if (index < 0) {
+            index = static_cast<int>(uniforms_.size());
+            uniforms_.emplace_back();
+            uniforms_.back().name = base_name;
+        }
+        UniformInfo& uniform = uniforms_[index];
+        if (uniform.type != type || uniform.array_size != array_size) {
+            uniform.type = type;
+            uniform.array_size = array_size;
+            uniform.bytes = bytes;
+            uniform.offset = static_cast<uint32_t>(values_.size());
+            uniform.assigned = false;
+            values_.resize(values_.size() + bytes, 0);
+        }
+        uniform.location = location;
+    }
+
+    int block_count = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &block_count);
+    for (int i = 0; i < block_count; ++i) {
+        glGetActiveUniformBlockName(program, i, sizeof(name), nullptr, name);
+        int index = find_block(name);
+        if (index < 0) {
+            index = static_cast<int>(blocks_.size());
+            blocks_.emplace_back();
+            blocks_.back().name = name;
+            int binding = 0;
+            glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_BINDING, &binding);
+            blocks_.back().binding = static_cast<unsigned int>(binding);
+        } else {
+            // the new program starts at binding 0, restore the one we assigned
+            glUniformBlockBinding(program, i, blocks_[index].binding);
+        }
+        UniformBlockInfo& block = blocks_[index];
+        block.index = static_cast<unsigned int>(i);
+        glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.data_size);
+        block.members.clear();
+    }
+
+    // members of all blocks are queried in one go per property
+    if (!member_indices.empty()) {
+        GLsizei count = static_cast<GLsizei>(member_indices.size());
+        std::vector<int> block_indices(count), offsets(count), array_strides(count), matrix_strides(count);
+        glGetActiveUniformsiv(program, count, member_indices.data(), GL_UNIFORM_BLOCK_INDEX, block_indices.data());
+        glGetActiveUniformsiv(program, count, member_indices.data(), GL_UNIFORM_OFFSET, offsets.data());
+        glGetActiveUniformsiv(program, count, member_indices.data(), GL_UNIFORM_ARRAY_STRIDE, array_strides.data());
+        glGetActiveUniformsiv(program, count, member_indices.data(), GL_UNIFORM_MATRIX_STRIDE, matrix_strides.data());
+        for (GLsizei i = 0; i < count; ++i) {
+            UniformBlockMember member;
+            glGetActiveUniform(program, member_indices[i], sizeof(name), nullptr, &member.array_size, &member.type, name);
+            member.name = strip_array_suffix(name);
+            member.offset = offsets[i];
+            member.array_stride = array_strides[i];
+            member.matrix_stride = matrix_strides[i];
+            for (UniformBlockInfo& block : blocks_) {
+                if (block.index == static_cast<unsigned int>(block_indices[i])) {
+                    block.members.push_back(member);
+                }
+            }
+        }
+    }
+
+    // a fresh program starts with the shader's defaults, push the values we set into it on the next flush
+    dirty_.clear();
+    dirty_flags_.assign(uniforms_.size(), false);
+    for (size_t i = 0; i < uniforms_.size(); ++i) {
+        if (uniforms_[i].location >= 0 && uniforms_[i].assigned) {
+            dirty_flags_[i] = true;
+            dirty_.push_back(static_cast<int>(i));
+        }
+    }
+}
+
+int UniformTable::find(std::string_view name) const {
+    for (size_t i = 0; i < uniforms_.size(); ++i) {
+        if (uniforms_[i].name == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+int UniformTable::declare(std::string_view name) {
+    int index = find(name);
+    if (index < 0) {
+        index = static_cast<int>(uniforms_.size());
+        uniforms_.emplace_back();
+        uniforms_.back().name = std::string(name);
+        dirty_flags_.push_back(false);
+    }
+    return index;
+}
+
+int UniformTable::find_block(std::string_view name) const {
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+        if (blocks_[i].name == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void UniformTable::set(int index, const void* data, size_t bytes) {
+    if (index < 0 || static_cast<size_t>(index) >= uniforms_.size()) {
+        return;
+    }
+    UniformInfo& uniform = uniforms_[index];
+    bytes = std::min<size_t>(bytes, uniform.bytes);
+    unsigned char* value = values_.data() + uniform.offset;
+    if (bytes == 0 || (uniform.assigned && std::memcmp(value, data, bytes) == 0)) {
+        return;
+    }
+    std::memcpy(value, data, bytes);
+    uniform.assigned = true;
+    if (uniform.location >= 0 && !dirty_flags_[index]) {
+        dirty_flags_[index] = true;
+        dirty_.push_back(index);
+    }
+}
+
+void UniformTable::bind_block(int block, unsigned int binding) {
+    if (block < 0 || static_cast<size_t>(block) >= blocks_.size() || blocks_[block].binding == binding) {
+        return;
+    }
+    blocks_[block].binding = binding;
+    if (blocks_[block].index != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program_, blocks_[block].index, binding);
+    }
+}
+
+void UniformTable::flush() {
+    for (int index : dirty_) {
+        upload(uniforms_[index]);
+        dirty_flags_[index] = false;
+    }
+    uploads_ += dirty_.size();
+    dirty_.clear();
+}
+
+void UniformTable::upload(const UniformInfo& uniform) {
+    const void* value = values_.data() + uniform.offset;
+    const GLfloat* f = static_cast<const GLfloat*>(value);
+    const GLint* i = static_cast<const GLint*>(value);
+    const GLuint* u = static_cast<const GLuint*>(value);
+    GLint location = uniform.location;
+    GLsizei count = uniform.array_size;
+    switch (uniform.type) {
+        case GL_FLOAT: glUniform1fv(location, count, f); break;
+        case GL_FLOAT_VEC2: glUniform2fv(location, count, f); break;
+        case GL_FLOAT_VEC3: glUniform3fv(location, count, f); break;
+        case GL_FLOAT_VEC4: glUniform4fv(location, count, f); break;
+        case GL_INT_VEC2: case GL_BOOL_VEC2: glUniform2iv(location, count, i); break;
+        case GL_INT_VEC3: case GL_BOOL_VEC3: glUniform3iv(location, count, i); break;
+        case GL_INT_VEC4: case GL_BOOL_VEC4: glUniform4iv(location, count, i); break;
+        case GL_UNSIGNED_INT: glUniform1uiv(location, count, u); break;
+        case GL_UNSIGNED_INT_VEC2: glUniform2uiv(location, count, u); break;
+        case GL_UNSIGNED_INT_VEC3: glUniform3uiv(location, count, u); break;
+        case GL_UNSIGNED_INT_VEC4: glUniform4uiv(location, count, u); break;
+        case GL_FLOAT_MAT2: glUniformMatrix2fv(location, count, GL_FALSE, f); break;
+        case GL_FLOAT_MAT3: glUniformMatrix3fv(location, count, GL_FALSE, f); break;
+        case GL_FLOAT_MAT4: glUniformMatrix4fv(location, count, GL_FALSE, f); break;
+        case GL_FLOAT_MAT2x3: glUniformMatrix2x3fv(location, count, GL_FALSE, f); break;
+        case GL_FLOAT_MAT3x2: glUniformMatrix3x2fv(location, count, GL_FALSE, f); break;
+        case GL_FLOAT_MAT2x4: glUniformMatrix2x4fv(location, count, GL_FALSE, f); break;
+        case GL_FLOAT_MAT4x2: glUniformMatrix4x2fv(location, count, GL_FALSE, f); break;
+        case GL_FLOAT_MAT3x4: glUniformMatrix3x4fv(location, count, GL_FALSE, f); break;
+        case GL_FLOAT_MAT4x3: glUniformMatrix4x3fv(location, count, GL_FALSE, f); break;
+        default:
+            // int, bool, samplers and images
+            glUniform1iv(location, count, i);
+            break;
+    }
+}
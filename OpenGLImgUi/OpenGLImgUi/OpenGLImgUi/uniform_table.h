@@ -0,0 +1,82 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// one active uniform of the default block, index into UniformTable::uniforms()
+struct UniformInfo {
+    std::string name;       // without the "[0]" arrays get reported with
+    GLenum type = 0;
+    int location = -1;      // -1 once a relink dropped the uniform
+    int array_size = 1;
+    uint32_t offset = 0;    // where the value lives in the table's shadow storage
+    uint32_t bytes = 0;
+    // false until set() was called, unset uniforms keep whatever the shader initialized them to
+    bool assigned = false;
+};
+
+// a member of a uniform block, offsets are what the driver wants in the buffer
+struct UniformBlockMember {
+    std::string name;
+    GLenum type = 0;
+    int offset = 0;
+    int array_size = 1;
+    int array_stride = 0;
+    int matrix_stride = 0;
+};
+
+struct UniformBlockInfo {
+    std::string name;
+    unsigned int index = GL_INVALID_INDEX;
+    int data_size = 0;
+    unsigned int binding = 0;
+    std::vector<UniformBlockMember> members;
+};
+
+// link-time reflection of a program's uniforms and uniform blocks, plus a shadow copy of every value
+// names are resolved once with find() or declare() at setup, the frame loop only works with the returned indices:
+// set() compares against the shadow copy and flush() uploads just the values that changed, so the per frame
+// path does no string lookups and no GL queries
+// indices stay the same when the program is reflected again after a relink (hot reload), values are kept
+class UniformTable {
+public:
+    // query everything the linked program exposes, all known values get uploaded on the next flush
+    void reflect(unsigned int program);
+    unsigned int program() const { return program_; }
+
+    // -1 if the program has no such (active) uniform, setting -1 is a no-op
+    int find(std::string_view name) const;
+    // find() for setup code that runs before the program linked: the index is reserved and the uniform gets its
+    // location once a program that has it is reflected. values set before that are dropped
+    int declare(std::string_view name);
+    int find_block(std::string_view name) const;
+
+    // bytes has to match the uniform (e.g. 4 floats for a vec4), extra array elements are ignored
+    void set(int index, const void* data, size_t bytes);
+    template <typename T>
+    void set(int index, const T& value) { set(index, &value, sizeof(T)); }
+
+    // assign the block a binding point, the buffer itself is bound with glBindBufferRange
+    void bind_block(int block, unsigned int binding);
+
+    // upload everything set since the last flush, the program has to be the one in use
+    void flush();
+
+    const std::vector<UniformInfo>& uniforms() const { return uniforms_; }
+    const std::vector<UniformBlockInfo>& blocks() const { return blocks_; }
+    uint64_t uploads() const { return uploads_; }
+
+private:
+    void upload(const UniformInfo& uniform);
+
+    unsigned int program_ = 0;
+    std::vector<UniformInfo> uniforms_;
+    std::vector<UniformBlockInfo> blocks_;
+    // current value of every uniform, uniforms_[i].offset points in here
+    std::vector<unsigned char> values_;
+    std::vector<bool> dirty_flags_;
+    std::vector<int> dirty_;
+    uint64_t uploads_ = 0;
+};
@@ -0,0 +1,401 @@
+#include "vertex_layout.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+    struct FormatInfo {
+        uint32_t bytes;
+        int components;
+        GLenum type;
+        GLboolean normalized;
+    };
+
+    FormatInfo format_info(VertexFormat format) {
+        switch (format) {
+            case kFloat32x2: return { 8, 2, GL_FLOAT, GL_FALSE };
+            case kFloat32x3: return { 12, 3, GL_FLOAT, GL_FALSE };
+            case kFloat32x4: return { 16, 4, GL_FLOAT, GL_FALSE };
+            case kHalf16x2: return { 4, 2, GL_HALF_FLOAT, GL_FALSE };
+            case kHalf16x4: return { 8, 4, GL_HALF_FLOAT, GL_FALSE };
+            case kSnorm16x2: return { 4, 2, GL_SHORT, GL_TRUE };
+            case kSnorm16x4: return { 8, 4, GL_SHORT, GL_TRUE };
+            case kUnorm16x2: return { 4, 2, GL_UNSIGNED_SHORT, GL_TRUE };
+            case kUnorm8x4: return { 4, 4, GL_UNSIGNED_BYTE, GL_TRUE };
+            case kSnorm10x3: return { 4, 4, GL_INT_2_10_10_10_REV, GL_TRUE };
+            case kOctahedral16x2: return { 4, 2, GL_SHORT, GL_TRUE };
+        }
+        return { 0, 0, GL_FLOAT, GL_FALSE };
+    }
+
+    // formats whose stored value is value / range
+    bool is_ranged(VertexFormat format) {
+        return format == kSnorm16x2 || format == kSnorm16x4 || format == kSnorm10x3;
+    }
+
+    const int kSemanticComponents[kSemanticCount] = { 3, 3, 4, 2 };
+    const char* const kSemanticNames[kSemanticCount] = { "Position", "Normal", "Color", "TexCoord" };
+    const char* const kSemanticDefines[kSemanticCount] = { "VERTEX_HAS_POSITION", "VERTEX_HAS_NORMAL", "VERTEX_HAS_COLOR", "VERTEX_HAS_TEXCOORD" };
+
+    int16_t to_snorm16(float value) {
+        return static_cast<int16_t>(std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+    }
+
+    uint32_t to_snorm10(float value) {
+        return static_cast<uint32_t>(std::lround(std::min(std::max(value, -1.0f), 1.0f) * 511.0f)) & 0x3FFu;
+    }
+
+    uint16_t to_unorm16(float value) {
+        return static_cast<uint16_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f));
+    }
+
+    uint8_t to_unorm8(float value) {
+        return static_cast<uint8_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+    }
+
+    // sign that maps 0 to 1, so the folded lower half of the octahedron stays on the right side
+    float sign_not_zero(float value) {
+        return value >= 0.0f ? 1.0f : -1.0f;
+    }
+
+    void octahedral_encode(const float normal[3], float out[2]) {
+        float length = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+        if (length <= 0.0f) {
+            out[0] = out[1] = 0.0f;
+            return;
+        }
+        float x = normal[0] / length;
+        float y = normal[1] / length;
+        if (normal[2] < 0.0f) {
+            float folded_x = (1.0f - std::fabs(y)) * sign_not_zero(x);
+            y = (1.0f - std::fabs(x)) * sign_not_zero(y);
+            x = folded_x;
+        }
+        out[0] = x;
+        out[1] = y;
+    }
+
+    void octahedral_decode(const float encoded[2], float out[3]) {
+        float x = encoded[0];
+        float y = encoded[1];
+        float z = 1.0f - std::fabs(x) - std::fabs(y);
+        float t = std::max(-z, 0.0f);
+        x += x >= 0.0f ? -t : t;
+        y += y >= 0.0f ? -t : t;
+        float length = std::sqrt(x * x + y * y + z * z);
+        out[0] = x / length;
+        out[1] = y / length;
+        out[2] = z / length;
+    }
+
+    // a float literal glsl accepts, always with a dot
+    std::string glsl_float(float value) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+        std::string result(buffer);
+        if (result.find_first_of(".en") == std::string::npos) {
+            result += ".0";
+        }
+        return result;
+    }
+}
+
+uint16_t float_to_half(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+    uint32_t magnitude = bits & 0x7FFFFFFFu;
+    if (magnitude >= 0x7F800000u) {
+        // inf stays inf, nan stays a (quiet) nan
+        return sign | 0x7C00u | (magnitude > 0x7F800000u ? 0x200u : 0u);
+    }
+    if (magnitude >= 0x477FF000u) {
+        // 65520 and up round past the largest half
+        return sign | 0x7C00u;
+    }
+    if (magnitude < 0x38800000u) {
+        // below the smallest normal half, in units of 2^-24, rounded to nearest even
+        return sign | static_cast<uint16_t>(std::nearbyint(std::fabs(value) * 16777216.0f));
+    }
+    // rebias the exponent (127 -> 15) and round the dropped 13 mantissa bits to nearest even
+    uint32_t half = (magnitude - 0x38000000u) >> 13;
+    uint32_t rest = magnitude & 0x1FFFu;
+    if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) {
+        ++half;
+    }
+    return sign | static_cast<uint16_t>(half);
+}
+
+float half_to_float(uint16_t value) {
+    uint32_t sign = uint32_t(value & 0x8000u) << 16;
+    uint32_t exponent = (value >> 10) & 0x1Fu;
+    uint32_t mantissa = value & 0x3FFu;
+    uint32_t bits;
+    if (exponent == 0) {
+        float result = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -result : result;
+    } else if (exponent == 31) {
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+void read_vertex_attribute(const VertexAttribute& attribute, const void* vertex, float out[4]) {
+    out[0] = out[1] = out[2] = 0.0f;
+    out[3] = 1.0f;
+    const unsigned char* data = static_cast<const unsigned char*>(vertex) + attribute.offset;
+    bool normalized = attribute.normalized == GL_TRUE;
+    for (int i = 0; i < attribute.components && i < 4; ++i) {
+        switch (attribute.type) {
+            case GL_FLOAT: std::memcpy(&out[i], data + i * 4, 4); break;
+            case GL_HALF_FLOAT: {
+                uint16_t half;
+                std::memcpy(&half, data + i * 2, 2);
+                out[i] = half_to_float(half);
+                break;
+            }
+            case GL_SHORT: {
+                int16_t value;
+                std::memcpy(&value, data + i * 2, 2);
+                out[i] = normalized ? std::max(value / 32767.0f, -1.0f) : value;
+                break;
+            }
+            case GL_UNSIGNED_SHORT: {
+                uint16_t value;
+                std::memcpy(&value, data + i * 2, 2);
+                out[i] = normalized ? value / 65535.0f : value;
+                break;
+            }
+            case GL_BYTE: {
+                int8_t value = static_cast<int8_t>(data[i]);
+                out[i] = normalized ? std::max(value / 127.0f, -1.0f) : value;
+                break;
+            }
+            case GL_UNSIGNED_BYTE: out[i] = normalized ? data[i] / 255.0f : data[i]; break;
+            case GL_INT: {
+                int32_t value;
+                std::memcpy(&value, data + i * 4, 4);
+                out[i] = static_cast<float>(value);
+                break;
+            }
+            case GL_UNSIGNED_INT: {
+                uint32_t value;
+                std::memcpy(&value, data + i * 4, 4);
+                out[i] = static_cast<float>(value);
+                break;
+            }
+            case GL_INT_2_10_10_10_REV: {
+                uint32_t packed;
+                std::memcpy(&packed, data, 4);
+                int bits = i < 3 ? 10 : 2;
+                int32_t field = static_cast<int32_t>(packed << (32 - bits - i * 10)) >> (32 - bits);
+                float max_value = static_cast<float>((1 << (bits - 1)) - 1);
+                out[i] = normalized ? std::max(field / max_value, -1.0f) : field;
+                break;
+            }
+            case GL_UNSIGNED_INT_2_10_10_10_REV: {
+                uint32_t packed;
+                std::memcpy(&packed, data, 4);
+                int bits = i < 3 ? 10 : 2;
+                uint32_t field = (packed >> (i * 10)) & ((1u << bits) - 1);
+                out[i] = normalized ? field / static_cast<float>((1u << bits) - 1) : field;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+VertexLayout::VertexLayout(std::initializer_list<VertexElement> elements)
+    : VertexLayout(std::vector<VertexElement>(elements)) {
+}
+
+VertexLayout::VertexLayout(const std::vector<VertexElement>& elements) : elements_(elements) {
+    std::fill(element_index_, element_index_ + kSemanticCount, -1);
+    for (size_t i = 0; i < elements_.size(); ++i) {
+        const VertexElement& element = elements_[i];
+        FormatInfo info = format_info(element.format);
+        element_index_[element.semantic] = static_cast<int>(i);
+        attributes_.push_back({ static_cast<unsigned int>(element.semantic), info.components, info.type, info.normalized, stride_ });
+        stride_ += info.bytes;
+    }
+}
+
+bool VertexLayout::operator==(const VertexLayout& other) const {
+    if (elements_.size() != other.elements_.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < elements_.size(); ++i) {
+        const VertexElement& a = elements_[i];
+        const VertexElement& b = other.elements_[i];
+        if (a.semantic != b.semantic || a.format != b.format || a.range != b.range) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void VertexLayout::encode(const VertexStreams& streams, size_t vertex_count, void* destination) const {
+    const float* const sources[kSemanticCount] = { streams.positions, streams.normals, streams.colors, streams.texcoords };
+    unsigned char* out = static_cast<unsigned char*>(destination);
+    for (size_t v = 0; v < vertex_count; ++v, out += stride_) {
+        for (size_t e = 0; e < elements_.size(); ++e) {
+            const VertexElement& element = elements_[e];
+            int components = kSemanticComponents[element.semantic];
+            float value[4] = { 0.0f, 0.0f, 0.0f, element.semantic == kNormal ? 0.0f : 1.0f };
+            if (sources[element.semantic]) {
+                std::memcpy(value, sources[element.semantic] + v * components, sizeof(float) * components);
+            }
+            if (is_ranged(element.format)) {
+                for (float& component : value) {
+                    component /= element.range;
+                }
+            }
+
+            unsigned char* at = out + attributes_[e].offset;
+            switch (element.format) {
+                case kFloat32x2: std::memcpy(at, value, 8); break;
+                case kFloat32x3: std::memcpy(at, value, 12); break;
+                case kFloat32x4: std::memcpy(at, value, 16); break;
+                case kHalf16x2:
+                case kHalf16x4: {
+                    int count = element.format == kHalf16x2 ? 2 : 4;
+                    for (int i = 0; i < count; ++i) {
+                        uint16_t half = float_to_half(value[i]);
+                        std::memcpy(at + i * 2, &half, 2);
+                    }
+                    break;
+                }
+                case kSnorm16x2:
+                case kSnorm16x4: {
+                    int count = element.format == kSnorm16x2 ? 2 : 4;
+                    for (int i = 0; i < count; ++i) {
+                        int16_t snorm = to_snorm16(value[i]);
+                        std::memcpy(at + i * 2, &snorm, 2);
+                    }
+                    break;
+                }
+                case kUnorm16x2:
+                    for (int i = 0; i < 2; ++i) {
+                        uint16_t unorm = to_unorm16(value[i]);
+                        std::memcpy(at + i * 2, &unorm, 2);
+                    }
+                    break;
+                case kUnorm8x4:
+                    for (int i = 0; i < 4; ++i) {
+                        at[i] = to_unorm8(value[i]);
+                    }
+                    break;
+                case kSnorm10x3: {
+                    uint32_t packed = to_snorm10(value[0]) | (to_snorm10(value[1]) << 10) | (to_snorm10(value[2]) << 20);
+                    std::memcpy(at, &packed, 4);
+                    break;
+                }
+                case kOctahedral16x2: {
+                    float folded[2];
+                    octahedral_encode(value, folded);
+                    int16_t snorm[2] = { to_snorm16(folded[0]), to_snorm16(folded[1]) };
+                    std::memcpy(at, snorm, 4);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+bool VertexLayout::decode(const void* vertex, VertexSemantic semantic, float out[4]) const {
+    int index = element_index_[semantic];
+    if (index < 0) {
+        return false;
+    }
+    const VertexElement& element = elements_[index];
+    read_vertex_attribute(attributes_[index], vertex, out);
+    if (element.format == kOctahedral16x2) {
+        float folded[2] = { out[0], out[1] };
+        octahedral_decode(folded, out);
+    } else if (is_ranged(element.format)) {
+        for (int i = 0; i < 3; ++i) {
+            out[i] *= element.range;
+        }
+    }
+    if (semantic == kNormal) {
+        float length = std::sqrt(out[0] * out[0] + out[1] * out[1] + out[2] * out[2]);
+        for (int i = 0; i < 3 && length > 0.0f; ++i) {
+            out[i] /= length;
+        }
+        out[3] = 0.0f;
+    } else if (semantic == kPosition) {
+        out[3] = 1.0f;
+    }
+    return true;
+}
+
+std::string VertexLayout::glsl() const {
+    static const char* const kVectorTypes[] = { "float", "float", "vec2", "vec3", "vec4" };
+    std::string out = "// generated from a VertexLayout, every semantic sits at its fixed location\n";
+    bool uses_octahedral = false;
+    for (const VertexElement& element : elements_) {
+        uses_octahedral = uses_octahedral || element.format == kOctahedral16x2;
+    }
+    if (uses_octahedral) {
+        out += "vec3 octahedral_decode(vec2 e) {\n"
+               "    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+               "    float t = max(-n.z, 0.0);\n"
+               "    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);\n"
+               "    return normalize(n);\n"
+               "}\n";
+    }
+
+    for (size_t e = 0; e < elements_.size(); ++e) {
+        const VertexElement& element = elements_[e];
+        const VertexAttribute& attribute = attributes_[e];
+        std::string name = std::string("a") + kSemanticNames[element.semantic];
+        out += "layout (location = " + std::to_string(attribute.location) + ") in " +
+               kVectorTypes[attribute.components] + " " + name + ";\n";
+        out += std::string("#define ") + kSemanticDefines[element.semantic] + "\n";
+
+        // widen to what the semantic needs, then undo the quantization
+        std::string value = name;
+        if (attribute.components == 2 && element.semantic != kTexCoord) {
+            value = "vec3(" + name + ", 0.0)";
+        } else if (attribute.components > 3 && element.semantic != kColor) {
+            value = name + (element.semantic == kTexCoord ? ".xy" : ".xyz");
+        }
+        if (is_ranged(element.format) && element.range != 1.0f) {
+            value = "(" + value + " * " + glsl_float(element.range) + ")";
+        }
+        switch (element.semantic) {
+            case kPosition:
+                out += "vec3 vertex_position() { return " + value + "; }\n";
+                break;
+            case kNormal:
+                if (element.format == kOctahedral16x2) {
+                    value = "octahedral_decode(" + name + ")";
+                } else {
+                    value = "normalize(" + value + ")";
+                }
+                out += "vec3 vertex_normal() { return " + value + "; }\n";
+                break;
+            case kColor:
+                if (attribute.components == 3) {
+                    value = "vec4(" + name + ", 1.0)";
+                } else if (attribute.components == 2) {
+                    value = "vec4(" + name + ", 0.0, 1.0)";
+                }
+                out += "vec4 vertex_color() { return " + value + "; }\n";
+                break;
+            case kTexCoord:
+                out += "vec2 vertex_texcoord() { return " + value + "; }\n";
+                break;
+            default:
+                break;
+        }
+    }
+    return out;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// one attribute of a vertex format as glVertexAttribPointer wants it, offset is in bytes from the start of a vertex
+struct VertexAttribute {
+    unsigned int location;
+    int components;
+    GLenum type;
+    GLboolean normalized;
+    uint32_t offset;
+};
+
+// what the attribute holds, each semantic has a fixed location the generated glsl declares it at
+enum VertexSemantic {
+    kPosition,      // location 0
+    kNormal,        // location 1
+    kColor,         // location 2
+    kTexCoord,      // location 3
+    kSemanticCount
+};
+
+// how it is stored, everything is a multiple of 4 bytes so the attributes stay aligned
+enum VertexFormat {
+    kFloat32x2,
+    kFloat32x3,
+    kFloat32x4,
+    kHalf16x2,
+    kHalf16x4,          // 3 component data padded, half a float32x3
+    kSnorm16x2,
+    kSnorm16x4,         // positions within +-range, half a float32x3
+    kUnorm16x2,
+    kUnorm8x4,          // colors
+    kSnorm10x3,         // normals as GL_INT_2_10_10_10_REV, a third of a float32x3
+    kOctahedral16x2,    // unit normals folded onto an octahedron, 2 snorm16
+};
+
+struct VertexElement {
+    VertexSemantic semantic;
+    VertexFormat format;
+    // snorm formats store value / range, e.g. positions of a mesh within +-50 units
+    float range = 1.0f;
+};
+
+// float input for encoding, positions and normals are 3 floats per vertex, colors 4 and texcoords 2
+// streams a layout has no element for are ignored, missing ones for elements it has are encoded as 0
+struct VertexStreams {
+    const float* positions = nullptr;
+    const float* normals = nullptr;
+    const float* colors = nullptr;
+    const float* texcoords = nullptr;
+};
+
+// a declarative vertex format: which semantics are stored and how tightly they are packed
+// the same description gives the attribute pointers, a cpu encoder and decoder, and the glsl that declares
+// the inputs and unpacks them (vertex_position(), vertex_normal(), ... through the preprocessor's #include),
+// so the quantization can't get out of sync between the two sides
+class VertexLayout {
+public:
+    VertexLayout(std::initializer_list<VertexElement> elements);
+    explicit VertexLayout(const std::vector<VertexElement>& elements);
+
+    // same elements in the same order, i.e. vertices encoded by one decode correctly with the other
+    bool operator==(const VertexLayout& other) const;
+    bool operator!=(const VertexLayout& other) const { return !(*this == other); }
+
+    uint32_t stride() const { return stride_; }
+    const std::vector<VertexElement>& elements() const { return elements_; }
+    const std::vector<VertexAttribute>& attributes() const { return attributes_; }
+    bool has(VertexSemantic semantic) const { return element_index_[semantic] >= 0; }
+
+    // quantize vertex_count vertices into destination, stride() bytes each
+    void encode(const VertexStreams& streams, size_t vertex_count, void* destination) const;
+    // what the vertex shader will see for the semantic (4 values, missing ones 0, w of positions 1)
+    bool decode(const void* vertex, VertexSemantic semantic, float out[4]) const;
+
+    // declarations and decode functions for the vertex shader, meant to be #included
+    std::string glsl() const;
+
+private:
+    std::vector<VertexElement> elements_;
+    std::vector<VertexAttribute> attributes_;
+    int element_index_[kSemanticCount];
+    uint32_t stride_ = 0;
+};
+
+// the value GL fetches for an attribute, with the conversion rules for normalized and packed types
+void read_vertex_attribute(const VertexAttribute& attribute, const void* vertex, float out[4]);
+
+uint16_t float_to_half(float value);
+float half_to_float(uint16_t value);